@@ -43,6 +43,7 @@ int evaluate = 1;
 
 
 EDI_Directory directoryhandler(void *, EDI_Parameters);
+EDI_Directory directoryloader(void *, EDI_Parameters, unsigned long *);
 void warninghandler (void *, int);
 void errorhandler (void *, int);
 void segmenthandler (void *, EDI_Parameters, EDI_Segment, EDI_Directory);
@@ -62,10 +63,12 @@ int
 main (int argc, char **argv)
 {
   EDI_Parser parser;
-  FILE *stream = stdin;
-  char buffer[4096], *xmlfile = NULL, *pyxfile = NULL;
-  int optind;
-  unsigned int length, done, n;
+  char *path = NULL, *xmlfile = NULL, *pyxfile = NULL, *mapfile = NULL;
+  char *mapdir = NULL;
+  EDI_DirectoryCache cache = NULL;
+  EDI_Compression compression = EDI_COMPRESSION_NONE;
+  int optind, pipeline = 0;
+  unsigned int n;
   MyData mydata;
 
   /* mydata will be registered as user data with the parser */
@@ -88,6 +91,14 @@ main (int argc, char **argv)
 	  evaluate = 0;
 	  break;
 
+	case 'z':
+	  compression = EDI_COMPRESSION_AUTO;
+	  break;
+
+	case 'P':
+	  pipeline = 1;
+	  break;
+
 	case 'x':
 	  if(argv[optind][n+1] == '\0')
 	    if(++optind < argc)
@@ -110,6 +121,28 @@ main (int argc, char **argv)
 	  n = strlen (argv[optind]);
 	  break;
 	  
+	case 'm':
+	  if(argv[optind][n+1] == '\0')
+	    if(++optind < argc)
+	      mapfile = argv[optind];
+	    else
+	      exit ((usage (), -1));
+	  else
+	    mapfile = argv[optind] + 2;
+	  n = strlen (argv[optind]);
+	  break;
+	  
+	case 'd':
+	  if(argv[optind][n+1] == '\0')
+	    if(++optind < argc)
+	      mapdir = argv[optind];
+	    else
+	      exit ((usage (), -1));
+	  else
+	    mapdir = argv[optind] + 2;
+	  n = strlen (argv[optind]);
+	  break;
+	  
 	case 'h':
 	  exit ((usage (), 0));
 	  
@@ -124,6 +157,8 @@ main (int argc, char **argv)
     mydata.directory = read_xmltsg_file (xmlfile);
   else if(pyxfile)
     mydata.directory = read_pyxtsg_file (pyxfile);
+  else if(mapfile)
+    mydata.directory = EDI_DirectoryMap (mapfile);
   else if(xmlbuff)
     mydata.directory = read_xmltsg_buffer(xmlbuff, 0);
   else if(pyxbuff)
@@ -131,8 +166,8 @@ main (int argc, char **argv)
   
   /* If we were given a filename argument use that instead of stdin */
 
-  if (optind < argc && !(stream = fopen (argv[optind], "r")))
-    exit (((perror ("Couldn't open file")), -1));
+  if (optind < argc)
+    path = argv[optind];
   
   /* Create the parser */
 
@@ -150,6 +185,11 @@ main (int argc, char **argv)
   mydata.parser = parser;
   EDI_SetUserData (parser, &mydata);
 
+  /* Tokenise on this thread and do the rest on another if asked to */
+
+  if (pipeline && !EDI_SetPipeline (parser, 1))
+    fprintf (stderr, "Couldn't set up a pipeline - using one thread\n");
+
   /* Tell the parser to relax the rules on characters which are not */
   /* supposed to be allowed in the message - sometimes service advice */
   /* strings contain verboten characters such as newline */
@@ -178,37 +218,43 @@ main (int argc, char **argv)
 
   EDI_SetDirectoryHandler (parser, directoryhandler);
 
-  /* Now we can start feeding the stream to the parser */
+  /* Messages the handler has no directory for can have one looked up */
+  /* by their version and release in a directory of compiled TSGs */
 
-  do
+  if (mapdir)
     {
-      /* Read in the stream chunk by chunk. If we don't get a whole */
-      /* buffer full of characters the stream is finished */
-      
-      length = fread (buffer, 1, sizeof (buffer), stream);
-      done = length < sizeof (buffer);
-      
-      /* Tell MEDICI to parse this chunk. If it is the last chunk */
-      /* the "done" argument will be 1 to indicate this to MEDICI */
-      
-      EDI_Parse (parser, buffer, length, done);
-      
-      /* The error code will be non-zero on a fatal error */
-      
-      if(EDI_GetErrorCode (parser))
-	return 1;
+      if (!(cache = EDI_DirectoryCacheCreate (directoryloader, mapdir, 0)))
+	{
+	  perror ("Couldn't create directory cache");
+	  return 1;
+	}
+
+      EDI_SetDirectoryCache (parser, cache);
+    }
+
+  /* Now we can have MEDICI parse the stream. A file is mapped into */
+  /* memory and parsed where it lies, a pipe is read chunk by chunk */
+
+  if (!EDI_ParseFileFiltered (parser, path, compression))
+    {
+      /* The error code will be non-zero on a fatal error, otherwise */
+      /* the file couldn't be read at all */
+
+      if(!EDI_GetErrorCode (parser))
+	perror ("Couldn't read file");
+      return 1;
     }
-  while (!done);
   
   /* Tell MEDICI to free all resources associated with this parse(r) */
   
   EDI_ParserFree (parser);
 
+  if(cache)
+    EDI_DirectoryCacheFree(cache);
+
   if(mydata.directory)
     EDI_DirectoryFree(mydata.directory);
 
-  fclose(stream);
-
   return 0;
 }
 
@@ -271,6 +317,27 @@ EDI_Directory directoryhandler
 }
 
 
+EDI_Directory directoryloader
+(void *v, EDI_Parameters p, unsigned long *size)
+{
+  char *mapdir = (char *) v, path[1024];
+  char *version = EDI_GetParameter (p, MessageVersionNumber);
+  char *release = EDI_GetParameter (p, MessageReleaseNumber);
+
+  /* eg. D96A.tsg for an EDIFACT D.96A message */
+
+  if (!version || !release ||
+      strlen (mapdir) + strlen (version) + strlen (release) + 6 > sizeof (path))
+    return NULL;
+
+  sprintf (path, "%s/%s%s.tsg", mapdir, version, release);
+
+  /* Mapped images cost next to nothing, so no size is charged for them */
+
+  return EDI_DirectoryMap (path);
+}
+
+
 void
 starthandler (void *v, EDI_Event event, EDI_Parameters p)
 {
@@ -556,11 +623,15 @@ usage (void)
 {
   printf
     ("\n"
-     "Usage: describe [-h] [-n] [-{x|p} <file>] [<edifile>]\n"
+     "Usage: describe [-h] [-n] [-z] [-P] [-{x|p|m} <file>] [-d <dir>] [<edifile>]\n"
      "       -h this text\n"
      "       -n don't evaluate numeric or coded elements\n"
+     "       -z decompress gzip or zstd compressed input\n"
+     "       -P tokenise and parse on separate threads\n"
      "       -x read directory definition from <xmlfile>\n"
      "       -p read directory definition from <pyxfile>\n"
+     "       -m map directory compiled by tsgc from <file>\n"
+     "       -d otherwise map <version><release>.tsg from <dir>\n"
      "\n"
      "Reading an EDI stream from <edifile>, or stdin if no file is specified\n"
      "describe produces a \"human-readable\" summary of an EDI interchange.\n"
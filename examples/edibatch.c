@@ -0,0 +1,248 @@
+/*
+
+  The MEDICI Electronic Data Interchange Library
+  Copyright (C) 2002  David Coles
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+/*
+
+  This program parses a batch of files - typically a spool directory
+  holding a great many small interchanges - reading many of them at
+  once and parsing them on several threads:
+
+  > edibatch [-t threads] [-q depth] file-or-directory...
+
+  Each directory given is taken to mean the files in it. Files which
+  fail to parse are reported, and at the end of the run the number of
+  files and bytes parsed per second.
+
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+
+#include <medici.h>
+
+typedef struct
+{
+  const char **path;
+  unsigned long count, size;
+
+  /* segments seen in each file */
+  unsigned long *segments;
+
+  unsigned long total, errors;
+} batch_t;
+
+
+void
+segment_handler (void *v, EDI_Parameters p, EDI_Segment s, EDI_Directory d)
+{
+  (*(unsigned long *) v)++;
+}
+
+void *
+start_handler (void *v, EDI_Parser parser, unsigned long index)
+{
+  batch_t *batch = (batch_t *) v;
+
+  EDI_SetUserData (parser, batch->segments + index);
+  EDI_SetSegmentHandler (parser, segment_handler);
+
+  return NULL;
+}
+
+/* called in the order of the files, one at a time */
+void
+end_handler (void *v, void *data, unsigned long index, int error)
+{
+  batch_t *batch = (batch_t *) v;
+
+  batch->total += batch->segments[index];
+
+  if (error)
+    {
+      fprintf (stderr, "%s: %s\n", batch->path[index],
+	       EDI_GetErrorString (error));
+      batch->errors++;
+    }
+}
+
+
+/* adds a copy of a file name to the batch */
+int
+add (batch_t *batch, const char *directory, const char *name)
+{
+  const char **p;
+  char *path;
+
+  if (batch->count == batch->size)
+    {
+      batch->size = batch->size ? batch->size * 2 : 1024;
+
+      if (!(p = realloc (batch->path, batch->size * sizeof (char *))))
+	return 0;
+
+      batch->path = p;
+    }
+
+  if (!(path = malloc ((directory ? strlen (directory) + 1 : 0) +
+		       strlen (name) + 1)))
+    return 0;
+
+  if (directory)
+    sprintf (path, "%s/%s", directory, name);
+  else
+    strcpy (path, name);
+
+  batch->path[batch->count++] = path;
+  return 1;
+}
+
+int
+compare (const void *a, const void *b)
+{
+  return strcmp (*(const char **) a, *(const char **) b);
+}
+
+/* adds the regular files in a directory, in order of their names -
+   returns zero if it isn't a directory, or -1 if the files couldn't
+   all be added */
+int
+add_directory (batch_t *batch, const char *path)
+{
+  struct dirent *entry;
+  struct stat st;
+  unsigned long first = batch->count;
+  DIR *dir;
+
+  if (!(dir = opendir (path)))
+    return 0;
+
+  while ((entry = readdir (dir)))
+    {
+      if (entry->d_name[0] == '.')
+	continue;
+
+      if (!add (batch, path, entry->d_name))
+	{
+	  closedir (dir);
+	  return -1;
+	}
+
+      /* subdirectories, pipes and so on aren't parsed */
+      if (stat (batch->path[batch->count - 1], &st) || !S_ISREG (st.st_mode))
+	free ((void *) batch->path[--batch->count]);
+    }
+
+  closedir (dir);
+
+  qsort (batch->path + first, batch->count - first, sizeof (char *),
+	 compare);
+
+  return 1;
+}
+
+
+int
+main (int argc, char **argv)
+{
+  EDI_ParallelHandlers handlers;
+  EDI_BatchStats stats;
+  batch_t batch;
+  unsigned int threads = 0, depth = 0;
+  struct timeval start, end;
+  double seconds, megabytes;
+  int i, n;
+
+  memset (&batch, 0, sizeof (batch));
+
+  for (i = 1; i < argc && argv[i][0] == '-'; i++)
+    {
+      if (!strcmp (argv[i], "-t") && i + 1 < argc)
+	threads = strtoul (argv[++i], NULL, 10);
+      else if (!strcmp (argv[i], "-q") && i + 1 < argc)
+	depth = strtoul (argv[++i], NULL, 10);
+      else
+	break;
+    }
+
+  /* anything else starting with - is an option we don't know */
+  if (i == argc || argv[i][0] == '-')
+    {
+      fprintf (stderr, "usage: %s [-t threads] [-q depth] "
+	       "file-or-directory...\n", argv[0]);
+      return 1;
+    }
+
+  for (; i < argc; i++)
+    if ((n = add_directory (&batch, argv[i])) < 0 ||
+	(!n && !add (&batch, NULL, argv[i])))
+      {
+	perror ("Couldn't list files");
+	return 1;
+      }
+
+  if (!(batch.segments = calloc (batch.count + 1, sizeof (unsigned long))))
+    {
+      perror ("Couldn't list files");
+      return 1;
+    }
+
+  handlers.start = start_handler;
+  handlers.end = end_handler;
+  handlers.user = &batch;
+  handlers.ordered = 1;
+
+  gettimeofday (&start, NULL);
+
+  if (EDI_ParseBatch (NULL, batch.path, batch.count, threads, depth,
+		      &handlers, &stats) < 0)
+    {
+      perror ("EDI_ParseBatch()");
+      return 1;
+    }
+
+  gettimeofday (&end, NULL);
+
+  seconds = (end.tv_sec - start.tv_sec) +
+    (end.tv_usec - start.tv_usec) / 1000000.0;
+  megabytes = stats.bytes / (1024.0 * 1024.0);
+
+  if (seconds <= 0)
+    seconds = 0.000001;
+
+  printf ("%lu files (%lu unreadable, %lu with errors), %lu segments, "
+	  "%.1f MB in %.3fs\n", stats.files, stats.failed,
+	  batch.errors - stats.failed, batch.total, megabytes, seconds);
+  printf ("%.0f files/s, %.1f MB/s\n", stats.files / seconds,
+	  megabytes / seconds);
+
+  while (batch.count)
+    free ((char *) batch.path[--batch.count]);
+
+  free (batch.path);
+  free (batch.segments);
+
+  return batch.errors ? 2 : 0;
+}
@@ -0,0 +1,267 @@
+/*
+
+  The MEDICI Electronic Data Interchange Library
+  Copyright (C) 2002  David Coles
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+/*
+
+  This program parses the interchanges in a file (or stdin) on
+  several threads, and prints the error each of them ended with, one
+  to a line in the order of the file:
+
+  > ediparallel [-t threads] [file]
+
+  An interchange which parsed cleanly is reported as 0. The output is
+  the same whatever the number of threads, and the same as for each
+  interchange parsed from a file of its own.
+
+  With -m the messages of each interchange are parsed on the threads
+  instead, and each is reported with the number of its segments and a
+  hash of their codes. With -s as well they are parsed one after
+  another by a single parser, which should give the same report:
+
+  > ediparallel -m -t 4 file
+  > ediparallel -m -s file
+
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <medici.h>
+
+
+typedef struct
+{
+  unsigned long segments;
+  unsigned long hash;
+  int open;
+} message_t;
+
+
+/* called in the order of the interchanges, one at a time */
+void
+end_handler (void *v, void *data, unsigned long index, int error)
+{
+  (*(unsigned long *) v) += error ? 1 : 0;
+
+  printf ("%d %s\n", error, error ? EDI_GetErrorString (error) : "OK");
+}
+
+
+void
+message_report (message_t *message, int error)
+{
+  printf ("%d %s %lu %08lx\n", error, error ? EDI_GetErrorString (error) : "OK",
+	  message->segments, message->hash & 0xffffffffUL);
+}
+
+/* counts the segments of a message, and hashes their codes */
+void
+segment_handler (void *v, EDI_Parameters p, EDI_Segment s, EDI_Directory d)
+{
+  message_t *message = (message_t *) v;
+  char *c;
+
+  if (!message->open)
+    return;
+
+  message->segments++;
+  for (c = EDI_GetCode (s); c && *c; c++)
+    message->hash = message->hash * 31 + (unsigned char) *c;
+}
+
+/* called on the parsing thread, after the message's headers */
+void *
+message_start (void *v, EDI_Parser parser, unsigned long index)
+{
+  message_t *message;
+
+  if (!(message = calloc (1, sizeof (message_t))))
+    return NULL;
+
+  message->open = 1;
+  EDI_SetUserData (parser, message);
+  EDI_SetSegmentHandler (parser, segment_handler);
+
+  return message;
+}
+
+void
+message_end (void *v, void *data, unsigned long index, int error)
+{
+  message_t none;
+
+  (*(unsigned long *) v) += error ? 1 : 0;
+
+  memset (&none, 0, sizeof (none));
+  message_report (data ? (message_t *) data : &none, error);
+  free (data);
+}
+
+
+/* the serial parse keeps the state of the message in user data */
+void
+serial_start (void *v, EDI_Event event, EDI_Parameters p)
+{
+  if (event == EDI_TRANSACTION)
+    {
+      memset (v, 0, sizeof (message_t));
+      ((message_t *) v)->open = 1;
+    }
+}
+
+void
+serial_end (void *v, EDI_Event event)
+{
+  if (event == EDI_TRANSACTION)
+    {
+      message_report ((message_t *) v, 0);
+      ((message_t *) v)->open = 0;
+    }
+}
+
+int
+parse_messages (char *path, unsigned int threads, int serial)
+{
+  EDI_ParallelHandlers handlers;
+  EDI_Parser parser;
+  message_t message;
+  unsigned long errors = 0;
+  char *data = NULL, *ptr;
+  long n, size = 0, blck = 0;
+  FILE *stream;
+  int ok;
+
+  if (!(parser = EDI_ParserCreate ()))
+    {
+      perror ("EDI_ParserCreate()");
+      return 1;
+    }
+
+  if (serial)
+    {
+      memset (&message, 0, sizeof (message));
+      EDI_SetUserData (parser, &message);
+      EDI_SetStartHandler (parser, serial_start);
+      EDI_SetEndHandler (parser, serial_end);
+      EDI_SetSegmentHandler (parser, segment_handler);
+
+      ok = EDI_ParseFile (parser, path);
+      errors = EDI_GetErrorCode (parser) ? 1 : 0;
+      EDI_ParserFree (parser);
+
+      if (!ok && !errors)
+	{
+	  perror ("EDI_ParseFile()");
+	  return 1;
+	}
+
+      return errors ? 2 : 0;
+    }
+
+  if (!(stream = path ? fopen (path, "rb") : stdin))
+    {
+      perror (path);
+      return 1;
+    }
+
+  /* the whole stream is parsed from memory */
+  do
+    {
+      if (size == blck)
+	{
+	  blck = blck ? blck * 2 : 65536;
+	  if (!(ptr = realloc (data, blck)))
+	    {
+	      perror ("realloc()");
+	      return 1;
+	    }
+	  data = ptr;
+	}
+    }
+  while ((n = fread (data + size, 1, blck - size, stream)) > 0 &&
+	 (size += n));
+
+  if (path)
+    fclose (stream);
+
+  memset (&handlers, 0, sizeof (handlers));
+  handlers.start = message_start;
+  handlers.end = message_end;
+  handlers.user = &errors;
+  handlers.ordered = 1;
+
+  if (EDI_ParseMessagesParallel (parser, data, size, threads, &handlers) < 0)
+    {
+      perror ("EDI_ParseMessagesParallel()");
+      return 1;
+    }
+
+  if (EDI_GetErrorCode (parser))
+    errors++;
+
+  EDI_ParserFree (parser);
+  free (data);
+
+  return errors ? 2 : 0;
+}
+
+
+int
+main (int argc, char **argv)
+{
+  EDI_ParallelHandlers handlers;
+  unsigned long errors = 0;
+  unsigned int threads = 0;
+  int i, messages = 0, serial = 0;
+
+  for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1]; i++)
+    {
+      if (!strcmp (argv[i], "-t") && i + 1 < argc)
+	threads = strtoul (argv[++i], NULL, 10);
+      else if (!strcmp (argv[i], "-m"))
+	messages = 1;
+      else if (!strcmp (argv[i], "-s"))
+	serial = 1;
+      else
+	{
+	  fprintf (stderr, "usage: %s [-t threads] [-m [-s]] [file]\n",
+		   argv[0]);
+	  return 1;
+	}
+    }
+
+  if (messages)
+    return parse_messages (i < argc ? argv[i] : NULL, threads, serial);
+
+  memset (&handlers, 0, sizeof (handlers));
+  handlers.end = end_handler;
+  handlers.user = &errors;
+  handlers.ordered = 1;
+
+  if (EDI_ParseParallel (i < argc ? argv[i] : NULL, threads, &handlers) < 0)
+    {
+      perror ("EDI_ParseParallel()");
+      return 1;
+    }
+
+  return errors ? 2 : 0;
+}
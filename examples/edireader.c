@@ -0,0 +1,334 @@
+/*
+
+  The MEDICI Electronic Data Interchange Library
+  Copyright (C) 2002  David Coles
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+/*
+
+  This program lists the structure, segments and element values of
+  EDI files, pulling events from an EDI_Reader:
+
+  > edireader [-p] [-c chunk] file...
+
+  With -c the reader is fed the file chunk characters at a time,
+  rather than given all of it at once. With -p the file is parsed
+  with handlers instead (in chunks too, if -c is given), by parsers
+  taken from a pool. The listing is the same however the file is
+  read, so each way can be checked against the others:
+
+  > edireader -p file > push.out
+  > edireader -c 7 file | cmp - push.out
+
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <medici.h>
+
+
+typedef struct
+{
+  FILE *stream;
+  long chunk;
+} input_t;
+
+/* element values are unescaped into here */
+static char *value = NULL;
+static unsigned long value_size = 0;
+
+
+static void
+print_start (EDI_Event event, EDI_Parameters p)
+{
+  char *s;
+  int n;
+
+  printf ("[ %s", EDI_GetEventString (event));
+
+  for (n = MinParameter; n < MaxParameter; n++)
+    if ((s = EDI_GetParameter (p, n)) && strlen (s))
+      printf (" %s=\"%s\"", EDI_GetParameterString (n), s);
+
+  printf (" ]\n");
+}
+
+static void
+print_end (EDI_Event event)
+{
+  printf ("[ /%s ]\n", EDI_GetEventString (event));
+}
+
+static void
+print_value (int element, int subelement, const EDI_ElementView *view)
+{
+  unsigned long length;
+  const char *data;
+
+  if (!view->size)
+    return;
+
+  /* the value can't be longer than its escaped form */
+  if (view->release && value_size <= view->size)
+    {
+      free (value);
+      value_size = view->size + 1;
+      if (!(value = malloc (value_size)))
+	{
+	  perror ("malloc()");
+	  exit (1);
+	}
+    }
+
+  if (!(data = EDI_UnescapeElement (view, value, value_size, &length)))
+    return;
+
+  printf ("  %d.%d %.*s\n", element, subelement, (int) length, data);
+}
+
+
+/* the reader leaves out the start and end of segments and their
+   parts, as their contents come with the segment, and the service
+   string advice, which only comes from replaying a segment's tokens */
+static int
+is_structure (EDI_Event event)
+{
+  switch (event)
+    {
+    case EDI_ADVICE:
+    case EDI_SEGMENT:
+    case EDI_TAG:
+    case EDI_COMPOSITE:
+    case EDI_ELEMENT:
+      return 0;
+    default:
+      return 1;
+    }
+}
+
+static void
+start_handler (void *v, EDI_Event event, EDI_Parameters p)
+{
+  if (is_structure (event))
+    print_start (event, p);
+}
+
+static void
+end_handler (void *v, EDI_Event event)
+{
+  if (is_structure (event))
+    print_end (event);
+}
+
+static void
+segment_handler (void *v, EDI_Parameters p, EDI_Segment s, EDI_Directory d)
+{
+  EDI_ElementView view;
+  int e, c;
+
+  printf ("%s\n", EDI_GetCode (s));
+
+  for (e = 0; e < EDI_GetElementCount (s); e++)
+    for (c = 0; c < EDI_GetSubelementCount (s, e); c++)
+      if (EDI_GetElementView (s, e, c, &view))
+	print_value (e, c, &view);
+}
+
+static int
+push (EDI_ParserPool pool, FILE *stream, long chunk)
+{
+  EDI_Parser parser;
+  char *buffer;
+  long n;
+  int error;
+
+  if (!(buffer = malloc (chunk)) || !(parser = EDI_ParserPoolGet (pool)))
+    {
+      perror ("Couldn't create parser");
+      exit (1);
+    }
+
+  EDI_SetStartHandler (parser, start_handler);
+  EDI_SetEndHandler (parser, end_handler);
+  EDI_SetSegmentHandler (parser, segment_handler);
+
+  /* anything after the end of the interchange is left unparsed */
+  while ((n = fread (buffer, 1, chunk, stream)) > 0 &&
+	 !EDI_GetErrorCode (parser) && !EDI_InterchangeComplete (parser))
+    EDI_Parse (parser, buffer, n, 0);
+
+  if (!EDI_GetErrorCode (parser))
+    EDI_Parse (parser, buffer, 0, 1);
+
+  error = EDI_GetErrorCode (parser);
+
+  EDI_ParserPoolPut (pool, parser);
+  free (buffer);
+
+  return error;
+}
+
+
+static long
+read_handler (void *v, char *buffer, long size)
+{
+  input_t *input = (input_t *) v;
+
+  return fread (buffer, 1, size < input->chunk ? size : input->chunk,
+		input->stream);
+}
+
+static int
+pull (EDI_Reader reader)
+{
+  EDI_ReaderEvent *event;
+  EDI_ElementView view;
+
+  while ((event = EDI_NextEvent (reader)))
+    {
+      if (event->type == EDI_ELEMENT)
+	{
+	  view.data = event->data;
+	  view.size = event->size;
+	  view.release = event->release;
+	  print_value (event->element, event->subelement, &view);
+	}
+      else if (event->type == EDI_SEGMENT)
+	printf ("%s\n", EDI_GetCode (event->segment));
+      else if (event->end)
+	print_end (event->type);
+      else
+	print_start (event->type, event->parameters);
+    }
+
+  return EDI_ReaderGetErrorCode (reader);
+}
+
+static char *
+slurp (FILE *stream, long *size)
+{
+  char *data = NULL, *ptr;
+  long n, blck = 0;
+
+  *size = 0;
+
+  do
+    {
+      if (*size == blck)
+	{
+	  blck = blck ? blck * 2 : 65536;
+	  if (!(ptr = realloc (data, blck)))
+	    {
+	      perror ("realloc()");
+	      exit (1);
+	    }
+	  data = ptr;
+	}
+    }
+  while ((n = fread (data + *size, 1, blck - *size, stream)) > 0 &&
+	 (*size += n));
+
+  return data;
+}
+
+
+static int
+usage (char *name)
+{
+  fprintf (stderr, "usage: %s [-p] [-c chunk] file...\n", name);
+  return 1;
+}
+
+int
+main (int argc, char **argv)
+{
+  EDI_ParserPool pool = NULL;
+  EDI_Reader reader;
+  input_t input;
+  char *data = NULL;
+  long chunk = 0, size;
+  int i, pushing = 0, error;
+
+  for (i = 1; i < argc && argv[i][0] == '-'; i++)
+    {
+      if (!strcmp (argv[i], "-p"))
+	pushing = 1;
+      else if (!strcmp (argv[i], "-c") && i + 1 < argc &&
+	       (chunk = strtol (argv[++i], NULL, 10)) > 0)
+	;
+      else
+	return usage (argv[0]);
+    }
+
+  if (i == argc)
+    return usage (argv[0]);
+
+  if (pushing && !(pool = EDI_ParserPoolCreate (1)))
+    {
+      perror ("Couldn't create parser pool");
+      return 1;
+    }
+
+  for (; i < argc; i++)
+    {
+      if (!(input.stream = fopen (argv[i], "rb")))
+	{
+	  perror (argv[i]);
+	  return 1;
+	}
+
+      input.chunk = chunk;
+
+      if (pushing)
+	error = push (pool, input.stream, chunk ? chunk : 65536);
+      else
+	{
+	  if (chunk)
+	    reader = EDI_ReaderCreateStream (read_handler, &input);
+	  else
+	    {
+	      data = slurp (input.stream, &size);
+	      reader = EDI_ReaderCreate (data, size);
+	    }
+
+	  if (!reader)
+	    {
+	      perror ("Couldn't create reader");
+	      return 1;
+	    }
+
+	  error = pull (reader);
+
+	  EDI_ReaderFree (reader);
+	  free (data);
+	  data = NULL;
+	}
+
+      fclose (input.stream);
+
+      printf ("%d %s\n", error, error ? EDI_GetErrorString (error) : "OK");
+    }
+
+  if (pool)
+    EDI_ParserPoolFree (pool);
+  free (value);
+
+  return 0;
+}
@@ -6,7 +6,8 @@
 
 /**********************************************************************
  * This example program reads a stream of concatenated EDI
- * interchanges (on stdin or from a file specified as an argument) and
+ * interchanges (on stdin or from a file specified as an argument,
+ * decompressing it first if given -z) and
  * writes each interchange to an individual file (interchange.NNN)
  * whilst reporting extension (the NNN bit), sender/recipient and
  * application/interchange references to stdout.  This sort of thing
@@ -78,9 +79,8 @@ void default_handler(void *v, const char *text, int size)
 int
 main (int argc, char **argv)
 {
-  FILE *stream = stdin;
-  char buffer[8192];
-  unsigned int length, parsed, offset;
+  char *path = NULL;
+  EDI_Compression compression = EDI_COMPRESSION_NONE;
   EDI_Parser parser;
   user_data_t user_data;
 
@@ -98,50 +98,33 @@ main (int argc, char **argv)
   EDI_SetEndHandler (parser, end_handler);
   EDI_SetDefaultHandler (parser, default_handler);
   
+  if (argc > 1 && !strcmp (argv[1], "-z"))
+    {
+      compression = EDI_COMPRESSION_AUTO;
+      argv++;
+      argc--;
+    }
+
   if (argc > 1)
-    if (!(stream = fopen (argv[1], "r")))
-      {
-	perror ("Couldn't open file");
-	return -1;
-      }
+    path = argv[1];
   
   printf ("%-3s %-7s %-15s %-15s %-6s %s\n",
 	  "EXT", "SYNTAX", "FROM", "TO", "APPREF", "REFERENCE");
   
-  while (!feof (stream))
+  /* the parser is reset between interchanges by EDI_ParseFileFiltered() */
+
+  if (!EDI_ParseFileFiltered (parser, path, compression))
     {
-      parsed = 0;
-      offset = 0;
-      length = fread (buffer, 1, sizeof (buffer), stream);
-      
-      if (ferror (stream))
-	{
-	  perror ("fread()");
-	  return -1;
-	}
-      
-      while (length && !EDI_GetErrorCode (parser))
-	{
-	  parsed = EDI_Parse (parser, buffer + offset, length, feof (stream));
-	  length -= parsed;
-	  offset += parsed;
-	  
-	  if (EDI_GetErrorCode (parser))
-	    {
-	      fprintf (stderr, "%s at segment %ld\n",
-		       EDI_GetErrorString (EDI_GetErrorCode (parser)),
-		       EDI_GetCurrentSegmentIndex (parser));
-	      return -1;
-	    }
-	  
-	  if (EDI_InterchangeComplete (parser))
-	    EDI_ParserReset (parser);
-	}
+      if (EDI_GetErrorCode (parser))
+	fprintf (stderr, "%s at segment %ld\n",
+		 EDI_GetErrorString (EDI_GetErrorCode (parser)),
+		 EDI_GetCurrentSegmentIndex (parser));
+      else
+	perror ("Couldn't read file");
+      return -1;
     }
   
   EDI_ParserFree (parser);
 
-  fclose(stream);
-
   return 0;
 }
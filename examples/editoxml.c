@@ -71,6 +71,9 @@ char *pyxfile = NULL;
 int terse = 0;
 int pretty = 1;
 int detail = 1;
+EDI_Compression compression = EDI_COMPRESSION_NONE;
+int pipeline = 0;
+int scan = -1;
 
 
 
@@ -79,10 +82,8 @@ int
 main (int argc, char **argv)
 {
   EDI_Parser parser;
-  FILE *stream = stdin;
-  char buffer[4096];
-  int arg, done;
-  size_t length;
+  char *path = NULL, buffer[4096];
+  int arg;
   userdata_t userdata;
 
   memset(&userdata, 0, sizeof(userdata));
@@ -92,12 +93,7 @@ main (int argc, char **argv)
   /* If we were given a filename argument use that instead of stdin */
   
   if (arg && arg < argc)
-    if (!(stream = fopen (argv[arg], "r")))
-      {
-	sprintf(buffer, "Couldn't open file '%s'", argv[arg]);
-	perror (buffer);
-	exit(-1);
-      }
+    path = argv[arg];
   
   /* Parse the TSG if embedded or given on the command line */
   
@@ -125,6 +121,17 @@ main (int argc, char **argv)
   /* each time they are called. We will use this to indent output */
   
   EDI_SetUserData (parser, &userdata);
+
+  /* Tokenise on this thread and do the rest on another if asked to */
+
+  if (pipeline && !EDI_SetPipeline (parser, 1))
+    fprintf (stderr, "Couldn't set up a pipeline - using one thread\n");
+
+  /* Find runs of data some other way than the fastest available - the */
+  /* output should be the same whichever is used */
+
+  if (scan >= 0)
+    EDI_SetScan (parser, (EDI_Scan) scan);
   
   /* Tell the parser to relax the rules on characters which are not */
   /* supposed to be allowed in the message - sometimes service advice */
@@ -169,32 +176,25 @@ main (int argc, char **argv)
 			     NULL);
   xmlprint ("\n");
   
-  /* Now we can start feeding the stream to MEDICI */
+  /* Now we can have MEDICI parse the stream. A file is mapped into */
+  /* memory and parsed where it lies, a pipe is read chunk by chunk */
 
-  do
+  if (!EDI_ParseFileFiltered (parser, path, compression))
     {
-      /* Read in the stream chunk by chunk. If we don't get a whole */
-      /* buffer full of characters the stream is finished */
-      
-      length = fread (buffer, 1, sizeof (buffer), stream);
-      done = length < sizeof (buffer);
-
-      /* Tell MEDICI to parse this chunk. If it is the last chunk */
-      /* the "done" argument will be 1 to indicate this to MEDICI */
-
-      EDI_Parse (parser, buffer, length, done);
-      
-      /* The error code will be non-zero on a fatal error */
+      /* The error code will be non-zero on a fatal error, otherwise */
+      /* the file couldn't be read at all */
 
       if(EDI_GetErrorCode (parser))
+	fprintf (stderr, "%s at segment %ld\n",
+		 EDI_GetErrorString (EDI_GetErrorCode (parser)),
+		 EDI_GetCurrentSegmentIndex (parser));
+      else
 	{
-	  fprintf (stderr, "%s at segment %ld\n",
-		   EDI_GetErrorString (EDI_GetErrorCode (parser)),
-		   EDI_GetCurrentSegmentIndex (parser));
-	  return 1;
+	  sprintf(buffer, "Couldn't open file '%s'", path ? path : "-");
+	  perror (buffer);
 	}
+      return 1;
     }
-  while (!done);
 
   /* Tell MEDICI to free all resources associated with this parse(r) */
 
@@ -203,8 +203,6 @@ main (int argc, char **argv)
   if(directory)
     EDI_DirectoryFree(directory);
 
-  fclose(stream);
-
   return 0;
 }
 
@@ -431,7 +429,7 @@ usage (int n)
 {
   printf
     ("\n"
-     "Usage: editoxml [-t] [-o] [-i] [-v] [-{x|p} <file>] [<edifile>]\n"
+     "Usage: editoxml [-t] [-o] [-i] [-v] [-z] [-P] [-s <scan>] [-{x|p} <file>] [<edifile>]\n"
      "       editoxml -h\n"
      "\n"
      "       -h help (this text)\n"
@@ -439,6 +437,9 @@ usage (int n)
      "       -o outline only - no data elements, just structure\n"
      "       -i no indentation or newlines\n"
      "       -d detailed output - separator characters as well as elements\n"
+     "       -z decompress gzip or zstd compressed input\n"
+     "       -P tokenise and parse on separate threads\n"
+     "       -s find runs of data with none, scalar, sse2 or avx2\n"
      "       -x read directory definition from <xmlfile>\n"
      "       -p read directory definition from <pyxfile>\n"
      "\n");
@@ -449,6 +450,8 @@ usage (int n)
 
 int command_line_options(int argc, char **argv) 
 {
+  /* in the order of EDI_SCAN_NONE ... EDI_SCAN_AVX2 */
+  static char *scans[] = { "none", "scalar", "sse2", "avx2" };
   int optind;
   
   for (optind = 1; argv[optind] && argv[optind][0] == '-'; optind++)
@@ -487,6 +490,24 @@ int command_line_options(int argc, char **argv)
 	case 'd':
 	  detail = 2;
 	  break;
+
+	case 'z':
+	  compression = EDI_COMPRESSION_AUTO;
+	  break;
+
+	case 'P':
+	  pipeline = 1;
+	  break;
+
+	case 's':
+	  if(!argv[++optind])
+	    exit (usage (-1));
+	  for(scan = 0; scan < 4; scan++)
+	    if(!strcmp(argv[optind], scans[scan]))
+	      break;
+	  if(scan == 4)
+	    exit (usage (-1));
+	  break;
 	  
 	case 'h':
 	  exit (usage (0));
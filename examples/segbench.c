@@ -0,0 +1,215 @@
+/*
+
+  The MEDICI Electronic Data Interchange Library
+  Copyright (C) 2002  David Coles
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+/*
+
+  This program measures how quickly segments can be parsed. The
+  files given are read into memory and parsed over and over until
+  the requested amount of data (1024MB by default) has been seen:
+
+  > segbench [-a] [-m megabytes] file...
+
+  Normally only a segment handler is registered, which lets MEDICI
+  skip generating the start/end/character/separator events. With -a
+  handlers are registered for those too, for comparison.
+
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <medici.h>
+
+typedef struct
+{
+  unsigned long segments;
+  unsigned long characters;
+} user_data_t;
+
+
+void
+segment_handler (void *v, EDI_Parameters p, EDI_Segment s, EDI_Directory d)
+{
+  ((user_data_t *) v)->segments++;
+}
+
+void
+start_handler (void *v, EDI_Event event, EDI_Parameters parameters)
+{
+}
+
+void
+end_handler (void *v, EDI_Event event)
+{
+}
+
+void
+character_handler (void *v, const char *text, int size)
+{
+  ((user_data_t *) v)->characters += size;
+}
+
+void
+separator_handler (void *v, EDI_Event event, char s)
+{
+  ((user_data_t *) v)->characters++;
+}
+
+
+/* read a whole file into memory */
+
+char *
+load (char *filename, long *size)
+{
+  FILE *stream;
+  char *data;
+
+  if (!(stream = fopen (filename, "rb")))
+    return NULL;
+
+  fseek (stream, 0, SEEK_END);
+  *size = ftell (stream);
+  rewind (stream);
+
+  if ((data = malloc (*size + 1)) && fread (data, 1, *size, stream) != *size)
+    {
+      free (data);
+      data = NULL;
+    }
+
+  fclose (stream);
+  return data;
+}
+
+
+/* parse all of the interchanges in a buffer, returning the number of
+   bytes parsed or -1 on error */
+
+long
+parse (EDI_Parser parser, char *data, long size)
+{
+  long offset = 0;
+
+  while (offset < size)
+    {
+      offset += EDI_Parse (parser, data + offset, size - offset, 1);
+
+      if (EDI_GetErrorCode (parser))
+	{
+	  fprintf (stderr, "%s at segment %ld\n",
+		   EDI_GetErrorString (EDI_GetErrorCode (parser)),
+		   EDI_GetCurrentSegmentIndex (parser));
+	  return -1;
+	}
+
+      if (!EDI_InterchangeComplete (parser))
+	break;
+
+      EDI_ParserReset (parser);
+    }
+
+  EDI_ParserReset (parser);
+  return size;
+}
+
+
+int
+main (int argc, char **argv)
+{
+  EDI_Parser parser;
+  user_data_t user_data = { 0, 0 };
+  unsigned long target = 1024, total = 0;
+  char **data;
+  long *size, n;
+  int all = 0, files = 0, i;
+  struct timeval start, end;
+  double seconds;
+
+  for (i = 1; i < argc && argv[i][0] == '-'; i++)
+    {
+      if (!strcmp (argv[i], "-a"))
+	all = 1;
+      else if (!strcmp (argv[i], "-m") && i + 1 < argc)
+	target = strtoul (argv[++i], NULL, 10);
+      else
+	break;
+    }
+
+  if ((files = argc - i) < 1)
+    {
+      fprintf (stderr, "usage: %s [-a] [-m megabytes] file...\n", argv[0]);
+      return 1;
+    }
+
+  data = malloc (files * sizeof (char *));
+  size = malloc (files * sizeof (long));
+
+  for (files = 0; i < argc; i++, files++)
+    if (!(data[files] = load (argv[i], &(size[files]))))
+      {
+	perror (argv[i]);
+	return 1;
+      }
+
+  if (!(parser = EDI_ParserCreate ()))
+    {
+      perror ("Couldn't create parser");
+      return 1;
+    }
+
+  EDI_SetUserData (parser, &user_data);
+  EDI_SetSegmentHandler (parser, segment_handler);
+
+  if (all)
+    {
+      EDI_SetStartHandler (parser, start_handler);
+      EDI_SetEndHandler (parser, end_handler);
+      EDI_SetCharacterHandler (parser, character_handler);
+      EDI_SetSeparatorHandler (parser, separator_handler);
+    }
+
+  target *= 1024 * 1024;
+
+  gettimeofday (&start, NULL);
+
+  while (total < target)
+    for (i = 0; i < files && total < target; i++)
+      {
+	if ((n = parse (parser, data[i], size[i])) < 0)
+	  return 1;
+	total += n;
+      }
+
+  gettimeofday (&end, NULL);
+
+  seconds = (end.tv_sec - start.tv_sec) +
+    (end.tv_usec - start.tv_usec) / 1000000.0;
+
+  printf ("%lu bytes, %lu segments in %.3fs: %.1f MB/s, %.0f segments/s\n",
+	  total, user_data.segments, seconds,
+	  total / seconds / (1024 * 1024), user_data.segments / seconds);
+
+  EDI_ParserFree (parser);
+
+  return 0;
+}
@@ -0,0 +1,94 @@
+/*
+  
+  The MEDICI Electronic Data Interchange Library
+  Copyright (C) 2002  David Coles
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+
+
+/*
+
+  This program compiles a TSG into an image which can be mapped with
+  EDI_DirectoryMap(), instead of being parsed every time a program
+  starts:
+
+  > tsgc -x edifact.xml edifact.tsg
+  > describe -m edifact.tsg order.edi
+
+  The image is in the machine's own byte order, so it should be
+  compiled on the kind of machine which is going to use it.
+
+*/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <medici.h>
+
+#include "xmltsg.h"
+
+int
+usage (char *name)
+{
+  fprintf (stderr, "usage: %s {-x xmlfile | -p pyxfile} output\n", name);
+  return 1;
+}
+
+int
+main (int argc, char **argv)
+{
+  EDI_Directory directory;
+  char *xmlfile = NULL, *pyxfile = NULL;
+  int i;
+
+  for (i = 1; i < argc && argv[i][0] == '-'; i++)
+    {
+      if (!strcmp (argv[i], "-x") && i + 1 < argc)
+	xmlfile = argv[++i];
+      else if (!strcmp (argv[i], "-p") && i + 1 < argc)
+	pyxfile = argv[++i];
+      else
+	return usage (argv[0]);
+    }
+
+  if (i + 1 != argc || (!xmlfile == !pyxfile))
+    return usage (argv[0]);
+
+  if (!(directory = xmlfile ?
+	read_xmltsg_file (xmlfile) : read_pyxtsg_file (pyxfile)))
+    {
+      fprintf (stderr, "%s: couldn't read %s\n", argv[0],
+	       xmlfile ? xmlfile : pyxfile);
+      return 1;
+    }
+
+  if (!EDI_DirectoryCompile (directory, argv[i]))
+    {
+      fprintf (stderr, "%s: couldn't write %s\n", argv[0], argv[i]);
+      EDI_DirectoryFree (directory);
+      return 1;
+    }
+
+  EDI_DirectoryFree (directory);
+
+  return 0;
+}
@@ -0,0 +1,296 @@
+/*
+
+  The MEDICI Electronic Data Interchange Library
+  Copyright (C) 2002  David Coles
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+/*
+
+  This program checks that a TSG compiled with tsgc walks transactions
+  just as the XML it was compiled from does:
+
+  > tsgwalk [-n sequences] [-s seed] xmlfile image
+
+  The TSG is read from xmlfile, compiled to image and mapped. For each
+  transaction, segment sequences are made by following its rules at
+  random and then mutated - segments are dropped, repeated, swapped
+  or replaced - and the loop events, segments and errors which each
+  directory gives for them are compared. The first sequence which
+  differs is printed and the program exits with 2.
+
+  Like tokens, it uses the library's internals, to get at the rules
+  and to walk the directories without a parser.
+
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <medici.h>
+#include "../src/internal.h"
+#include "../src/giovanni.h"
+
+#include "xmltsg.h"
+
+#define MAXCODES 256
+
+typedef struct
+{
+  char *code[MAXCODES];
+  unsigned int count;
+} sequence_t;
+
+
+/* the same sequences on every machine, for a given seed */
+static unsigned long seed = 1;
+
+static unsigned int
+rnd (unsigned int n)
+{
+  seed = seed * 1103515245 + 12345;
+  return n ? ((seed >> 16) & 0x7fff) % n : 0;
+}
+
+
+static void
+record (edi_buffer_t *trace, const char *s)
+{
+  if (!edi_buffer_append (trace, (void *) s, strlen (s)))
+    {
+      perror ("edi_buffer_append()");
+      exit (1);
+    }
+}
+
+static void
+start_handler (void *v, edi_event_t event, edi_parameters_t *p)
+{
+  const char *code = p ? edi_parameters_get (p, Code) : NULL;
+
+  record ((edi_buffer_t *) v, "(");
+  record ((edi_buffer_t *) v, code ? code : "?");
+  record ((edi_buffer_t *) v, " ");
+}
+
+static void
+end_handler (void *v, edi_event_t event, edi_parameters_t *p)
+{
+  record ((edi_buffer_t *) v, ") ");
+}
+
+static void
+segment_handler (void *v, edi_parameters_t *p, edi_directory_t *d)
+{
+  const char *code = p ? edi_parameters_get (p, Code) : NULL;
+
+  record ((edi_buffer_t *) v, code ? code : "?");
+  record ((edi_buffer_t *) v, " ");
+}
+
+static void
+walk (edi_directory_t *directory, char *transaction, sequence_t *sequence,
+      edi_buffer_t *trace)
+{
+  char error[32], *code;
+  unsigned int i;
+
+  edi_buffer_reset (trace);
+
+  sprintf (error, "[%d] ", edi_directory_start (directory, transaction));
+  record (trace, error);
+
+  for (i = 0; i <= sequence->count; i++)
+    {
+      /* a null code clears down the stack at the end of the message */
+      code = i < sequence->count ? sequence->code[i] : NULL;
+      sprintf (error, "=%d ", directory->parse (directory, code, trace,
+						start_handler, end_handler,
+						segment_handler));
+      record (trace, error);
+    }
+
+  sprintf (error, "[%d]", directory->end (directory));
+  record (trace, error);
+
+  /* terminated, to compare as a string */
+  if (!edi_buffer_append (trace, "", 1))
+    exit (1);
+}
+
+
+static void
+add (sequence_t *sequence, char *code)
+{
+  if (sequence->count < MAXCODES)
+    sequence->code[sequence->count++] = code;
+}
+
+/* a loop's members, each as many times as the rules allow (up to 3) */
+static void
+follow (edi_gitem_t *container, sequence_t *sequence)
+{
+  edi_gitem_t *gitem;
+  edi_node_t *node;
+  unsigned int reps, n;
+
+  for (node = container->list.first; node; node = node->next)
+    {
+      if (!(gitem = (edi_gitem_t *) node->data))
+	continue;
+
+      reps = gitem->item.reps < 3 ? gitem->item.reps : 3;
+      n = gitem->item.reqr && reps ? 1 + rnd (reps) : rnd (reps + 1);
+
+      while (n--)
+	if (gitem->item.type)
+	  follow (gitem, sequence);
+	else
+	  add (sequence, gitem->item.code);
+    }
+}
+
+static void
+mutate (sequence_t *sequence)
+{
+  unsigned int n, i;
+  char *code;
+
+  for (n = rnd (4); n-- && sequence->count;)
+    {
+      i = rnd (sequence->count);
+
+      switch (rnd (4))
+	{
+	case 0:
+	  memmove (sequence->code + i, sequence->code + i + 1,
+		   (sequence->count - i - 1) * sizeof (char *));
+	  sequence->count--;
+	  break;
+
+	case 1:
+	  if (sequence->count < MAXCODES)
+	    {
+	      memmove (sequence->code + i + 1, sequence->code + i,
+		       (sequence->count - i) * sizeof (char *));
+	      sequence->count++;
+	    }
+	  break;
+
+	case 2:
+	  if (i + 1 < sequence->count)
+	    {
+	      code = sequence->code[i];
+	      sequence->code[i] = sequence->code[i + 1];
+	      sequence->code[i + 1] = code;
+	    }
+	  break;
+
+	default:
+	  sequence->code[i] = rnd (4) ? sequence->code[rnd (sequence->count)] :
+	    "ZZZ";
+	}
+    }
+}
+
+
+static int
+usage (char *name)
+{
+  fprintf (stderr, "usage: %s [-n sequences] [-s seed] xmlfile image\n",
+	   name);
+  return 1;
+}
+
+int
+main (int argc, char **argv)
+{
+  EDI_Directory xml, image;
+  edi_giovanni_t *giovanni;
+  edi_gitem_t *transaction;
+  edi_buffer_t expected, actual;
+  edi_node_t *node;
+  sequence_t sequence;
+  unsigned long count = 1000, n, walked = 0;
+  unsigned int i;
+
+  for (i = 1; i < argc && argv[i][0] == '-'; i++)
+    {
+      if (!strcmp (argv[i], "-n") && i + 1 < argc)
+	count = strtoul (argv[++i], NULL, 10);
+      else if (!strcmp (argv[i], "-s") && i + 1 < argc)
+	seed = strtoul (argv[++i], NULL, 10);
+      else
+	return usage (argv[0]);
+    }
+
+  if (i + 2 != argc)
+    return usage (argv[0]);
+
+  if (!(xml = read_xmltsg_file (argv[i])) ||
+      !(giovanni = edi_giovanni_data ((edi_directory_t *) xml)))
+    {
+      fprintf (stderr, "%s: couldn't read %s\n", argv[0], argv[i]);
+      return 1;
+    }
+
+  if (!EDI_DirectoryCompile (xml, argv[i + 1]) ||
+      !(image = EDI_DirectoryMap (argv[i + 1])))
+    {
+      fprintf (stderr, "%s: couldn't compile %s\n", argv[0], argv[i + 1]);
+      return 1;
+    }
+
+  edi_buffer_init (&expected);
+  edi_buffer_init (&actual);
+
+  for (n = 0; n < count; n++)
+    for (node = giovanni->transactions.first; node; node = node->next)
+      {
+	transaction = (edi_gitem_t *) node->data;
+
+	sequence.count = 0;
+	follow (transaction, &sequence);
+	mutate (&sequence);
+
+	walk ((edi_directory_t *) xml, transaction->item.code, &sequence,
+	      &expected);
+	walk ((edi_directory_t *) image, transaction->item.code, &sequence,
+	      &actual);
+	walked++;
+
+	if (strcmp (edi_buffer_data (&expected), edi_buffer_data (&actual)))
+	  {
+	    printf ("%s:", transaction->item.code);
+	    for (i = 0; i < sequence.count; i++)
+	      printf (" %s", sequence.code[i]);
+	    printf ("\n  %s\n  %s\n", (char *) edi_buffer_data (&expected),
+		    (char *) edi_buffer_data (&actual));
+	    return 2;
+	  }
+      }
+
+  printf ("%lu sequences walked the same way\n", walked);
+
+  edi_buffer_clear (&expected);
+  edi_buffer_clear (&actual);
+  EDI_DirectoryFree (image);
+  EDI_DirectoryFree (xml);
+
+  return 0;
+}
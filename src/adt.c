@@ -446,21 +446,20 @@ void edi_buffer_init (edi_buffer_t *self)
   self->blck = 0;
   self->size = 0;
   self->data = NULL;
+  self->peak = 0;
 }
 
-int edi_buffer_append (edi_buffer_t *self, void *data, unsigned long size)
+#define BLCKMULT 64
+
+/* make room for size characters (and a trailing \0) */
+int edi_buffer_reserve (edi_buffer_t *self, unsigned long size)
 {
   void *ptr;
   unsigned long blck;
 
-  if(!data || !size)
-    return 1;
-
-#define BLCKMULT 64
-  
-  if((self->size + size + 1) > self->blck)
+  if((size + 1) > self->blck)
     {
-      blck = ((self->size + size + 1) / BLCKMULT) + 1; /* +1 for trailing \0 */
+      blck = ((size + 1) / BLCKMULT) + 1; /* +1 for trailing \0 */
       blck *= BLCKMULT;
       ptr = self->data ? realloc(self->data, blck) : malloc(blck);
       if(ptr)
@@ -471,11 +470,26 @@ int edi_buffer_append (edi_buffer_t *self, void *data, unsigned long size)
       else
 	return 0;
     }
+
+  return 1;
+}
+
+int edi_buffer_append (edi_buffer_t *self, void *data, unsigned long size)
+{
+  if(!data || !size)
+    return 1;
+
+  if(!edi_buffer_reserve(self, self->size + size))
+    return 0;
   
   memmove((char *)self->data + self->size, (char *)data, size);
   self->size += size;
   /* mitigate unterminated data being used as a char pointer */
   *((char *) self->data + self->size) = '\0';
+
+  if(self->size > self->peak)
+    self->peak = self->size;
+
   return 1;
 }
 
@@ -487,6 +501,46 @@ void edi_buffer_clear (edi_buffer_t *self)
   self->data = NULL;
 }
 
+/* empty the buffer, keeping its memory for reuse */
+void edi_buffer_reset (edi_buffer_t *self)
+{
+  self->size = 0;
+  if(self->data)
+    *((char *) self->data) = '\0';
+}
+
+/* give back memory beyond what the contents need if the buffer has
+   grown larger than limit */
+void edi_buffer_shrink (edi_buffer_t *self, unsigned long limit)
+{
+  void *ptr;
+  unsigned long blck;
+
+  if(self->blck <= limit)
+    return;
+
+  if(!self->size)
+    {
+      free(self->data);
+      self->data = NULL;
+      self->blck = 0;
+      return;
+    }
+
+  blck = (((self->size + 1) / BLCKMULT) + 1) * BLCKMULT;
+  if(blck < self->blck && (ptr = realloc(self->data, blck)))
+    {
+      self->data = ptr;
+      self->blck = blck;
+    }
+}
+
+/* the largest size the buffer has held */
+unsigned long edi_buffer_peak (edi_buffer_t *self)
+{
+  return self->peak;
+}
+
 unsigned long edi_buffer_size (edi_buffer_t *self)
 {
   return self->size;
@@ -528,6 +582,7 @@ int edi_hash_init
     return 0;
   
   self->size = size;
+  self->count = 0;
   self->cmp = cmpfn ? cmpfn : edi_hash_cmp;
   self->hash = hashfn ? hashfn : edi_hash_hash;
   
@@ -537,13 +592,59 @@ int edi_hash_init
   return 1;
 }
 
+/* rehash into a table about twice the size, moving the nodes rather
+   than making new ones; if there's no memory the chains just get
+   longer */
+static void edi_hash_grow (edi_hash_t *self)
+{
+  edi_list_t *list, *into;
+  edi_node_t *node;
+  unsigned int size = self->size * 2 + 1, n;
+
+  if (!(list = (edi_list_t *) malloc (sizeof (edi_list_t) * size)))
+    return;
+
+  for (n = 0; n < size; n++)
+    edi_list_init (list + n);
+
+  for (n = 0; n < self->size; n++)
+    while ((node = self->list[n].first))
+      {
+	self->list[n].first = node->next;
+
+	into = list + (self->hash (node->key, size) % size);
+	node->prev = NULL;
+	node->next = into->first;
+	if (into->first)
+	  into->first->prev = node;
+	else
+	  into->last = node;
+	into->first = node;
+	into->length++;
+      }
+
+  free (self->list);
+  self->list = list;
+  self->size = size;
+}
+
 int
 edi_hash_store (edi_hash_t *self, void *key, void *data)
 {
   edi_list_t *list;
-  unsigned int hash = self->hash (key, self->size);
+  unsigned long hash; /* as edi_hash_exists() */
+
+  if (self->count >= self->size * 2)
+    edi_hash_grow (self);
+
+  hash = self->hash (key, self->size);
   list = self->list + (hash % self->size);
-  return edi_list_unshift_key (list, key, data);
+
+  if (!edi_list_unshift_key (list, key, data))
+    return 0;
+
+  self->count++;
+  return 1;
 }
 
 void *edi_hash_exists (edi_hash_t *self, void *key)
@@ -590,6 +691,21 @@ edi_hash_clear (edi_hash_t *self, edi_free_t freefn)
   
   for(n = 0; n < self->size; n++)
     edi_list_clear(self->list + n, freefn);
+
+  self->count = 0;
+}
+
+/* as edi_hash_clear(), but the table itself is freed too */
+void
+edi_hash_fini (edi_hash_t *self, edi_free_t freefn)
+{
+  if(!self->list)
+    return;
+
+  edi_hash_clear (self, freefn);
+  free (self->list);
+  self->list = NULL;
+  self->size = 0;
 }
 
 
@@ -54,12 +54,17 @@ typedef struct
   unsigned long blck;
   unsigned long size;
   void *data;
+  unsigned long peak; /* largest size held */
 }
 edi_buffer_t;
 
+/* buffers larger than this give up their memory when shrunk */
+#define EDI_BUFFER_RETAIN 65536
+
 typedef struct
 {
   unsigned int size;
+  unsigned long count; /* number of entries - the table grows with it */
   edi_list_t *list;
   edi_key_compare_t cmp;
   edi_key_hash_t hash;
@@ -118,6 +123,10 @@ void *edi_tree_find(edi_tree_t *, unsigned long);
 void edi_buffer_init(edi_buffer_t *);
 int edi_buffer_append(edi_buffer_t *, void *, unsigned long);
 void edi_buffer_clear(edi_buffer_t *);
+void edi_buffer_reset(edi_buffer_t *);
+int edi_buffer_reserve(edi_buffer_t *, unsigned long);
+void edi_buffer_shrink(edi_buffer_t *, unsigned long);
+unsigned long edi_buffer_peak(edi_buffer_t *);
 unsigned long edi_buffer_size(edi_buffer_t *);
 void *edi_buffer_data(edi_buffer_t *);
 int edi_hash_init(edi_hash_t *, unsigned int, edi_key_compare_t, edi_key_hash_t);
@@ -126,6 +135,7 @@ void *edi_hash_exists(edi_hash_t *, void *);
 void *edi_hash_fetch(edi_hash_t *, void *);
 void edi_hash_traverse(edi_hash_t *, void *, edi_traverse_handler_t);
 void edi_hash_clear(edi_hash_t *, edi_free_t);
+void edi_hash_fini(edi_hash_t *, edi_free_t);
 unsigned long gtk_hash(void *, unsigned int);
 unsigned long tcl_hash(void *, unsigned int);
 unsigned long x31_hash(void *, unsigned int);
@@ -0,0 +1,771 @@
+/*
+
+  The MEDICI Electronic Data Interchange Library
+  Copyright (C) 2002  David Coles
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+/* syscall(), pread() and MAP_POPULATE, whatever -std is given */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define EDI_BATCH_PREAD
+#endif
+
+#if defined(__GNUC__) && (defined(__unix__) || defined(__APPLE__))
+#define EDI_BATCH_THREADS
+#include <pthread.h>
+#endif
+
+/* io_uring is driven through its system calls, so only the kernel
+   headers are needed - and a kernel which can open, read and close
+   files through it (5.6 on), which is checked for at run time */
+#if defined(__linux__) && defined(__GNUC__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#if defined(__NR_io_uring_setup) && defined(IORING_FEAT_RW_CUR_POS)
+#define EDI_BATCH_URING
+#endif
+#endif
+#endif
+
+#include "internal.h"
+
+/** \file batch.c
+
+    \brief Parses a batch of files, many of which are being read at
+    once.
+
+    When there are a lot of small files, opening, reading and closing
+    each of them costs more than parsing it. The calling thread keeps
+    a number of files in flight - on Linux by queueing the opens,
+    reads and closes on an io_uring, so that a single system call
+    starts many and collects whatever has finished - and hands each
+    file, once read, to a parser checked out of a pool. Other threads
+    only parse; the calling thread parses too whenever it has nothing
+    better to do. Where io_uring isn't available each file is read by
+    the calling thread with open() and pread() in turn.
+
+    Each file is read into a buffer of its own, which is kept for the
+    next file once the one in it has been parsed, so that the number
+    of files read ahead of the parsers is bounded by the number of
+    buffers. Threads with nothing to do - the other threads while
+    files are being read, the calling thread while every buffer is
+    being parsed - sleep until there is.
+
+*/
+
+/**
+   \defgroup edi_batch edi_batch
+   \{
+*/
+
+
+/* a file being read, waiting to be parsed or, if the end handler is
+   called in order, waiting for its turn */
+typedef struct
+{
+  unsigned long index;
+
+  char *data;
+  unsigned long size, capacity;
+
+  /* the open file, or -1 */
+  int fd;
+
+  /* non-zero (errno, if known) if the file couldn't be read */
+  int failed;
+
+  /* the start handler's data and the error which stopped the parser,
+     kept until the end handler is called */
+  void *user_data;
+  edi_error_t error;
+}
+edi_batch_file_t;
+
+#ifdef EDI_BATCH_URING
+/* the submission and completion queues shared with the kernel */
+typedef struct
+{
+  int fd;
+
+  /* entries in the submission queue, those filled in but not yet
+     submitted, and operations which the kernel has yet to complete */
+  unsigned int entries, queued, inflight;
+
+  unsigned int *sq_head, *sq_tail, *sq_mask, *sq_array;
+  unsigned int *cq_head, *cq_tail, *cq_mask;
+  struct io_uring_sqe *sqe;
+  struct io_uring_cqe *cqe;
+
+  void *sq_ring, *cq_ring;
+  size_t sq_size, cq_size, sqe_size;
+}
+edi_batch_ring_t;
+#endif
+
+typedef struct
+{
+  const char **path;
+  unsigned long count;
+
+  edi_parser_pool_t *pool;
+  edi_parallel_handlers_t *handlers;
+  edi_batch_stats_t *stats;
+
+  /* a buffer for each file which may be read ahead */
+  edi_batch_file_t *file;
+  unsigned int depth;
+
+  /* buffers not in use */
+  edi_batch_file_t **spare;
+  unsigned int spares;
+
+  /* files which have been read, in the order they finished, from
+     ready[head % depth] to ready[(tail - 1) % depth] */
+  edi_batch_file_t **ready;
+  unsigned long head, tail;
+
+  /* hands the files to the end handler, and their buffers back to
+     spare - the window is depth, as that many files at most can be
+     waiting for the end handler */
+  edi_parallel_order_t order;
+
+  /* the next file to be read, and non-zero once all of them have */
+  unsigned long next;
+  int finished;
+
+#ifdef EDI_BATCH_URING
+  edi_batch_ring_t ring;
+  int uring;
+#endif
+
+  /* guards the spare buffers, the ready files and finished - the
+     parsers are woken as files are read, and the reader as buffers are
+     given back */
+  edi_lock_t lock;
+  edi_cond_t ready_wake, spare_wake;
+}
+edi_batch_t;
+
+
+/* makes room for more of a file, returning zero on failure */
+static int edi_batch_grow (edi_batch_file_t *file)
+{
+  unsigned long capacity;
+  char *data;
+
+  capacity = file->capacity ? file->capacity * 2 : EDI_BATCH_BUFFER;
+
+  if (!(data = realloc (file->data, capacity)))
+    return 0;
+
+  file->data = data;
+  file->capacity = capacity;
+  return 1;
+}
+
+/* takes a spare buffer, or returns NULL if there are none */
+static edi_batch_file_t *edi_batch_spare (edi_batch_t *self)
+{
+  edi_batch_file_t *file = NULL;
+
+  edi_lock (&(self->lock));
+  if (self->spares)
+    file = self->spare[--self->spares];
+  edi_unlock (&(self->lock));
+
+  return file;
+}
+
+/* queues a file which has been read (or failed to be) for a parser */
+static void edi_batch_ready (edi_batch_t *self, edi_batch_file_t *file)
+{
+  self->stats->files++;
+  self->stats->bytes += file->size;
+  if (file->failed)
+    self->stats->failed++;
+
+  edi_lock (&(self->lock));
+  self->ready[self->tail++ % self->depth] = file;
+  edi_cond_signal (&(self->ready_wake));
+  edi_unlock (&(self->lock));
+}
+
+/* takes the file which was read first - if there are none waiting,
+   either returning zero or, if asked to wait, sleeping until one has
+   been read or all of them have */
+static int edi_batch_take
+(edi_batch_t *self, edi_batch_file_t **file, int wait)
+{
+  int taken = 0;
+
+  edi_lock (&(self->lock));
+
+  while (wait && self->head == self->tail && !self->finished)
+    edi_cond_wait (&(self->ready_wake), &(self->lock));
+
+  if (self->head < self->tail)
+    {
+      *file = self->ready[self->head++ % self->depth];
+      taken = 1;
+    }
+
+  edi_unlock (&(self->lock));
+
+  return taken;
+}
+
+/* gives back the buffer of a file which has been given to the end
+   handler, for the next file */
+static void edi_batch_release (void *owner, void *item)
+{
+  edi_batch_t *self = (edi_batch_t *) owner;
+
+  edi_lock (&(self->lock));
+  self->spare[self->spares++] = (edi_batch_file_t *) item;
+  edi_cond_signal (&(self->spare_wake));
+  edi_unlock (&(self->lock));
+}
+
+/* sleeps until a parser has given back a buffer */
+static void edi_batch_wait_spare (edi_batch_t *self)
+{
+  edi_lock (&(self->lock));
+  while (!self->spares)
+    edi_cond_wait (&(self->spare_wake), &(self->lock));
+  edi_unlock (&(self->lock));
+}
+
+/* parses a file which has been read with a parser from the pool */
+static void edi_batch_parse_file (edi_batch_t *self, edi_batch_file_t *file)
+{
+  edi_parallel_handlers_t *h = self->handlers;
+  edi_parser_t *parser;
+
+  file->user_data = NULL;
+
+  if (file->failed)
+    file->error = EDI_EREAD;
+  else if (!(parser = edi_parser_pool_get (self->pool)))
+    file->error = EDI_ENOMEM;
+  else
+    {
+      if (h->start)
+	file->user_data = h->start (h->user_data, parser, file->index);
+
+      file->error = edi_input_parse (parser, file->data, file->size);
+      edi_parser_pool_put (self->pool, parser);
+    }
+
+  edi_parallel_order_deliver (&(self->order), file->index, file->user_data,
+			      file->error, file);
+}
+
+#if defined(EDI_BATCH_THREADS)
+/* parses files as they are read until there are none left */
+static void *edi_batch_work (void *v)
+{
+  edi_batch_t *self = (edi_batch_t *) v;
+  edi_batch_file_t *file;
+
+  while (edi_batch_take (self, &file, 1))
+    edi_batch_parse_file (self, file);
+
+  return NULL;
+}
+#endif
+
+/* reads a whole file in, with nothing else in flight */
+static void edi_batch_read (edi_batch_t *self, edi_batch_file_t *file)
+{
+  const char *path = self->path[file->index];
+#ifdef EDI_BATCH_PREAD
+  long n;
+
+  if ((file->fd = open (path, O_RDONLY)) < 0)
+    {
+      file->failed = errno ? errno : 1;
+      return;
+    }
+
+  do
+    {
+      if (file->size == file->capacity && !edi_batch_grow (file))
+	{
+	  file->failed = ENOMEM;
+	  break;
+	}
+
+      n = pread (file->fd, file->data + file->size,
+		 file->capacity - file->size, file->size);
+
+      if (n < 0 && errno != EINTR)
+	file->failed = errno ? errno : 1;
+      else if (n > 0)
+	file->size += n;
+    }
+  while (n && !file->failed);
+
+  close (file->fd);
+  file->fd = -1;
+#else
+  FILE *stream;
+  unsigned long n;
+
+  if (!(stream = fopen (path, "rb")))
+    {
+      file->failed = errno ? errno : 1;
+      return;
+    }
+
+  do
+    {
+      if (file->size == file->capacity && !edi_batch_grow (file))
+	{
+	  file->failed = ENOMEM;
+	  break;
+	}
+
+      n = fread (file->data + file->size, 1, file->capacity - file->size,
+		 stream);
+      file->size += n;
+    }
+  while (n);
+
+  if (ferror (stream))
+    file->failed = EIO;
+
+  fclose (stream);
+#endif
+}
+
+#ifdef EDI_BATCH_URING
+static void edi_batch_ring_fini (edi_batch_ring_t *ring)
+{
+  if (ring->sqe)
+    munmap (ring->sqe, ring->sqe_size);
+  if (ring->cq_ring && ring->cq_ring != ring->sq_ring)
+    munmap (ring->cq_ring, ring->cq_size);
+  if (ring->sq_ring)
+    munmap (ring->sq_ring, ring->sq_size);
+  if (ring->fd >= 0)
+    close (ring->fd);
+
+  memset (ring, 0, sizeof (edi_batch_ring_t));
+  ring->fd = -1;
+}
+
+/* sets up a ring with room for at least the given number of
+   operations in flight, returning zero if the kernel can't */
+static int edi_batch_ring_init (edi_batch_ring_t *ring, unsigned int entries)
+{
+  struct io_uring_params p;
+  void *ptr;
+  char *sq, *cq;
+
+  memset (ring, 0, sizeof (edi_batch_ring_t));
+  memset (&p, 0, sizeof (p));
+
+  if ((ring->fd = syscall (__NR_io_uring_setup, entries, &p)) < 0)
+    return 0;
+
+  /* reads at a given offset, opens and closes came with this */
+  if (!(p.features & IORING_FEAT_RW_CUR_POS))
+    goto fail;
+
+  ring->sq_size = p.sq_off.array + p.sq_entries * sizeof (unsigned int);
+  ring->cq_size = p.cq_off.cqes + p.cq_entries * sizeof (struct io_uring_cqe);
+  ring->sqe_size = p.sq_entries * sizeof (struct io_uring_sqe);
+
+  if (p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+      if (ring->cq_size > ring->sq_size)
+	ring->sq_size = ring->cq_size;
+      ring->cq_size = ring->sq_size;
+    }
+
+  if ((ptr = mmap (NULL, ring->sq_size, PROT_READ | PROT_WRITE,
+		   MAP_SHARED | MAP_POPULATE, ring->fd,
+		   IORING_OFF_SQ_RING)) == MAP_FAILED)
+    goto fail;
+  ring->sq_ring = ptr;
+
+  if (p.features & IORING_FEAT_SINGLE_MMAP)
+    ring->cq_ring = ring->sq_ring;
+  else if ((ptr = mmap (NULL, ring->cq_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, ring->fd,
+			IORING_OFF_CQ_RING)) == MAP_FAILED)
+    goto fail;
+  else
+    ring->cq_ring = ptr;
+
+  if ((ptr = mmap (NULL, ring->sqe_size, PROT_READ | PROT_WRITE,
+		   MAP_SHARED | MAP_POPULATE, ring->fd,
+		   IORING_OFF_SQES)) == MAP_FAILED)
+    goto fail;
+  ring->sqe = (struct io_uring_sqe *) ptr;
+
+  sq = (char *) ring->sq_ring;
+  ring->sq_head = (unsigned int *) (sq + p.sq_off.head);
+  ring->sq_tail = (unsigned int *) (sq + p.sq_off.tail);
+  ring->sq_mask = (unsigned int *) (sq + p.sq_off.ring_mask);
+  ring->sq_array = (unsigned int *) (sq + p.sq_off.array);
+
+  cq = (char *) ring->cq_ring;
+  ring->cq_head = (unsigned int *) (cq + p.cq_off.head);
+  ring->cq_tail = (unsigned int *) (cq + p.cq_off.tail);
+  ring->cq_mask = (unsigned int *) (cq + p.cq_off.ring_mask);
+  ring->cqe = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+
+  ring->entries = p.sq_entries;
+  return 1;
+
+ fail:
+  edi_batch_ring_fini (ring);
+  return 0;
+}
+
+/* the next submission queue entry, cleared - there is always one, as
+   no more operations are queued than there are entries */
+static struct io_uring_sqe *edi_batch_ring_sqe
+(edi_batch_ring_t *ring, int opcode, int fd, edi_batch_file_t *file)
+{
+  struct io_uring_sqe *sqe;
+  unsigned int tail, index;
+
+  tail = *ring->sq_tail;
+  index = tail & *ring->sq_mask;
+
+  sqe = ring->sqe + index;
+  memset (sqe, 0, sizeof (struct io_uring_sqe));
+  sqe->opcode = opcode;
+  sqe->fd = fd;
+  sqe->user_data = (unsigned long) file;
+
+  ring->sq_array[index] = index;
+  __atomic_store_n (ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+  ring->queued++;
+  ring->inflight++;
+
+  return sqe;
+}
+
+/* reads the next part of a file */
+static void edi_batch_ring_read (edi_batch_ring_t *ring,
+				 edi_batch_file_t *file)
+{
+  struct io_uring_sqe *sqe;
+
+  sqe = edi_batch_ring_sqe (ring, IORING_OP_READ, file->fd, file);
+  sqe->addr = (unsigned long) (file->data + file->size);
+  sqe->len = file->capacity - file->size;
+  sqe->off = file->size;
+}
+
+/* closes a file, which is then ready to be parsed */
+static void edi_batch_ring_close (edi_batch_t *self, edi_batch_file_t *file)
+{
+  edi_batch_ring_sqe (&(self->ring), IORING_OP_CLOSE, file->fd, NULL);
+  file->fd = -1;
+  edi_batch_ready (self, file);
+}
+
+/* takes the next step with a file once its last operation is done */
+static void edi_batch_ring_complete
+(edi_batch_t *self, edi_batch_file_t *file, int result)
+{
+  if (!file)
+    return;
+
+  if (result < 0)
+    {
+      file->failed = -result;
+
+      if (file->fd >= 0)
+	edi_batch_ring_close (self, file);
+      else
+	edi_batch_ready (self, file);
+      return;
+    }
+
+  if (file->fd < 0)
+    file->fd = result;
+  else if (!result)
+    {
+      edi_batch_ring_close (self, file);
+      return;
+    }
+  else
+    file->size += result;
+
+  if (file->size == file->capacity && !edi_batch_grow (file))
+    {
+      file->failed = ENOMEM;
+      edi_batch_ring_close (self, file);
+      return;
+    }
+
+  edi_batch_ring_read (&(self->ring), file);
+}
+
+/* submits whatever has been queued, waiting for at least one
+   operation to complete if asked to, and then deals with those which
+   have */
+static void edi_batch_ring_enter (edi_batch_t *self, int wait)
+{
+  edi_batch_ring_t *ring = &(self->ring);
+  struct io_uring_cqe *cqe;
+  unsigned int head, tail;
+  long n;
+
+  n = syscall (__NR_io_uring_enter, ring->fd, ring->queued, wait ? 1 : 0,
+	       wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+
+  if (n > 0)
+    ring->queued -= n;
+
+  head = *ring->cq_head;
+  tail = __atomic_load_n (ring->cq_tail, __ATOMIC_ACQUIRE);
+
+  while (head != tail)
+    {
+      cqe = ring->cqe + (head++ & *ring->cq_mask);
+      ring->inflight--;
+      edi_batch_ring_complete (self,
+			       (edi_batch_file_t *) (unsigned long)
+			       cqe->user_data, cqe->res);
+    }
+
+  __atomic_store_n (ring->cq_head, head, __ATOMIC_RELEASE);
+}
+#endif
+
+/* starts reading a file into a spare buffer */
+static void edi_batch_start (edi_batch_t *self, edi_batch_file_t *file)
+{
+  file->index = self->next++;
+  file->size = 0;
+  file->fd = -1;
+  file->failed = 0;
+
+#ifdef EDI_BATCH_URING
+  if (self->uring)
+    {
+      struct io_uring_sqe *sqe;
+
+      /* buffers are allocated when first used */
+      if (!file->capacity && !edi_batch_grow (file))
+	{
+	  file->failed = ENOMEM;
+	  edi_batch_ready (self, file);
+	  return;
+	}
+
+      sqe = edi_batch_ring_sqe (&(self->ring), IORING_OP_OPENAT, AT_FDCWD,
+				file);
+      sqe->addr = (unsigned long) self->path[file->index];
+      sqe->open_flags = O_RDONLY;
+      return;
+    }
+#endif
+
+  edi_batch_read (self, file);
+  edi_batch_ready (self, file);
+}
+
+/* reads the files, parsing them too when there's nothing to read */
+static void edi_batch_read_all (edi_batch_t *self)
+{
+  edi_batch_file_t *file;
+
+  for (;;)
+    {
+      while (self->next < self->count && (file = edi_batch_spare (self)))
+	edi_batch_start (self, file);
+
+#ifdef EDI_BATCH_URING
+      if (self->uring && self->ring.inflight)
+	{
+	  int waiting;
+
+	  /* if nothing has been read there is nothing else to do */
+	  edi_lock (&(self->lock));
+	  waiting = self->head < self->tail;
+	  edi_unlock (&(self->lock));
+
+	  edi_batch_ring_enter (self, !waiting);
+	}
+#endif
+
+      if (edi_batch_take (self, &file, 0))
+	edi_batch_parse_file (self, file);
+#ifdef EDI_BATCH_URING
+      else if (self->uring && self->ring.inflight)
+	continue;
+#endif
+      else if (self->next < self->count)
+	/* every buffer is being parsed, or waiting for the end handler */
+	edi_batch_wait_spare (self);
+      else
+	break;
+    }
+
+  edi_lock (&(self->lock));
+  self->finished = 1;
+  edi_cond_broadcast (&(self->ready_wake));
+  edi_unlock (&(self->lock));
+}
+
+/**
+   \brief Reads and parses a batch of files.
+   \param pool Pool to check parsers out of, or NULL for one which
+   lasts as long as the batch.
+   \param path Names of the files.
+   \param count Number of files.
+   \param threads The number of threads to parse on, or zero for one
+   for each processor.
+   \param depth The most files to have read, or be reading, ahead of
+   the parsers, or zero for EDI_BATCH_DEPTH.
+   \param handlers Handlers to set up and finish each file, which is
+   identified to them by its index in path.
+   \param stats Filled in with totals for the batch, if not NULL.
+   \return The number of files, or -1 on failure.
+
+   The calling thread is one of the threads, and this returns once
+   every file has been given to the end handler. A file which couldn't
+   be read isn't given to the start handler, and is given to the end
+   handler with the error EDI_EREAD.
+*/
+long
+edi_batch_parse (edi_parser_pool_t *pool, const char **path,
+		 unsigned long count, unsigned int threads,
+		 unsigned int depth, edi_parallel_handlers_t *handlers,
+		 edi_batch_stats_t *stats)
+{
+  edi_batch_stats_t totals;
+  edi_batch_t self;
+  unsigned int n;
+  long result = -1;
+#if defined(EDI_BATCH_THREADS)
+  pthread_t *thread = NULL;
+  unsigned int started = 0;
+
+  if (!threads)
+    {
+      long online = sysconf (_SC_NPROCESSORS_ONLN);
+      threads = online > 0 ? online : 1;
+    }
+#else
+  threads = 1;
+#endif
+
+  if (!stats)
+    stats = &totals;
+
+  memset (&self, 0, sizeof (edi_batch_t));
+  memset (stats, 0, sizeof (edi_batch_stats_t));
+  self.path = path;
+  self.count = count;
+  self.handlers = handlers;
+  self.stats = stats;
+  self.depth = depth ? depth : EDI_BATCH_DEPTH;
+  self.pool = pool;
+
+  if (!pool && !(self.pool = edi_parser_pool_create (threads)))
+    return -1;
+
+  edi_lock_init (&(self.lock));
+  edi_cond_init (&(self.ready_wake));
+  edi_cond_init (&(self.spare_wake));
+
+  if (!edi_parallel_order_init (&(self.order), handlers, self.depth, 0) ||
+      !(self.file = calloc (self.depth, sizeof (edi_batch_file_t))) ||
+      !(self.spare = malloc (self.depth * sizeof (edi_batch_file_t *))) ||
+      !(self.ready = malloc (self.depth * sizeof (edi_batch_file_t *))))
+    goto out;
+
+  self.order.release = edi_batch_release;
+  self.order.owner = &self;
+
+  for (n = 0; n < self.depth; n++)
+    {
+      self.file[n].fd = -1;
+      self.spare[self.spares++] = self.file + self.depth - n - 1;
+    }
+
+#ifdef EDI_BATCH_URING
+  /* an open or read for every buffer, and a close for each too */
+  self.uring = edi_batch_ring_init (&(self.ring), self.depth * 2);
+#endif
+
+#if defined(EDI_BATCH_THREADS)
+  /* if a thread can't be started the others take up its share */
+  if (threads > 1 && (thread = malloc ((threads - 1) * sizeof (pthread_t))))
+    for (n = 1; n < threads; n++)
+      if (!pthread_create (thread + started, NULL, edi_batch_work, &self))
+	started++;
+#endif
+
+  edi_batch_read_all (&self);
+
+#if defined(EDI_BATCH_THREADS)
+  for (n = 0; n < started; n++)
+    pthread_join (thread[n], NULL);
+  free (thread);
+#endif
+
+#ifdef EDI_BATCH_URING
+  if (self.uring)
+    edi_batch_ring_fini (&(self.ring));
+#endif
+
+  result = count;
+
+ out:
+  for (n = 0; self.file && n < self.depth; n++)
+    free (self.file[n].data);
+
+  free (self.file);
+  free (self.spare);
+  free (self.ready);
+
+  edi_parallel_order_fini (&(self.order));
+  edi_cond_destroy (&(self.spare_wake));
+  edi_cond_destroy (&(self.ready_wake));
+  edi_lock_destroy (&(self.lock));
+
+  if (!pool)
+    edi_parser_pool_free (self.pool);
+
+  return result;
+}
+
+/** \} */
@@ -0,0 +1,46 @@
+/*
+
+  The MEDICI Electronic Data Interchange Library
+  Copyright (C) 2002  David Coles
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+#ifndef BATCH_H
+#define BATCH_H
+
+/* files read ahead of the parsers by default */
+#define EDI_BATCH_DEPTH 64
+
+/* initial size of the buffer each file is read into */
+#define EDI_BATCH_BUFFER 65536
+
+/** \brief Totals for a batch of files */
+typedef struct
+{
+  /** \brief Files given to the end handler, and those of them which
+      couldn't be read */
+  unsigned long files, failed;
+
+  /** \brief Bytes read */
+  edi_offset_t bytes;
+}
+edi_batch_stats_t;
+
+/* batch.c */
+long edi_batch_parse(edi_parser_pool_t *, const char **, unsigned long, unsigned int, unsigned int, edi_parallel_handlers_t *, edi_batch_stats_t *);
+
+#endif /*BATCH_H*/
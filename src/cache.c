@@ -0,0 +1,374 @@
+/*
+
+  The MEDICI Electronic Data Interchange Library
+  Copyright (C) 2002  David Coles
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "internal.h"
+
+/** \file cache.c
+
+    \brief A thread-safe cache of message directories.
+
+    Directories are found by the agency, version, release and type of
+    the message they describe. Like the parser pool, the entries are
+    guarded by a mutex which is only held while they are looked up or
+    rearranged; the loader runs outside of it, and other threads
+    wanting the same directory sleep until it has finished.
+
+*/
+
+/**
+   \defgroup edi_directory_cache edi_directory_cache
+   \{
+*/
+
+
+#define EDI_CACHE_BUCKETS 64
+
+/* keys are short - only very long ones need allocating */
+#define EDI_CACHE_KEY 128
+
+
+static unsigned long edi_directory_cache_hash (const char *s)
+{
+  unsigned long h = 0;
+
+  for (; *s; s++)
+    h = (h << 5) - h + (unsigned char) *s;
+
+  return h;
+}
+
+/* joins the parameters which identify a directory into the buffer, or
+   an allocated string if they won't fit; missing ones are empty */
+static char *edi_directory_cache_key
+(edi_parameters_t *p, char *buffer, unsigned long size)
+{
+  static const edi_parameter_t part[] = {
+    ControllingAgency, MessageVersionNumber,
+    MessageReleaseNumber, MessageType
+  };
+  const char *value[4];
+  unsigned long length = 0, n;
+  char *key, *k;
+
+  for (n = 0; n < 4; n++)
+    {
+      if (!(value[n] = edi_parameters_get (p, part[n])))
+	value[n] = "";
+      length += strlen (value[n]) + 1;
+    }
+
+  if (length <= size)
+    key = buffer;
+  else if (!(key = malloc (length)))
+    return NULL;
+
+  for (k = key, n = 0; n < 4; n++)
+    {
+      length = strlen (value[n]);
+      memcpy (k, value[n], length);
+      k += length;
+      *k++ = n < 3 ? '\037' : '\0';
+    }
+
+  return key;
+}
+
+/* the link in the bucket chain which points, or would point, to the
+   entry with this key */
+static edi_directory_entry_t **edi_directory_cache_find
+(edi_directory_cache_t *self, const char *key, unsigned long hash)
+{
+  edi_directory_entry_t **link = self->bucket + (hash % self->buckets);
+
+  while (*link && ((*link)->hash != hash || strcmp ((*link)->key, key)))
+    link = &((*link)->chain);
+
+  return link;
+}
+
+/* doubles the number of buckets, if memory allows */
+static void edi_directory_cache_grow (edi_directory_cache_t *self)
+{
+  edi_directory_entry_t **bucket, *e, *chain;
+  unsigned int buckets = self->buckets * 2, n;
+
+  if (!(bucket = calloc (buckets, sizeof (edi_directory_entry_t *))))
+    return;
+
+  for (n = 0; n < self->buckets; n++)
+    for (e = self->bucket[n]; e; e = chain)
+      {
+	chain = e->chain;
+	e->chain = bucket[e->hash % buckets];
+	bucket[e->hash % buckets] = e;
+      }
+
+  free (self->bucket);
+  self->bucket = bucket;
+  self->buckets = buckets;
+}
+
+static void edi_directory_cache_unlink
+(edi_directory_cache_t *self, edi_directory_entry_t *e)
+{
+  if (e->newer)
+    e->newer->older = e->older;
+  else
+    self->newest = e->older;
+
+  if (e->older)
+    e->older->newer = e->newer;
+  else
+    self->oldest = e->newer;
+
+  e->newer = e->older = NULL;
+}
+
+static void edi_directory_cache_link
+(edi_directory_cache_t *self, edi_directory_entry_t *e)
+{
+  e->newer = NULL;
+  e->older = self->newest;
+
+  if (self->newest)
+    self->newest->newer = e;
+  else
+    self->oldest = e;
+
+  self->newest = e;
+}
+
+/* takes the least recently used entries which no parser is holding
+   out of the cache until it is within budget, returning them chained
+   together to be freed once the lock has been released */
+static edi_directory_entry_t *
+edi_directory_cache_evict (edi_directory_cache_t *self)
+{
+  edi_directory_entry_t *dead = NULL, *e, *newer, **link;
+
+  if (!self->budget)
+    return NULL;
+
+  for (e = self->oldest; e && self->size > self->budget; e = newer)
+    {
+      newer = e->newer;
+
+      if (e->users)
+	continue;
+
+      edi_directory_cache_unlink (self, e);
+
+      for (link = self->bucket + (e->hash % self->buckets);
+	   *link != e; link = &((*link)->chain));
+      *link = e->chain;
+
+      self->count--;
+      self->size -= e->size;
+
+      e->chain = dead;
+      dead = e;
+    }
+
+  return dead;
+}
+
+static void edi_directory_cache_release (edi_directory_entry_t *e)
+{
+  edi_directory_entry_t *chain;
+
+  for (; e; e = chain)
+    {
+      chain = e->chain;
+      edi_directory_free (e->directory);
+      free (e);
+    }
+}
+
+
+/**
+   \brief Creates a cache of directories.
+   \param loader Function which loads the directory for a message.
+   \param user Argument for the loader.
+   \param budget The most memory, in bytes, the unused directories in
+   the cache may take up, or zero for no limit.
+   \return Pointer to the cache, or NULL on failure.
+*/
+edi_directory_cache_t *
+edi_directory_cache_create (edi_directory_loader_t loader, void *user,
+			    unsigned long budget)
+{
+  edi_directory_cache_t *self;
+
+  if (!(self = (edi_directory_cache_t *)
+	malloc (sizeof (edi_directory_cache_t))))
+    return NULL;
+
+  memset (self, 0, sizeof (edi_directory_cache_t));
+  self->loader = loader;
+  self->user_data = user;
+  self->budget = budget;
+  self->buckets = EDI_CACHE_BUCKETS;
+
+  if (!(self->bucket = calloc (self->buckets,
+			       sizeof (edi_directory_entry_t *))))
+    {
+      free (self);
+      return NULL;
+    }
+
+  edi_lock_init (&(self->lock));
+  edi_cond_init (&(self->loaded));
+
+  return self;
+}
+
+/**
+   \brief Frees a cache and the directories in it.
+   \param self Pointer to the cache, which no parser may be using.
+*/
+void
+edi_directory_cache_free (edi_directory_cache_t *self)
+{
+  edi_directory_entry_t *e, *older;
+
+  if (!self)
+    return;
+
+  for (e = self->newest; e; e = older)
+    {
+      older = e->older;
+      edi_directory_free (e->directory);
+      free (e);
+    }
+
+  edi_cond_destroy (&(self->loaded));
+  edi_lock_destroy (&(self->lock));
+  free (self->bucket);
+  free (self);
+}
+
+/**
+   \brief Finds the directory for a message, loading it if need be.
+   \param self Pointer to the cache.
+   \param p The parameters of the message header.
+   \return The entry holding the directory, or NULL on failure.
+
+   The directory is found by the ControllingAgency,
+   MessageVersionNumber, MessageReleaseNumber and MessageType
+   parameters. It is held until the entry is given back with
+   edi_directory_cache_put(), and may be NULL if the loader found
+   none - which is remembered too, so that the loader is not asked
+   again for every message.
+*/
+edi_directory_entry_t *
+edi_directory_cache_get (edi_directory_cache_t *self, edi_parameters_t *p)
+{
+  edi_directory_entry_t *e, **link, *dead;
+  char buffer[EDI_CACHE_KEY], *key;
+  unsigned long hash, length, size = 0;
+  int load = 0;
+
+  if (!(key = edi_directory_cache_key (p, buffer, sizeof (buffer))))
+    return NULL;
+
+  hash = edi_directory_cache_hash (key);
+  length = strlen (key) + 1;
+
+  edi_lock (&(self->lock));
+
+  if ((e = *(link = edi_directory_cache_find (self, key, hash))))
+    {
+      e->users++;
+      edi_directory_cache_unlink (self, e);
+      edi_directory_cache_link (self, e);
+
+      /* another thread is loading it */
+      while (!e->loaded)
+	edi_cond_wait (&(self->loaded), &(self->lock));
+    }
+  else if ((e = malloc (sizeof (edi_directory_entry_t) + length)))
+    {
+      memset (e, 0, sizeof (edi_directory_entry_t));
+      e->key = (char *) (e + 1);
+      memcpy (e->key, key, length);
+      e->hash = hash;
+      e->users = 1;
+
+      *link = e;
+      edi_directory_cache_link (self, e);
+
+      if (++self->count > self->buckets * 2)
+	edi_directory_cache_grow (self);
+
+      load = 1;
+    }
+
+  edi_unlock (&(self->lock));
+
+  if (key != buffer)
+    free (key);
+
+  if (!load)
+    return e;
+
+  /* nobody else will touch the new entry until it is loaded */
+
+  if (self->loader)
+    e->directory = self->loader (self->user_data, p, &size);
+
+  edi_lock (&(self->lock));
+  e->size = size + sizeof (edi_directory_entry_t) + length;
+  e->loaded = 1;
+  edi_cond_broadcast (&(self->loaded));
+  self->size += e->size;
+  dead = edi_directory_cache_evict (self);
+  edi_unlock (&(self->lock));
+
+  edi_directory_cache_release (dead);
+
+  return e;
+}
+
+/**
+   \brief Gives back a directory held with edi_directory_cache_get().
+   \param self Pointer to the cache.
+   \param e The entry, which must not be used again by the caller.
+*/
+void
+edi_directory_cache_put (edi_directory_cache_t *self, edi_directory_entry_t *e)
+{
+  edi_directory_entry_t *dead;
+
+  if (!e)
+    return;
+
+  edi_lock (&(self->lock));
+  e->users--;
+  dead = edi_directory_cache_evict (self);
+  edi_unlock (&(self->lock));
+
+  edi_directory_cache_release (dead);
+}
+
+/** \} */
@@ -0,0 +1,98 @@
+/*
+
+  The MEDICI Electronic Data Interchange Library
+  Copyright (C) 2002  David Coles
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+#ifndef CACHE_H
+#define CACHE_H
+
+/**
+   \brief Loads the directory for a message
+
+   Called with the cache's user data and the parameters of the message
+   header. Should return the directory (or NULL if there is none) and
+   store the memory it uses, in bytes, in the unsigned long.
+*/
+typedef edi_directory_t *(*edi_directory_loader_t)
+     (void *, edi_parameters_t *, unsigned long *);
+
+typedef struct edi_directory_entry_s edi_directory_entry_t;
+
+/** \brief A directory in the cache, loaded or being loaded */
+struct edi_directory_entry_s
+{
+  /** \brief Agency, version, release and message type, separated by
+      US (0x1f) characters */
+  char *key;
+  unsigned long hash;
+
+  edi_directory_t *directory;
+
+  /** \brief Bytes charged against the cache's budget */
+  unsigned long size;
+
+  /** \brief Parsers holding the directory */
+  unsigned int users;
+
+  /** \brief Zero while the loader is running */
+  int loaded;
+
+  /** \brief Next entry in the same bucket */
+  edi_directory_entry_t *chain;
+
+  /** \brief Neighbours in order of use */
+  edi_directory_entry_t *newer, *older;
+};
+
+/**
+   \brief A cache of message directories
+
+   Directories are loaded the first time a message needs them, and
+   the least recently used are freed once the total size goes over
+   the budget - though never while a parser is holding one. The cache
+   may be shared between threads.
+*/
+typedef struct
+{
+  edi_directory_loader_t loader;
+  void *user_data;
+
+  edi_directory_entry_t **bucket;
+  unsigned int buckets, count;
+
+  edi_directory_entry_t *newest, *oldest;
+
+  /** \brief Bytes used and allowed (zero for no limit) */
+  unsigned long size, budget;
+
+  /** \brief Held while a thread is using the entries */
+  edi_lock_t lock;
+
+  /** \brief Signalled whenever an entry has been loaded */
+  edi_cond_t loaded;
+}
+edi_directory_cache_t;
+
+/* cache.c */
+edi_directory_cache_t *edi_directory_cache_create(edi_directory_loader_t, void *, unsigned long);
+void edi_directory_cache_free(edi_directory_cache_t *);
+edi_directory_entry_t *edi_directory_cache_get(edi_directory_cache_t *, edi_parameters_t *);
+void edi_directory_cache_put(edi_directory_cache_t *, edi_directory_entry_t *);
+
+#endif /*CACHE_H*/
@@ -138,6 +138,8 @@ edi_error_string (edi_error_t error)
       return "No transaction type in transaction header";
     case EDI_ENOMEM:
       return "Memory allocation error";
+    case EDI_EREAD:
+      return "Input could not be read";
     }
 
   /* watch compiler warnings - if a case isn't handled it should complain */
@@ -209,36 +211,43 @@ edi_advice_init (edi_advice_t *self)
 void edi_advice_set_rs (edi_advice_t *self, int active, char c) {
   sprintf((char *) &(self->rs), "%c", c);
   self->rs[2] = active ? 1 : 0;
+  self->serial++;
 }
 
 void edi_advice_set_ts (edi_advice_t *self, int active, char c) {
   sprintf((char *) &(self->ts), "%c", c);
   self->ts[2] = active ? 1 : 0;
+  self->serial++;
 }
 
 void edi_advice_set_es (edi_advice_t *self, int active, char c) {
   sprintf((char *) &(self->es), "%c", c);
   self->es[2] = active ? 1 : 0;
+  self->serial++;
 }
 
 void edi_advice_set_ss (edi_advice_t *self, int active, char c) {
   sprintf((char *) &(self->ss), "%c", c);
   self->ss[2] = active ? 1 : 0;
+  self->serial++;
 }
 
 void edi_advice_set_st (edi_advice_t *self, int active, char c) {
   sprintf((char *) &(self->st), "%c", c);
   self->st[2] = active ? 1 : 0;
+  self->serial++;
 }
 
 void edi_advice_set_ri (edi_advice_t *self, int active, char c) {
   sprintf((char *) &(self->ri), "%c", c);
   self->ri[2] = active ? 1 : 0;
+  self->serial++;
 }
 
 void edi_advice_set_dn (edi_advice_t *self, int active, char c) {
   sprintf((char *) &(self->dn), "%c", c);
   self->dn[2] = active ? 1 : 0;
+  self->serial++;
 }
 
 
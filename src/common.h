@@ -33,6 +33,15 @@ extern "C" {
 
 typedef struct edi_parser_s edi_parser_t;
 
+/* byte offsets in a stream, which can run past 4 GB where a long can't */
+#if defined(__GNUC__)
+__extension__ typedef unsigned long long edi_offset_t;
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L
+typedef unsigned long long edi_offset_t;
+#else
+typedef unsigned long edi_offset_t;
+#endif
+
 typedef struct
 {
   int major;
@@ -73,7 +82,8 @@ typedef enum
 
   EDI_ENOTTTH,   /* No transaction type in transaction header */
   
-  EDI_ENOMEM     /* Memory allocation error */
+  EDI_ENOMEM,    /* Memory allocation error */
+  EDI_EREAD      /* Input could not be read */
 }
 edi_error_t;
 
@@ -162,6 +172,24 @@ typedef enum
 }
 edi_pragma_t;
 
+typedef enum
+{
+  EDI_SCAN_NONE = 0,   /* Every character is passed through the FSA */
+  EDI_SCAN_SCALAR = 1, /* Runs of data found a character at a time */
+  EDI_SCAN_SSE2 = 2,   /* Runs of data found 16 characters at a time */
+  EDI_SCAN_AVX2 = 3    /* Runs of data found 32 characters at a time */
+}
+edi_scan_t;
+
+typedef enum
+{
+  EDI_COMPRESSION_NONE = 0,
+  EDI_COMPRESSION_AUTO = 1, /* Whichever of these the stream starts like */
+  EDI_COMPRESSION_GZIP = 2, /* gzip (or zlib) - needs zlib */
+  EDI_COMPRESSION_ZSTD = 3  /* Zstandard - needs libzstd */
+}
+edi_compression_t;
+
 typedef struct
 {
   unsigned int size;
@@ -182,6 +210,7 @@ typedef struct {
   char ri[3]; /* release indicator */
   char dn[3]; /* decimal notation */
   int has_ssa;
+  unsigned int serial; /* bumped whenever a character is (re)defined */
 }
 edi_advice_t;
 
@@ -0,0 +1,1308 @@
+/*
+  
+  The MEDICI Electronic Data Interchange Library
+  Copyright (C) 2002  David Coles
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+
+
+
+/** \file cosimo.c
+
+    \brief Compiled Transaction Set Guidelines.
+
+    Building a giovanni directory means parsing XML and allocating
+    every segment, element and codelist value separately, which is
+    slow for a full directory and costs each process its own copy.
+    edi_cosimo_compile() writes a loaded giovanni directory out as a
+    single image - string pool, item table and hash indexes, with each
+    transaction's rules in the blocks of steps which giovanni compiles
+    them to - which edi_cosimo_map() maps read-only and serves in
+    place. Mapping is almost free, and
+    processes which map the same image share its pages.
+
+    The answers are those which the giovanni directory it was compiled
+    from would give.
+
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define COSIMO_MMAP
+#endif
+
+#include "internal.h"
+#include "giovanni.h"
+#include "cosimo.h"
+
+/* the directory may be a cursor, so always go through user_data */
+#define COSIMO(d) ((edi_cosimo_t *) ((d) ? (d)->user_data : NULL))
+
+/* strings in the image, with 0 for none */
+#define STR(c, o) ((o) ? (char *) (c)->strings + (o) : NULL)
+
+#define cmpfn ((int (*)(void *, void *)) strcmp)
+
+/* hashes must be the same wherever the image is used, so the
+   characters are taken as unsigned and the arithmetic is 32 bit */
+static edi_cosimo_word_t cosimo_hash(const char *s)
+{
+  edi_cosimo_word_t h = 0;
+  
+  for(; *s; s++)
+    h = h * 31 + (unsigned char) *s;
+  
+  return h;
+}
+
+/* codelist values are keyed by their element's item number + 1 too */
+static edi_cosimo_word_t value_hash(const char *s, edi_cosimo_word_t parent)
+{
+  return cosimo_hash(s) + parent * 0x9e3779b9;
+}
+
+
+/**
+   \defgroup edi_cosimo edi_cosimo
+   \{
+*/
+
+
+/**********************************************************************
+ * Lookups in the image
+ **********************************************************************/
+
+static const edi_cosimo_item_t *
+find_item(edi_cosimo_t *cosimo, int index, const char *code,
+	  edi_cosimo_word_t parent)
+{
+  const edi_cosimo_header_t *header;
+  const edi_cosimo_word_t *slot;
+  const edi_cosimo_item_t *item;
+  edi_cosimo_word_t mask, h, n;
+  
+  if(!cosimo || !code)
+    return NULL;
+  
+  header = cosimo->header;
+  slot = (const edi_cosimo_word_t *) (cosimo->image + header->index[index]);
+  mask = header->index_size[index] - 1;
+  h = index == EDI_COSIMO_CODELISTS ?
+    value_hash(code, parent) : cosimo_hash(code);
+  
+  /* the probe is bounded as the table might (in theory) be full */
+  for(n = 0; n <= mask && slot[h & mask]; n++, h++)
+    {
+      item = cosimo->items + slot[h & mask] - 1;
+      if(item->code && !strcmp(cosimo->strings + item->code, code) &&
+	 item->parent == parent)
+	return item;
+    }
+  
+  return NULL;
+}
+
+static const edi_cosimo_item_t *
+find_element(edi_directory_t *directory, const char *code)
+{
+  return find_item(COSIMO(directory), EDI_COSIMO_ELEMENTS, code, 0);
+}
+
+static const edi_cosimo_item_t *
+find_composite(edi_directory_t *directory, const char *code)
+{
+  return find_item(COSIMO(directory), EDI_COSIMO_COMPOSITES, code, 0);
+}
+
+static const edi_cosimo_item_t *
+find_segment(edi_directory_t *directory, const char *code)
+{
+  return find_item(COSIMO(directory), EDI_COSIMO_SEGMENTS, code, 0);
+}
+
+static const edi_cosimo_item_t *
+find_codelist(edi_directory_t *directory, const char *element,
+	      const char *code)
+{
+  edi_cosimo_t *cosimo = COSIMO(directory);
+  const edi_cosimo_item_t *item;
+  
+  if(!(item = find_element(directory, element)))
+    return NULL;
+  
+  return find_item(cosimo, EDI_COSIMO_CODELISTS, code,
+		   item - cosimo->items + 1);
+}
+
+/* the first step in a block which a segment code selects */
+static const edi_cosimo_step_t *
+find_step(edi_cosimo_t *cosimo, edi_cosimo_word_t block, const char *code)
+{
+  const edi_cosimo_header_t *header = cosimo->header;
+  const edi_cosimo_word_t *slot;
+  const edi_cosimo_step_t *step;
+  edi_cosimo_word_t mask, h, n;
+  
+  slot = (const edi_cosimo_word_t *)
+    (cosimo->image + header->index[EDI_COSIMO_STEPS]);
+  mask = header->index_size[EDI_COSIMO_STEPS] - 1;
+  h = value_hash(code, block);
+  
+  for(n = 0; n <= mask && slot[h & mask]; n++, h++)
+    {
+      step = cosimo->steps + slot[h & mask] - 1;
+      if(step->block == block && !strcmp(cosimo->strings + step->code, code))
+	return step;
+    }
+  
+  return NULL;
+}
+
+/* the i'th child of an item */
+static const edi_cosimo_item_t *
+child(edi_cosimo_t *cosimo, const edi_cosimo_item_t *item, unsigned int i)
+{
+  return cosimo->items + cosimo->kids[item->first + i];
+}
+
+static edi_item_t
+to_item(edi_cosimo_t *cosimo, const edi_cosimo_item_t *entity)
+{
+  edi_item_t item;
+  
+  item.code = STR(cosimo, entity->code);
+  item.name = STR(cosimo, entity->name);
+  item.desc = STR(cosimo, entity->desc);
+  item.note = STR(cosimo, entity->note);
+  item.type = entity->type;
+  item.reqr = entity->reqr;
+  item.reps = entity->reps;
+  item.min = entity->min;
+  item.max = entity->max;
+  item.repr = (edi_data_type_t) entity->repr;
+  
+  return item;
+}
+
+
+static unsigned int
+segment_size (edi_directory_t *directory, char *ref)
+{
+  const edi_cosimo_item_t *entity = find_segment(directory, ref);
+  return entity ? entity->count : 0;
+}
+
+static edi_item_t segment_item
+(edi_directory_t *directory, char *code, unsigned int i)
+{
+  edi_cosimo_t *cosimo = COSIMO(directory);
+  const edi_cosimo_item_t *entity, *pitem;
+  edi_item_t item = EDI_NULL_ITEM;
+  char *ref;
+  
+  if(!(entity = find_segment(directory, code)) || i >= entity->count)
+    return item;
+  
+  entity = child(cosimo, entity, i);
+  ref = STR(cosimo, entity->code);
+  
+  if(entity->type)
+    pitem = find_composite(directory, ref);
+  else
+    pitem = find_element(directory, ref);
+  
+  if(pitem)
+    item = to_item(cosimo, pitem);
+  
+  item.type = entity->type;
+  item.repr = (edi_data_type_t) entity->repr;
+  item.reqr = entity->reqr;
+  
+  return item;
+}
+
+
+static unsigned int composite_size (edi_directory_t *directory, char *ref)
+{
+  const edi_cosimo_item_t *entity = find_composite(directory, ref);
+  return entity ? entity->count : 0;
+}
+
+static edi_item_t composite_item
+(edi_directory_t *directory, char *code, unsigned int i)
+{
+  edi_cosimo_t *cosimo = COSIMO(directory);
+  const edi_cosimo_item_t *entity, *pitem;
+  edi_item_t item = EDI_NULL_ITEM;
+  
+  if(!(entity = find_composite(directory, code)) || i >= entity->count)
+    return item;
+  
+  entity = child(cosimo, entity, i);
+  
+  if((pitem = find_element(directory, STR(cosimo, entity->code))))
+    item = to_item(cosimo, pitem);
+  
+  item.reqr = entity->reqr;
+  
+  return item;
+}
+
+
+static char *codelist_name (edi_directory_t *directory, char *ref1, char *ref2)
+{
+  const edi_cosimo_item_t *item = find_codelist(directory, ref1, ref2);
+  return item ? STR(COSIMO(directory), item->name) : NULL;
+}
+
+static char *codelist_desc (edi_directory_t *directory, char *ref1, char *ref2)
+{
+  const edi_cosimo_item_t *item = find_codelist(directory, ref1, ref2);
+  return item ? STR(COSIMO(directory), item->desc) : NULL;
+}
+
+static char *codelist_note (edi_directory_t *directory, char *ref1, char *ref2)
+{
+  const edi_cosimo_item_t *item = find_codelist(directory, ref1, ref2);
+  return item ? STR(COSIMO(directory), item->note) : NULL;
+}
+
+
+static char *element_name (edi_directory_t *directory, char *ref)
+{
+  const edi_cosimo_item_t *item = find_element(directory, ref);
+  return item ? STR(COSIMO(directory), item->name) : NULL;
+}
+
+static char *element_desc (edi_directory_t *directory, char *ref)
+{
+  const edi_cosimo_item_t *item = find_element(directory, ref);
+  return item ? STR(COSIMO(directory), item->desc) : NULL;
+}
+
+static char *element_note (edi_directory_t *directory, char *ref)
+{
+  const edi_cosimo_item_t *item = find_element(directory, ref);
+  return item ? STR(COSIMO(directory), item->note) : NULL;
+}
+
+
+static char *composite_name (edi_directory_t *directory, char *ref)
+{
+  const edi_cosimo_item_t *item = find_composite(directory, ref);
+  return item ? STR(COSIMO(directory), item->name) : NULL;
+}
+
+static char *composite_desc (edi_directory_t *directory, char *ref)
+{
+  const edi_cosimo_item_t *item = find_composite(directory, ref);
+  return item ? STR(COSIMO(directory), item->desc) : NULL;
+}
+
+static char *composite_note (edi_directory_t *directory, char *ref)
+{
+  const edi_cosimo_item_t *item = find_composite(directory, ref);
+  return item ? STR(COSIMO(directory), item->note) : NULL;
+}
+
+
+static char *segment_name (edi_directory_t *directory, char *ref)
+{
+  const edi_cosimo_item_t *item = find_segment(directory, ref);
+  return item ? STR(COSIMO(directory), item->name) : NULL;
+}
+
+static char *segment_desc (edi_directory_t *directory, char *ref)
+{
+  const edi_cosimo_item_t *item = find_segment(directory, ref);
+  return item ? STR(COSIMO(directory), item->desc) : NULL;
+}
+
+static char *segment_note (edi_directory_t *directory, char *ref)
+{
+  const edi_cosimo_item_t *item = find_segment(directory, ref);
+  return item ? STR(COSIMO(directory), item->note) : NULL;
+}
+
+static edi_item_t element_repr (edi_directory_t *directory, char *code)
+{
+  const edi_cosimo_item_t *item;
+  edi_item_t null = EDI_NULL_ITEM;
+  
+  return (item = find_element(directory, code)) ?
+    to_item(COSIMO(directory), item) : null;
+}
+
+
+/* as giovanni's */
+
+static int
+element_indx (edi_directory_t *d, char *segment,
+	      char *element, char *subelement, int *xp, int *yp)     
+{
+  edi_item_t item;
+  unsigned int n, x;
+  
+  *xp = -1;
+  *yp = -1;
+
+  if(!segment || !element)
+    return 0;
+  
+  x = segment_size(d, segment);
+  
+  for(n = 0; n < x; n++)
+    {
+      item = segment_item(d, segment, n);
+      
+      if(item.code && !strcmp(item.code, element))
+	{
+	  *xp = n;
+	  goto found_element;
+	}
+    }
+  
+  return 0;
+  
+ found_element:
+  
+  if(!item.type)
+    {
+      *yp = 0;
+
+      if(subelement)
+	return 0;
+      
+      return 1;
+    }
+  
+  if(!subelement)
+    return 0;
+  
+  x = composite_size(d, element);
+  
+  for(n = 0; n < x; n++)
+    {
+      item = composite_item(d, element, n);
+      
+      if(item.code && !strcmp(item.code, subelement))
+	{
+	  *yp = n;
+	  return 1;
+	}
+    }
+  
+  return 0;
+}
+
+
+/**********************************************************************
+ * Walking a transaction
+ **********************************************************************/
+
+static void clear_transaction(edi_cosimo_cursor_t *cursor)
+{
+  cursor->depth = 0;
+  cursor->transaction = 0;
+}
+
+static edi_error_t
+start_transaction(edi_directory_t *directory, char *transaction)
+{
+  edi_cosimo_t *cosimo = COSIMO(directory);
+  edi_cosimo_cursor_t *cursor = (edi_cosimo_cursor_t *) directory;
+  const edi_cosimo_item_t *entity;
+  edi_cosimo_iterator_t *iterator;
+  
+  if(!cosimo)
+    return EDI_EBADTSG;
+  
+  /* anything left over from a transaction which was abandoned */
+  clear_transaction(cursor);
+  
+  if(!(entity = find_item(cosimo, EDI_COSIMO_TRANSACTIONS, transaction, 0)))
+    return EDI_ETUNKNOWN;
+  
+  /* as with giovanni, a transaction which was never finished has no
+     rules */
+  if(!entity->program)
+    return EDI_EBADTSG;
+  
+  cursor->transaction = 1;
+  
+  /* room for the deepest loop, so segments never need to allocate */
+  if(cursor->blck < entity->depth)
+    {
+      if(!(iterator = (edi_cosimo_iterator_t *)
+	   realloc(cursor->stack, entity->depth *
+		   sizeof(edi_cosimo_iterator_t))))
+	return EDI_ENOMEM;
+      
+      cursor->stack = iterator;
+      cursor->blck = entity->depth;
+    }
+  
+  iterator = cursor->stack + cursor->depth++;
+  iterator->block = entity->program - 1;
+  iterator->step = cosimo->blocks[iterator->block].first;
+  iterator->reps = 0;
+  
+  return EDI_ENONE;
+}
+
+static edi_error_t
+end_transaction(edi_directory_t *directory)
+{
+  edi_cosimo_cursor_t *cursor = (edi_cosimo_cursor_t *) directory;
+  edi_error_t error = EDI_ENONE;
+  
+  if(!COSIMO(directory))
+    return EDI_EBADTSG;
+  
+  if(cursor->depth)
+    error = EDI_ECORRUPT;
+  
+  clear_transaction(cursor);
+  
+  return error;
+}
+
+static void set_parameters(edi_cosimo_t *cosimo, edi_parameters_t *parameters,
+			   const edi_cosimo_item_t *entity)
+{
+  edi_parameters_set(parameters, LastParameter);
+  edi_parameters_set_one(parameters, Code, STR(cosimo, entity->code));
+  edi_parameters_set_one(parameters, Name, STR(cosimo, entity->name));
+  edi_parameters_set_one(parameters, Desc, STR(cosimo, entity->desc));
+  edi_parameters_set_one(parameters, Note, STR(cosimo, entity->note));
+}
+
+/* giovanni's iterate_transaction(), over the steps in the image */
+
+static edi_error_t iterate_transaction
+(edi_directory_t *directory, char *code,
+ void *userdata,
+ edi_eventh_t start,
+ edi_eventh_t end,
+ edi_sgmnth_t segment)
+{
+  edi_cosimo_t *cosimo = COSIMO(directory);
+  edi_cosimo_cursor_t *cursor = (edi_cosimo_cursor_t *) directory;
+  edi_cosimo_iterator_t *iterator;
+  const edi_cosimo_block_t *block;
+  const edi_cosimo_step_t *step, *match;
+  const edi_cosimo_item_t *entity;
+  edi_parameters_t parameters;
+  edi_error_t error;
+  edi_cosimo_word_t last;
+  
+  edi_parameters_set(&parameters, LastParameter);
+  
+  if(!cosimo)
+    return EDI_EBADTSG;
+  
+  if(!cursor->transaction)
+    {
+      if(segment)
+	segment (userdata, &parameters, directory);
+      return EDI_ENONE;
+    }
+  
+  while(cursor->depth)
+    {
+      iterator = cursor->stack + cursor->depth - 1;
+      block = cosimo->blocks + iterator->block;
+      last = block->first + block->count;
+      
+      /* the end of this instance of the loop */
+      if(iterator->step >= last)
+	{
+	  cursor->depth--;
+	  
+	  if(cursor->depth && end)
+	    end (userdata, EDI_LOOP, NULL);
+	  
+	  if(cursor->depth)
+	    cursor->stack[cursor->depth - 1].reps++;
+	  
+	  continue;
+	}
+      
+      step = cosimo->steps + iterator->step;
+      
+      if(iterator->reps)
+	{
+	  if(iterator->reps < cosimo->items[step->item].reps)
+	    {
+	      if(step->error == EDI_EBADTSG)
+		{
+		  error = EDI_EBADTSG;
+		  goto reject_segment;
+		}
+	      
+	      if(code && step->code &&
+		 !strcmp(cosimo->strings + step->code, code))
+		goto accept_step;
+	    }
+	  
+	  iterator->reps = 0;
+	  iterator->step++;
+	  continue;
+	}
+      
+      match = code ? find_step(cosimo, iterator->block, code) : NULL;
+      
+      while(match && match < step)
+	match = match->same ? cosimo->steps + match->same - 1 : NULL;
+      
+      if(match && match <= cosimo->steps + step->stop)
+	{
+	  iterator->step = match - cosimo->steps;
+	  goto accept_step;
+	}
+      
+      iterator->step = step->stop;
+      
+      if(iterator->step < last)
+	{
+	  error = (edi_error_t) cosimo->steps[iterator->step].error;
+	  goto reject_segment;
+	}
+    }
+  
+  if(!code)
+    return EDI_ENONE;
+  
+  error = EDI_ECORRUPT;
+  
+ reject_segment:
+  if(segment)
+    segment (userdata, &parameters, directory);
+  return error;
+  
+ accept_step:
+  step = cosimo->steps + iterator->step;
+  entity = cosimo->items + step->item;
+  
+  if(entity->type)
+    {
+      if(cursor->depth == cursor->blck)
+	{
+	  error = EDI_EBADTSG;
+	  goto reject_segment;
+	}
+      
+      iterator = cursor->stack + cursor->depth++;
+      iterator->block = step->body;
+      iterator->step = cosimo->blocks[step->body].first;
+      iterator->reps = 0;
+      
+      if(start)
+	{
+	  set_parameters(cosimo, &parameters, entity);
+	  start (userdata, EDI_LOOP, &parameters);
+	}
+      
+      entity = cosimo->items + cosimo->steps[iterator->step].item;
+    }
+  
+  set_parameters(cosimo, &parameters, entity);
+  if(segment)
+    segment (userdata, &parameters, directory);
+  iterator->reps++;
+  return EDI_ENONE;
+}
+
+
+/* cursors made by edi_directory_cursor() share everything but the
+   state of the walk with the directory they were made from */
+
+static void cursor_free(edi_directory_t *directory)
+{
+  if(!directory)
+    return;
+  
+  free(((edi_cosimo_cursor_t *) directory)->stack);
+  free(directory);
+}
+
+static edi_directory_t *cursor_create(edi_directory_t *directory)
+{
+  edi_cosimo_cursor_t *cursor;
+  
+  if(!(cursor = (edi_cosimo_cursor_t *) malloc(sizeof(edi_cosimo_cursor_t))))
+    return NULL;
+  
+  memset(cursor, 0, sizeof(edi_cosimo_cursor_t));
+  cursor->directory = *directory;
+  cursor->directory.cursor = NULL;
+  cursor->directory.free = cursor_free;
+  
+  return (edi_directory_t *) cursor;
+}
+
+static void cosimo_free(edi_directory_t *directory)
+{
+  edi_cosimo_t *cosimo = (edi_cosimo_t *) directory;
+  
+  if(!cosimo)
+    return;
+  
+#ifdef COSIMO_MMAP
+  if(cosimo->mapped)
+    munmap((void *) cosimo->image, cosimo->size);
+  else
+#endif
+    free((void *) cosimo->image);
+  
+  free(cosimo->cursor.stack);
+  free(cosimo);
+}
+
+
+/**********************************************************************
+ * Loading an image
+ **********************************************************************/
+
+/* is a table of n records of the given size within the image? */
+static int in_image(edi_cosimo_t *cosimo, edi_cosimo_word_t offset,
+		    edi_cosimo_word_t n, unsigned long size)
+{
+  return !(offset % sizeof(edi_cosimo_word_t)) && offset <= cosimo->size &&
+    n <= (cosimo->size - offset) / size;
+}
+
+/* Everything which the lookups and the walk trust is checked once
+   here, so that a bad image is refused rather than read out of
+   bounds */
+
+static int check_image(edi_cosimo_t *cosimo)
+{
+  const edi_cosimo_header_t *header;
+  const edi_cosimo_item_t *item;
+  const edi_cosimo_block_t *block;
+  const edi_cosimo_step_t *step;
+  const edi_cosimo_word_t *slot;
+  edi_cosimo_word_t n, i, size;
+  
+  if(cosimo->size < sizeof(edi_cosimo_header_t))
+    return 0;
+  
+  header = (const edi_cosimo_header_t *) cosimo->image;
+  
+  if(memcmp(header->magic, EDI_COSIMO_MAGIC, sizeof(header->magic)) ||
+     header->version != EDI_COSIMO_VERSION || header->size != cosimo->size)
+    return 0;
+  
+  if(!in_image(cosimo, header->items, header->item_count,
+	       sizeof(edi_cosimo_item_t)) ||
+     !in_image(cosimo, header->kids, header->kid_count,
+	       sizeof(edi_cosimo_word_t)) ||
+     !in_image(cosimo, header->blocks, header->block_count,
+	       sizeof(edi_cosimo_block_t)) ||
+     !in_image(cosimo, header->steps, header->step_count,
+	       sizeof(edi_cosimo_step_t)) ||
+     !in_image(cosimo, header->strings, header->string_size, 1) ||
+     !header->string_size ||
+     cosimo->image[header->strings + header->string_size - 1])
+    return 0;
+  
+  cosimo->header = header;
+  cosimo->items = (const edi_cosimo_item_t *) (cosimo->image + header->items);
+  cosimo->kids = (const edi_cosimo_word_t *) (cosimo->image + header->kids);
+  cosimo->blocks = (const edi_cosimo_block_t *) (cosimo->image + header->blocks);
+  cosimo->steps = (const edi_cosimo_step_t *) (cosimo->image + header->steps);
+  cosimo->strings = cosimo->image + header->strings;
+  
+  for(n = 0; n < header->item_count; n++)
+    {
+      item = cosimo->items + n;
+      
+      if(item->code >= header->string_size ||
+	 item->name >= header->string_size ||
+	 item->desc >= header->string_size ||
+	 item->note >= header->string_size ||
+	 item->first > header->kid_count ||
+	 item->count > header->kid_count - item->first ||
+	 item->parent > header->item_count ||
+	 item->program > header->block_count ||
+	 (item->program && (!item->depth ||
+			    item->depth > header->block_count)))
+	return 0;
+    }
+  
+  for(n = 0; n < header->kid_count; n++)
+    if(cosimo->kids[n] >= header->item_count)
+      return 0;
+  
+  for(n = 0; n < header->block_count; n++)
+    {
+      block = cosimo->blocks + n;
+      
+      if(block->first > header->step_count ||
+	 block->count > header->step_count - block->first)
+	return 0;
+    }
+  
+  /* each step must lie in its block, and its stop and the next step
+     with its code further on in the same block, so that the walk
+     always moves forwards and stays within the block */
+  for(n = 0; n < header->step_count; n++)
+    {
+      step = cosimo->steps + n;
+      
+      if(step->item >= header->item_count ||
+	 step->code >= header->string_size ||
+	 step->block >= header->block_count)
+	return 0;
+      
+      block = cosimo->blocks + step->block;
+      
+      if(n < block->first || n >= block->first + block->count ||
+	 step->stop < n || step->stop > block->first + block->count ||
+	 (step->same && (step->same - 1 <= n ||
+			 step->same - 1 >= block->first + block->count)))
+	return 0;
+      
+      /* a loop which can be selected starts with one of its steps */
+      if(cosimo->items[step->item].type &&
+	 (step->body >= header->block_count ||
+	  (step->code && !cosimo->blocks[step->body].count)))
+	return 0;
+    }
+  
+  for(i = 0; i < EDI_COSIMO_INDEXES; i++)
+    {
+      size = header->index_size[i];
+      
+      if(!size || (size & (size - 1)) ||
+	 !in_image(cosimo, header->index[i], size, sizeof(edi_cosimo_word_t)))
+	return 0;
+      
+      slot = (const edi_cosimo_word_t *) (cosimo->image + header->index[i]);
+      
+      for(n = 0; n < size; n++)
+	if(slot[n] > (i == EDI_COSIMO_STEPS ?
+		      header->step_count : header->item_count))
+	  return 0;
+    }
+  
+  return 1;
+}
+
+static int load_image(edi_cosimo_t *cosimo, const char *path)
+{
+  FILE *stream;
+  char *data;
+  long size;
+#ifdef COSIMO_MMAP
+  struct stat st;
+  void *ptr;
+  int fd;
+  
+  if((fd = open(path, O_RDONLY)) < 0)
+    return 0;
+  
+  if(!fstat(fd, &st) && st.st_size > 0 && (unsigned long) st.st_size ==
+     (edi_cosimo_word_t) st.st_size &&
+     (ptr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0)) != MAP_FAILED)
+    {
+      close(fd);
+      cosimo->image = (const char *) ptr;
+      cosimo->size = st.st_size;
+      cosimo->mapped = 1;
+      return 1;
+    }
+  
+  close(fd);
+#endif
+  
+  /* no mmap - read it in instead */
+  if(!(stream = fopen(path, "rb")))
+    return 0;
+  
+  data = NULL;
+  
+  if(!fseek(stream, 0, SEEK_END) && (size = ftell(stream)) > 0 &&
+     !fseek(stream, 0, SEEK_SET) && (data = malloc(size)) &&
+     fread(data, 1, size, stream) != (unsigned long) size)
+    {
+      free(data);
+      data = NULL;
+    }
+  
+  fclose(stream);
+  
+  if(!data)
+    return 0;
+  
+  cosimo->image = data;
+  cosimo->size = size;
+  return 1;
+}
+
+/**
+   \brief Maps a compiled TSG.
+   \param path File written by edi_cosimo_compile().
+   \return Pointer to the directory, or NULL if the file could not be
+   read or is not a valid image.
+*/
+
+edi_directory_t *edi_cosimo_map(const char *path)
+{
+  edi_cosimo_t *cosimo;
+  edi_directory_t *directory;
+  
+  if(!(cosimo = (edi_cosimo_t *) malloc(sizeof(edi_cosimo_t))))
+    return NULL;
+  
+  memset(cosimo, 0, sizeof(edi_cosimo_t));
+  directory = (edi_directory_t *) cosimo;
+  directory->user_data = cosimo;
+  directory->free = cosimo_free;
+  
+  if(!path || !load_image(cosimo, path) || !check_image(cosimo))
+    {
+      cosimo_free(directory);
+      return NULL;
+    }
+  
+  directory->element_indx = element_indx;
+
+  directory->element_name = element_name;
+  directory->element_desc = element_desc;
+  directory->element_note = element_note;
+  directory->element_repr = element_repr;
+  
+  directory->segment_name = segment_name;
+  directory->segment_desc = segment_desc;
+  directory->segment_note = segment_note;
+  directory->segment_size = segment_size;
+  directory->segment_item = segment_item;
+  
+  directory->composite_name = composite_name;
+  directory->composite_desc = composite_desc;
+  directory->composite_note = composite_note;
+  directory->composite_size = composite_size;
+  directory->composite_item = composite_item;
+  
+  directory->codelist_name = codelist_name;
+  directory->codelist_desc = codelist_desc;
+  directory->codelist_note = codelist_note;
+  
+  directory->start = start_transaction;
+  directory->parse = iterate_transaction;
+  directory->end = end_transaction;
+
+  directory->cursor = cursor_create;
+  
+  return directory;
+}
+
+
+/**********************************************************************
+ * Compiling a giovanni directory
+ **********************************************************************/
+
+typedef struct {
+  edi_giovanni_t *giovanni;
+  edi_gitem_t **gitem;		/* by item number */
+  edi_hash_t number;		/* item number + 1, by edi_gitem_t */
+  edi_hash_t offset;		/* offset in pool, by string */
+  edi_buffer_t pool;
+  edi_cosimo_item_t *items;
+  edi_cosimo_word_t *kids;
+  edi_cosimo_block_t *blocks;
+  edi_cosimo_step_t *steps;
+  unsigned long block_count, step_count;
+  edi_cosimo_word_t *index[EDI_COSIMO_INDEXES];
+  edi_cosimo_word_t index_size[EDI_COSIMO_INDEXES];
+  int index_id;			/* for the traverse handler */
+  int ok;
+} cosimo_compiler_t;
+
+static edi_cosimo_word_t number(cosimo_compiler_t *self, edi_gitem_t *gitem)
+{
+  return gitem ? (edi_cosimo_word_t) (unsigned long)
+    edi_hash_fetch(&(self->number), gitem) : 0;
+}
+
+static edi_cosimo_word_t intern(cosimo_compiler_t *self, char *s)
+{
+  unsigned long offset;
+  
+  if(!s)
+    return 0;
+  
+  if((offset = (unsigned long) edi_hash_fetch(&(self->offset), s)))
+    return offset;
+  
+  offset = self->pool.size;
+  
+  if(!edi_buffer_append(&(self->pool), s, strlen(s) + 1) ||
+     !edi_hash_store(&(self->offset), s, (void *) offset))
+    self->ok = 0;
+  
+  return offset;
+}
+
+/* a table with room for twice the entries, so that probes are short */
+static edi_cosimo_word_t *make_index(cosimo_compiler_t *self, int id,
+				     unsigned long entries)
+{
+  edi_cosimo_word_t size = 8;
+  
+  while(size < entries * 2)
+    size *= 2;
+  
+  self->index_size[id] = size;
+  
+  if(!(self->index[id] = calloc(size, sizeof(edi_cosimo_word_t))))
+    self->ok = 0;
+  
+  return self->index[id];
+}
+
+/* store an item under its code (and parent), unless one is already
+   there - the first definition wins, as with giovanni */
+static void index_item(cosimo_compiler_t *self, int id, edi_cosimo_word_t n)
+{
+  edi_cosimo_word_t *slot = self->index[id], mask = self->index_size[id] - 1;
+  edi_cosimo_item_t *item = self->items + n;
+  const char *code = (char *) edi_buffer_data(&(self->pool)) + item->code;
+  edi_cosimo_word_t h;
+  
+  if(!slot || !item->code)
+    return;
+  
+  h = id == EDI_COSIMO_CODELISTS ?
+    value_hash(code, item->parent) : cosimo_hash(code);
+  
+  for(; slot[h & mask]; h++)
+    {
+      edi_cosimo_item_t *other = self->items + slot[h & mask] - 1;
+      if(other->parent == item->parent &&
+	 !strcmp((char *) edi_buffer_data(&(self->pool)) + other->code, code))
+	return;
+    }
+  
+  slot[h & mask] = n + 1;
+}
+
+/* store a step under its block and code, unless an earlier step is
+   there already - the index holds the first of each chain */
+static void index_step(cosimo_compiler_t *self, edi_cosimo_word_t n)
+{
+  edi_cosimo_word_t *slot = self->index[EDI_COSIMO_STEPS];
+  edi_cosimo_word_t mask = self->index_size[EDI_COSIMO_STEPS] - 1;
+  edi_cosimo_step_t *step = self->steps + n;
+  const char *code = (char *) edi_buffer_data(&(self->pool)) + step->code;
+  edi_cosimo_word_t h;
+  
+  if(!slot || !step->code)
+    return;
+  
+  for(h = value_hash(code, step->block); slot[h & mask]; h++)
+    {
+      edi_cosimo_step_t *other = self->steps + slot[h & mask] - 1;
+      if(other->block == step->block &&
+	 !strcmp((char *) edi_buffer_data(&(self->pool)) + other->code, code))
+	return;
+    }
+  
+  slot[h & mask] = n + 1;
+}
+
+/* copy the transactions' compiled rules, numbering the blocks and
+   steps of each on from those of the transactions before it */
+static void copy_programs(cosimo_compiler_t *self, unsigned long n)
+{
+  edi_gprogram_t *program;
+  edi_gstep_t *gstep;
+  edi_cosimo_step_t *step;
+  unsigned long i, j, b, s;
+  
+  for(i = b = s = 0; i < n; i++)
+    if((program = self->gitem[i]->program))
+      {
+	b += program->blocks;
+	s += program->steps;
+      }
+  
+  if(!(self->blocks = calloc(b + 1, sizeof(edi_cosimo_block_t))) ||
+     !(self->steps = calloc(s + 1, sizeof(edi_cosimo_step_t))))
+    {
+      self->ok = 0;
+      return;
+    }
+  
+  for(i = b = s = 0; i < n; i++)
+    {
+      if(!(program = self->gitem[i]->program))
+	continue;
+      
+      self->items[i].program = b + 1;
+      self->items[i].depth = program->depth;
+      
+      for(j = 0; j < program->blocks; j++)
+	{
+	  self->blocks[b + j].first = program->block[j].first + s;
+	  self->blocks[b + j].count = program->block[j].count;
+	}
+      
+      for(j = 0; j < program->steps; j++)
+	{
+	  gstep = program->step + j;
+	  step = self->steps + s + j;
+	  
+	  if(!(step->item = number(self, gstep->item)))
+	    self->ok = 0;
+	  else
+	    step->item--;
+	  
+	  step->code = intern(self, gstep->code);
+	  step->block = gstep->block + b;
+	  step->body = gstep->item->item.type ? gstep->body + b : 0;
+	  step->stop = gstep->stop + s;
+	  step->error = gstep->error;
+	  step->same = gstep->same ? gstep->same - program->step + s + 1 : 0;
+	}
+      
+      b += program->blocks;
+      s += program->steps;
+    }
+  
+  self->block_count = b;
+  self->step_count = s;
+}
+
+static void index_handler(void *user, void *key, void *data)
+{
+  cosimo_compiler_t *self = (cosimo_compiler_t *) user;
+  edi_cosimo_word_t n;
+  
+  if((n = number(self, (edi_gitem_t *) data)))
+    index_item(self, self->index_id, n - 1);
+}
+
+static void index_hash(cosimo_compiler_t *self, int id, edi_hash_t *hash)
+{
+  if(!make_index(self, id, hash->count))
+    return;
+  
+  self->index_id = id;
+  edi_hash_traverse(hash, self, index_handler);
+}
+
+static int write_image(cosimo_compiler_t *self, unsigned long n,
+		       unsigned long k, const char *path)
+{
+  edi_cosimo_header_t header;
+  unsigned long offset, pool;
+  FILE *stream;
+  int i, ok;
+  
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, EDI_COSIMO_MAGIC, sizeof(header.magic));
+  header.version = EDI_COSIMO_VERSION;
+  
+  /* the string pool is padded to keep the indexes aligned */
+  pool = (self->pool.size + 3) & ~3UL;
+  
+  offset = sizeof(header);
+  header.items = offset;
+  header.item_count = n;
+  offset += n * sizeof(edi_cosimo_item_t);
+  header.kids = offset;
+  header.kid_count = k;
+  offset += k * sizeof(edi_cosimo_word_t);
+  header.blocks = offset;
+  header.block_count = self->block_count;
+  offset += self->block_count * sizeof(edi_cosimo_block_t);
+  header.steps = offset;
+  header.step_count = self->step_count;
+  offset += self->step_count * sizeof(edi_cosimo_step_t);
+  header.strings = offset;
+  header.string_size = self->pool.size;
+  offset += pool;
+  
+  for(i = 0; i < EDI_COSIMO_INDEXES; i++)
+    {
+      header.index[i] = offset;
+      header.index_size[i] = self->index_size[i];
+      offset += self->index_size[i] * sizeof(edi_cosimo_word_t);
+    }
+  
+  /* offsets are 32 bits */
+  if(offset != (edi_cosimo_word_t) offset)
+    return 0;
+  
+  header.size = offset;
+  
+  /* room for the padding */
+  if(!edi_buffer_reserve(&(self->pool), pool))
+    return 0;
+  memset((char *) edi_buffer_data(&(self->pool)) + self->pool.size, 0,
+	 pool - self->pool.size);
+  
+  if(!(stream = fopen(path, "wb")))
+    return 0;
+  
+  ok = fwrite(&header, sizeof(header), 1, stream) == 1 &&
+    fwrite(self->items, sizeof(edi_cosimo_item_t), n, stream) == n &&
+    fwrite(self->kids, sizeof(edi_cosimo_word_t), k, stream) == k &&
+    fwrite(self->blocks, sizeof(edi_cosimo_block_t), self->block_count,
+	   stream) == self->block_count &&
+    fwrite(self->steps, sizeof(edi_cosimo_step_t), self->step_count,
+	   stream) == self->step_count &&
+    fwrite(edi_buffer_data(&(self->pool)), 1, pool, stream) == pool;
+  
+  for(i = 0; ok && i < EDI_COSIMO_INDEXES; i++)
+    ok = fwrite(self->index[i], sizeof(edi_cosimo_word_t),
+		self->index_size[i], stream) == self->index_size[i];
+  
+  return (fclose(stream) == 0) && ok;
+}
+
+/**
+   \brief Compiles a giovanni directory into an image for edi_cosimo_map().
+   \param directory A giovanni directory (see edi_giovanni_create()).
+   \param path The file to write.
+   \return Non-zero on success.
+*/
+
+int edi_cosimo_compile(edi_directory_t *directory, const char *path)
+{
+  cosimo_compiler_t compiler, *self = &compiler;
+  edi_cosimo_item_t *item;
+  edi_gitem_t *gitem;
+  edi_node_t *node;
+  unsigned long n, k, i;
+  int ok = 0;
+  
+  memset(self, 0, sizeof(cosimo_compiler_t));
+  edi_buffer_init(&(self->pool));
+  
+  if(!path || !(self->giovanni = edi_giovanni_data(directory)))
+    return 0;
+  
+  n = edi_list_length(&(self->giovanni->everything));
+  
+  if(!edi_hash_init(&(self->number), 61, NULL, NULL))
+    return 0;
+  
+  if(!edi_hash_init(&(self->offset), 61, cmpfn, x31_hash))
+    goto done;
+  
+  self->ok = 1;
+  
+  /* the pool starts with an empty string, so that offset 0 is NULL */
+  if(!edi_buffer_append(&(self->pool), "", 1))
+    goto done;
+  
+  if(!(self->gitem = calloc(n + 1, sizeof(edi_gitem_t *))) ||
+     !(self->items = calloc(n + 1, sizeof(edi_cosimo_item_t))))
+    goto done;
+  
+  /* items are numbered in the order they were defined, which is the
+     reverse of the list */
+  i = n;
+  k = 0;
+  for(node = self->giovanni->everything.first; node; node = node->next)
+    {
+      gitem = self->gitem[--i] = (edi_gitem_t *) node->data;
+      k += edi_list_length(&(gitem->list));
+      if(!edi_hash_store(&(self->number), gitem, (void *) (i + 1)))
+	goto done;
+    }
+  
+  if(!(self->kids = calloc(k + 1, sizeof(edi_cosimo_word_t))))
+    goto done;
+  
+  for(i = k = 0; i < n; i++)
+    {
+      gitem = self->gitem[i];
+      item = self->items + i;
+      
+      item->code = intern(self, gitem->item.code);
+      item->name = intern(self, gitem->item.name);
+      item->desc = intern(self, gitem->item.desc);
+      item->note = intern(self, gitem->item.note);
+      item->type = gitem->item.type;
+      item->reqr = gitem->item.reqr;
+      item->reps = gitem->item.reps;
+      item->min = gitem->item.min;
+      item->max = gitem->item.max;
+      item->repr = gitem->item.repr;
+      item->parent = number(self, gitem->parent);
+      
+      item->first = k;
+      for(node = gitem->list.first; node; node = node->next)
+	if((self->kids[k] = number(self, (edi_gitem_t *) node->data)))
+	  self->kids[k++]--;
+      item->count = k - item->first;
+    }
+  
+  copy_programs(self, n);
+  
+  /* the codes of segments, composites, elements and codelist values
+     are already unique in the giovanni indexes */
+  index_hash(self, EDI_COSIMO_ELEMENTS, &(self->giovanni->elements));
+  index_hash(self, EDI_COSIMO_COMPOSITES, &(self->giovanni->composites));
+  index_hash(self, EDI_COSIMO_SEGMENTS, &(self->giovanni->segments));
+  index_hash(self, EDI_COSIMO_CODELISTS, &(self->giovanni->codelists));
+  
+  if(make_index(self, EDI_COSIMO_TRANSACTIONS,
+		edi_list_length(&(self->giovanni->transactions))))
+    for(node = self->giovanni->transactions.first; node; node = node->next)
+      if((i = number(self, (edi_gitem_t *) node->data)))
+	index_item(self, EDI_COSIMO_TRANSACTIONS, i - 1);
+  
+  if(self->ok && make_index(self, EDI_COSIMO_STEPS, self->step_count))
+    for(i = 0; i < self->step_count; i++)
+      index_step(self, i);
+  
+  ok = self->ok && write_image(self, n, k, path);
+  
+ done:
+  for(i = 0; i < EDI_COSIMO_INDEXES; i++)
+    free(self->index[i]);
+  free(self->steps);
+  free(self->blocks);
+  free(self->kids);
+  free(self->items);
+  free(self->gitem);
+  edi_hash_fini(&(self->number), NULL);
+  if(self->offset.list)
+    edi_hash_fini(&(self->offset), NULL);
+  edi_buffer_clear(&(self->pool));
+  
+  return ok;
+}
+
+
+/** \} */
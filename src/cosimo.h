@@ -0,0 +1,122 @@
+/*
+  
+  The MEDICI Electronic Data Interchange Library
+  Copyright (C) 2002  David Coles
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+
+
+#ifndef COSIMO_H
+#define COSIMO_H
+
+/* A compiled TSG: a single read-only image, made by edi_cosimo_compile()
+   from a giovanni directory and used in place by edi_cosimo_map(). Every
+   reference within the image is an offset from its start, so it can be
+   mapped at any address and shared between processes. Words are 32 bits
+   in the byte order of the machine which compiled it. */
+
+#define EDI_COSIMO_MAGIC   "MEDICI TSG\n"
+#define EDI_COSIMO_VERSION 2
+
+typedef unsigned int edi_cosimo_word_t;
+
+/* the indexes, by code except for codelist values which are by
+   element and code, and steps which are by block and code */
+#define EDI_COSIMO_ELEMENTS     0
+#define EDI_COSIMO_COMPOSITES   1
+#define EDI_COSIMO_SEGMENTS     2
+#define EDI_COSIMO_TRANSACTIONS 3
+#define EDI_COSIMO_CODELISTS    4
+#define EDI_COSIMO_STEPS        5
+#define EDI_COSIMO_INDEXES      6
+
+typedef struct {
+  char magic[12];
+  edi_cosimo_word_t version;
+  edi_cosimo_word_t size;		/* of the whole image */
+  edi_cosimo_word_t items, item_count;	/* edi_cosimo_item_t[] */
+  edi_cosimo_word_t kids, kid_count;	/* item numbers of children */
+  edi_cosimo_word_t blocks, block_count; /* edi_cosimo_block_t[] */
+  edi_cosimo_word_t steps, step_count;	/* edi_cosimo_step_t[] */
+  edi_cosimo_word_t strings, string_size;
+  /* open addressing hash tables of item (or step) number + 1, 0 if
+     empty */
+  edi_cosimo_word_t index[EDI_COSIMO_INDEXES];
+  edi_cosimo_word_t index_size[EDI_COSIMO_INDEXES]; /* a power of 2 */
+} edi_cosimo_header_t;
+
+/* an edi_gitem_t - strings are offsets into the string pool, and 0 for
+   none, as the pool starts with an empty string */
+typedef struct {
+  edi_cosimo_word_t code, name, desc, note;
+  edi_cosimo_word_t type, reqr, reps, min, max, repr;
+  edi_cosimo_word_t first, count;	/* children, in kids */
+  edi_cosimo_word_t parent;		/* codelist value: element + 1 */
+  /* transaction: first block of its rules + 1 (0 if it has none),
+     and the deepest nesting of its loops */
+  edi_cosimo_word_t program, depth;
+} edi_cosimo_item_t;
+
+/* the compiled rules of the transactions (see edi_gprogram_t), with
+   the blocks and steps of them all numbered through the image */
+typedef struct {
+  edi_cosimo_word_t first, count;
+} edi_cosimo_block_t;
+
+typedef struct {
+  edi_cosimo_word_t item;
+  edi_cosimo_word_t code;		/* 0 if it can't be selected */
+  edi_cosimo_word_t block;
+  edi_cosimo_word_t body;		/* a loop's contents */
+  edi_cosimo_word_t stop, error;
+  edi_cosimo_word_t same;		/* next with the code + 1, or 0 */
+} edi_cosimo_step_t;
+
+/* position in a block, while walking a transaction */
+typedef struct {
+  edi_cosimo_word_t block, step, reps;
+} edi_cosimo_iterator_t;
+
+/* the state of a walk through a transaction - see edi_gcursor_t */
+typedef struct {
+  edi_directory_t directory;
+  /* one iterator per level of loop, allocated for the deepest */
+  edi_cosimo_iterator_t *stack;
+  unsigned int depth, blck;
+  int transaction;
+} edi_cosimo_cursor_t;
+
+typedef struct {
+  edi_cosimo_cursor_t cursor;
+  const char *image;
+  unsigned long size;
+  int mapped;			/* else malloc'd */
+  const edi_cosimo_header_t *header;
+  const edi_cosimo_item_t *items;
+  const edi_cosimo_word_t *kids;
+  const edi_cosimo_block_t *blocks;
+  const edi_cosimo_step_t *steps;
+  const char *strings;
+} edi_cosimo_t;
+
+
+/* cosimo.c */
+int edi_cosimo_compile(edi_directory_t *, const char *);
+edi_directory_t *edi_cosimo_map(const char *);
+
+#endif /*COSIMO_H*/
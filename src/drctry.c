@@ -139,6 +139,24 @@ void edi_directory_free(edi_directory_t *self) {
 }
 
 
+/**
+   \brief Create a cursor for walking transactions
+
+   \param self directory to use
+   \return the cursor (free with edi_directory_free()), or NULL if the
+   directory does not support them or there is no memory
+
+   The cursor can be used in place of the directory, but has its own
+   state for parsing the structure of a transaction, so that one
+   directory can be used by many parsers at once.
+*/
+
+edi_directory_t *edi_directory_cursor(edi_directory_t *self)
+{
+  return self && self->cursor ? self->cursor(self) : NULL;
+}
+
+
 int
 edi_directory_element_index (edi_directory_t *self, char *key, int *x, int *y)
 {
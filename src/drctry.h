@@ -66,6 +66,11 @@ struct edi_directory_s
   /** \brief Called to free all resources for directory */
   void (*free)(edi_directory_t *);
 
+  /** \brief Returns a cursor: a directory which has its own state for
+      start, parse and end but shares everything else, and whose
+      user_data is the same as this one's. NULL if not supported */
+  edi_directory_t *(*cursor)(edi_directory_t *);
+
   /** \brief Returns a string containing an element's name */
   char *(*element_name)(edi_directory_t *, char *);
   /** \brief Returns a string containing an element's description */
@@ -127,6 +132,7 @@ struct edi_directory_s
   edi_error_t edi_directory_start(edi_directory_t *, char *);
   edi_error_t edi_directory_parse(edi_directory_t *, char *, int, void *, edi_eventh_t, edi_eventh_t, edi_sgmnth_t, edi_eventh_t);
   void edi_directory_free(edi_directory_t *);
+  edi_directory_t *edi_directory_cursor(edi_directory_t *);
   int edi_directory_element_index(edi_directory_t *, char *, int *, int *);
   char *edi_directory_codelist_value(edi_directory_t *, char *, char *);
   char *edi_directory_element_name(edi_directory_t *, char *);
@@ -445,33 +445,53 @@ edifact_segment (edi_parser_t *SELF)
 }
 
 
+/* ready for the next interchange, keeping the service directory */
 static void
-edifact_fini (edi_parser_t *SELF)
+edifact_reset (edi_parser_t *SELF)
 {
-  if (MSGDIR)
-    edi_directory_free (MSGDIR);
+  /* the message directory came from the application, which may be
+     sharing it with other parsers, so it is not ours to free */
   MSGDIR = NULL;
 
-  if (SVCDIR)
-    edi_directory_free (SVCDIR);
+  memset(self, 0, sizeof(edi_edifact_t)); /* mitigate bugs */
+
+  /* initalise service segment parser */
+  self->syntax_version = ASCII_2; /* FIXME */
+  self->syntax_level = ASCII_A;	/* FIXME */
+}
+
+
+/* a message between UNH and UNT parsed by another parser, which only
+   the group and interchange control counts need know about */
+static void
+edifact_skip (edi_parser_t *SELF)
+{
+  self->message_count++;
+}
+
+
+static void
+edifact_fini (edi_parser_t *SELF)
+{
+  edifact_reset (SELF);
+
+  /* the service directory is shared - see EDIFACT_UNO() */
   SVCDIR = NULL;
 }
 
 
 edi_error_t edi_edifact_init (edi_parser_t *SELF)
 {
-  memset(self, 0, sizeof(edi_edifact_t)); /* mitigate bugs */
-
   SVCDIR = EDIFACT_UNO();
   MSGDIR = NULL;
 
   SELF->syntax_fini = edifact_fini;
+  SELF->syntax_reset = edifact_reset;
+  SELF->syntax_skip = edifact_skip;
   SELF->sgmnt_handler = edifact_segment;
   
-  /* initalise service segment parser */
-  self->syntax_version = ASCII_2; /* FIXME */
-  self->syntax_level = ASCII_A;	/* FIXME */
-  
+  edifact_reset (SELF);
+
   return EDI_ENONE;
 }
 
@@ -1205,7 +1225,11 @@ static edi_francesco_trnsctn_rule_t transactionsetrule[] = {
 
 static edi_directory_t *EDIFACT_UNO (void)
 {
-  return edi_francesco_create(elementinfo,
+  /* created once, and shared by every parser */
+  static edi_directory_t *shared = NULL;
+
+  return edi_francesco_shared(&shared,
+			      elementinfo,
 			      compositeinfo,
 			      segmentinfo,
 			      compositecontents,
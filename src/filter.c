@@ -0,0 +1,353 @@
+/*
+
+  The MEDICI Electronic Data Interchange Library
+  Copyright (C) 2002  David Coles
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+/* a codec needs both its library and its header */
+#if defined(HAVE_LIBZ) && defined(HAVE_ZLIB_H)
+#include <zlib.h>
+#define EDI_FILTER_GZIP
+#endif
+
+#if defined(HAVE_LIBZSTD) && defined(HAVE_ZSTD_H)
+#include <zstd.h>
+#define EDI_FILTER_ZSTD
+#endif
+
+#include "internal.h"
+
+/** \file filter.c
+
+    \brief Decompresses a stream on its way to a parser.
+
+    Compressed input is decompressed a window at a time, and each
+    window is parsed (with the parser's views pointing into it) before
+    the next is decompressed into the same buffer, so however large
+    the stream only the window is ever held decompressed. gzip is
+    supported when built with zlib, and Zstandard with libzstd; which
+    of them a stream is can be told from its first few bytes.
+
+*/
+
+/**
+   \defgroup edi_input_filter edi_input_filter
+   \{
+*/
+
+
+#ifdef EDI_FILTER_GZIP
+static long edi_input_gunzip (edi_input_filter_t *self, const char *input,
+			      unsigned long size, unsigned long *used)
+{
+  z_stream *z = (z_stream *) self->state;
+  int status;
+
+  *used = 0;
+
+  if (self->ended)
+    {
+      /* another member may follow */
+      if (!size)
+	return 0;
+
+      inflateReset (z);
+      self->ended = 0;
+    }
+
+  /* zlib counts in unsigned ints */
+  if (size > EDI_INPUT_SLICE)
+    size = EDI_INPUT_SLICE;
+
+  z->next_in = (Bytef *) input;
+  z->avail_in = size;
+  z->next_out = (Bytef *) self->window;
+  z->avail_out = self->size;
+
+  status = inflate (z, Z_NO_FLUSH);
+  *used = size - z->avail_in;
+
+  if (status == Z_STREAM_END)
+    self->ended = 1;
+  else if (status != Z_OK && status != Z_BUF_ERROR)
+    return -1;
+
+  return self->size - z->avail_out;
+}
+
+static void edi_input_gunzip_fini (edi_input_filter_t *self)
+{
+  inflateEnd ((z_stream *) self->state);
+  free (self->state);
+}
+#endif
+
+#ifdef EDI_FILTER_ZSTD
+static long edi_input_unzstd (edi_input_filter_t *self, const char *input,
+			      unsigned long size, unsigned long *used)
+{
+  ZSTD_inBuffer in;
+  ZSTD_outBuffer out;
+  size_t status;
+
+  /* another frame may follow */
+  if (self->ended && !size)
+    {
+      *used = 0;
+      return 0;
+    }
+
+  in.src = input;
+  in.size = size;
+  in.pos = 0;
+  out.dst = self->window;
+  out.size = self->size;
+  out.pos = 0;
+
+  status = ZSTD_decompressStream ((ZSTD_DStream *) self->state, &out, &in);
+  *used = in.pos;
+
+  if (ZSTD_isError (status))
+    return -1;
+
+  /* zero once a frame has been decoded and flushed */
+  self->ended = !status;
+
+  return out.pos;
+}
+
+static void edi_input_unzstd_fini (edi_input_filter_t *self)
+{
+  ZSTD_freeDStream ((ZSTD_DStream *) self->state);
+}
+#endif
+
+/* sets up a filter for a stream compressed the given way, returning
+   zero if that isn't supported */
+static int edi_input_filter_init (edi_input_filter_t *self,
+				  edi_compression_t compression)
+{
+  self->compression = compression;
+
+  if (compression == EDI_COMPRESSION_NONE ||
+      compression == EDI_COMPRESSION_AUTO)
+    return 1;
+
+#ifdef EDI_FILTER_GZIP
+  if (compression == EDI_COMPRESSION_GZIP)
+    {
+      z_stream *z;
+
+      if (!(z = calloc (1, sizeof (z_stream))))
+	return 0;
+
+      /* 32 to accept a zlib header as well as a gzip one */
+      if (inflateInit2 (z, 15 + 32) != Z_OK)
+	{
+	  free (z);
+	  return 0;
+	}
+
+      self->state = z;
+      self->run = edi_input_gunzip;
+      self->fini = edi_input_gunzip_fini;
+    }
+#endif
+
+#ifdef EDI_FILTER_ZSTD
+  if (compression == EDI_COMPRESSION_ZSTD)
+    {
+      ZSTD_DStream *zstd;
+
+      if (!(zstd = ZSTD_createDStream ()))
+	return 0;
+
+      if (ZSTD_isError (ZSTD_initDStream (zstd)))
+	{
+	  ZSTD_freeDStream (zstd);
+	  return 0;
+	}
+
+      self->state = zstd;
+      self->run = edi_input_unzstd;
+      self->fini = edi_input_unzstd_fini;
+    }
+#endif
+
+  if (!self->run)
+    return 0;
+
+  if (!(self->window = malloc (EDI_FILTER_WINDOW)))
+    return 0;
+
+  self->size = EDI_FILTER_WINDOW;
+  return 1;
+}
+
+/* the compression a stream starting with the given characters uses */
+static edi_compression_t edi_input_filter_detect (const char *head,
+						  unsigned int size)
+{
+  const unsigned char *c = (const unsigned char *) head;
+
+  if (size >= 2 && c[0] == 0x1f && c[1] == 0x8b)
+    return EDI_COMPRESSION_GZIP;
+
+  if (size >= 4 && c[0] == 0x28 && c[1] == 0xb5 && c[2] == 0x2f &&
+      c[3] == 0xfd)
+    return EDI_COMPRESSION_ZSTD;
+
+  return EDI_COMPRESSION_NONE;
+}
+
+/**
+   \brief Creates a filter for a stream.
+   \param compression How the stream is compressed.
+   \return Pointer to the filter, or NULL on failure - including if
+   support for the compression wasn't built in.
+
+   A filter is good for one stream.
+*/
+edi_input_filter_t *
+edi_input_filter_create (edi_compression_t compression)
+{
+  edi_input_filter_t *self;
+
+  if (!(self = calloc (1, sizeof (edi_input_filter_t))))
+    return NULL;
+
+  if (!edi_input_filter_init (self, compression))
+    {
+      edi_input_filter_free (self);
+      return NULL;
+    }
+
+  return self;
+}
+
+/**
+   \brief Frees a filter.
+   \param self Pointer to the filter.
+*/
+void
+edi_input_filter_free (edi_input_filter_t *self)
+{
+  if (!self)
+    return;
+
+  if (self->fini)
+    self->fini (self);
+
+  free (self->window);
+  free (self);
+}
+
+/* decompresses as much of the input as there is, parsing each window
+   as it is filled */
+static void edi_input_filter_pass (edi_input_filter_t *self,
+				   edi_parser_t *parser,
+				   const char *buffer, unsigned long size)
+{
+  unsigned long used;
+  long n;
+
+  if (!self->run)
+    {
+      edi_input_feed (parser, (char *) buffer, size);
+      return;
+    }
+
+  while (!parser->error)
+    {
+      if ((n = self->run (self, buffer, size, &used)) < 0)
+	{
+	  edi_parser_raise_error (parser, EDI_EREAD);
+	  return;
+	}
+
+      buffer += used;
+      size -= used;
+
+      if (n)
+	edi_input_feed (parser, self->window, n);
+      else if (!used)
+	return;
+    }
+}
+
+/**
+   \brief Parses a chunk of a stream through a filter.
+   \param self Pointer to the filter.
+   \param parser Pointer to the parser.
+   \param buffer The chunk, which is not modified and may be reused
+   once this returns.
+   \param size Length of the chunk.
+   \param done Non-zero if this is the last chunk of the stream.
+   \return Non-zero unless the parser has stopped with an error.
+
+   As with edi_parser_parse_file(), the parser is reset between
+   interchanges. A stream which ends part way through an interchange,
+   or a compressed frame, raises EDI_EEOF; one which can't be
+   decompressed raises EDI_EREAD.
+*/
+int
+edi_input_filter_parse (edi_input_filter_t *self, edi_parser_t *parser,
+			char *buffer, unsigned long size, int done)
+{
+  if (self->compression == EDI_COMPRESSION_AUTO)
+    {
+      while (self->heads < sizeof (self->head) && size)
+	{
+	  self->head[self->heads++] = *buffer++;
+	  size--;
+	}
+
+      if (self->heads < sizeof (self->head) && !done)
+	return !parser->error;
+
+      if (!edi_input_filter_init
+	  (self, edi_input_filter_detect (self->head, self->heads)))
+	{
+	  edi_parser_raise_error (parser, EDI_EREAD);
+	  return 0;
+	}
+
+      edi_input_filter_pass (self, parser, self->head, self->heads);
+    }
+
+  edi_input_filter_pass (self, parser, buffer, size);
+
+  if (done)
+    {
+      if (self->run && !self->ended && !parser->error)
+	edi_parser_raise_error (parser, EDI_EEOF);
+
+      edi_input_finish (parser);
+    }
+
+  return !parser->error;
+}
+
+/** \} */
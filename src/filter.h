@@ -0,0 +1,70 @@
+/*
+
+  The MEDICI Electronic Data Interchange Library
+  Copyright (C) 2002  David Coles
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+#ifndef FILTER_H
+#define FILTER_H
+
+/* size of the window a stream is decompressed into */
+#define EDI_FILTER_WINDOW 262144
+
+typedef struct edi_input_filter_s edi_input_filter_t;
+
+/**
+   \brief Filters some of a stream into the window
+
+   Called with the filter, and the input and its size (zero once the
+   input is exhausted). Returns the number of characters written to
+   the window, or -1 if the input is corrupt, and sets the unsigned
+   long to the number of characters of input consumed.
+*/
+typedef long (*edi_input_filter_run_t)
+     (edi_input_filter_t *, const char *, unsigned long, unsigned long *);
+
+/** \brief A decompressor in front of a parser */
+struct edi_input_filter_s
+{
+  edi_compression_t compression;
+
+  /** \brief NULL if the stream is passed to the parser as it is */
+  edi_input_filter_run_t run;
+  void (*fini) (edi_input_filter_t *);
+  void *state;
+
+  /** \brief Decompressed characters, parsed before it is reused */
+  char *window;
+  unsigned long size;
+
+  /** \brief Non-zero at the end of a compressed frame or member,
+      which is the only place the input may end */
+  int ended;
+
+  /** \brief The start of the stream, held back until there is
+      enough of it to recognise, for EDI_COMPRESSION_AUTO */
+  char head[4];
+  unsigned int heads;
+};
+
+/* filter.c */
+edi_input_filter_t *edi_input_filter_create(edi_compression_t);
+void edi_input_filter_free(edi_input_filter_t *);
+int edi_input_filter_parse(edi_input_filter_t *, edi_parser_t *, char *, unsigned long, int);
+
+#endif /*FILTER_H*/
@@ -22,6 +22,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 
 #include "internal.h"
@@ -29,12 +30,34 @@
 
 #define CACHE 1
 
+/* An index of one of the tables, by the string(s) at the given
+   offsets in each entry: open addressing, with each slot holding the
+   position of the first entry with a key, or -1 if empty. Built once
+   when the directory is created. */
+
+typedef struct {
+  char *table;
+  size_t stride;
+  size_t key1, key2;
+  int pair;
+  int *slot;
+  unsigned int mask;
+} findex;
+
 typedef struct {
   edi_directory_t directory;
   edi_stack_t stack;
-  edi_hash_t hash;
   char transaction[16];
 
+  findex element_index;		/* element_info by code */
+  findex cmpsite_index;		/* cmpsite_info by code */
+  findex segment_index;		/* segment_info by code */
+  findex codelst_index;		/* codelst_info by element and value */
+  findex cmpsite_first;		/* cmpsite_list by composite */
+  findex cmpsite_entry;		/* cmpsite_list by composite and content */
+  findex segment_first;		/* segment_list by segment */
+  findex segment_entry;		/* segment_list by segment and content */
+
   edi_francesco_element_info_t *element_info;
   edi_francesco_cmpsite_info_t *cmpsite_info;
   edi_francesco_segment_info_t *segment_info;
@@ -50,6 +73,92 @@ typedef struct {
 } fnode;
 
 
+#define FKEY(x, n, k) (*(char **) ((x)->table + (n) * (x)->stride + (k)))
+
+static unsigned long
+findex_hash (const char *key1, const char *key2)
+{
+  unsigned long h = 0;
+
+  for (; *key1; key1++)
+    h = (h << 5) - h + (unsigned char) *key1;
+
+  if (key2)
+    for (h = (h << 5) - h; *key2; key2++)
+      h = (h << 5) - h + (unsigned char) *key2;
+
+  return h;
+}
+
+/* position of the first entry with the key(s), or -1 */
+static int
+findex_find (findex *x, const char *key1, const char *key2)
+{
+  unsigned int h;
+  int n;
+
+  if (!x->slot || !key1 || (x->pair && !key2))
+    return -1;
+
+  for (h = findex_hash (key1, key2) & x->mask;
+       (n = x->slot[h]) >= 0; h = (h + 1) & x->mask)
+    if (!strcmp (FKEY (x, n, x->key1), key1) &&
+	(!x->pair || !strcmp (FKEY (x, n, x->key2), key2)))
+      return n;
+
+  return -1;
+}
+
+static int
+findex_init (findex *x, void *table, size_t stride, size_t key1,
+	     size_t key2, int pair)
+{
+  unsigned int size, h;
+  int n, count;
+
+  x->table = (char *) table;
+  x->stride = stride;
+  x->key1 = key1;
+  x->key2 = key2;
+  x->pair = pair;
+  x->slot = NULL;
+  x->mask = 0;
+
+  if (!table)
+    return 1;
+
+  /* the tables end with an entry with no (first) key */
+  for (count = 0; FKEY (x, count, key1); count++)
+    ;
+
+  /* at most half full */
+  for (size = 16; size < (unsigned int) count * 2; size *= 2)
+    ;
+
+  if (!(x->slot = (int *) malloc (size * sizeof (int))))
+    return 0;
+
+  x->mask = size - 1;
+  memset (x->slot, 0xff, size * sizeof (int));
+
+  /* later entries with the same key are never found, just as when
+     the tables were searched from the start */
+  for (n = 0; n < count; n++)
+    if ((!pair || FKEY (x, n, key2)) &&
+	findex_find (x, FKEY (x, n, key1),
+		     pair ? FKEY (x, n, key2) : NULL) < 0)
+      {
+	for (h = findex_hash (FKEY (x, n, key1),
+			      pair ? FKEY (x, n, key2) : NULL) & x->mask;
+	     x->slot[h] >= 0; h = (h + 1) & x->mask)
+	  ;
+	x->slot[h] = n;
+      }
+
+  return 1;
+}
+
+
 static edi_francesco_trnsctn_rule_t *getfirstrule
 (edi_francesco_trnsctn_rule_t *rules, char *transaction, char *container)
 {
@@ -104,62 +213,29 @@ static edi_francesco_trnsctn_rule_t
 static edi_francesco_element_info_t *
 find_element_info (fdata *d, char *code)
 {
-  edi_francesco_element_info_t *info;
-
-  if(!code)
-    return NULL;
-
-  for (info = d->element_info; info->code; info++)
-    if (!strcmp (code, info->code))
-      return info;
-  
-  return NULL;
+  int n = findex_find (&(d->element_index), code, NULL);
+  return n < 0 ? NULL : d->element_info + n;
 }
 
 static edi_francesco_cmpsite_info_t *
 find_cmpsite_info (fdata *d, char *code)
 {
-  edi_francesco_cmpsite_info_t *info;
-
-  if(!code)
-    return NULL;
-  
-  for (info = d->cmpsite_info; info->code; info++)
-    if (!strcmp (code, info->code))
-      return info;
-  
-  return NULL;
+  int n = findex_find (&(d->cmpsite_index), code, NULL);
+  return n < 0 ? NULL : d->cmpsite_info + n;
 }
 
 static edi_francesco_segment_info_t *
 find_segment_info (fdata *d, char *code)
 {
-  edi_francesco_segment_info_t *info;
-  
-  if(!code)
-    return NULL;
-
-  for (info = d->segment_info; info->code; info++)
-    if (!strcmp (code, info->code))
-      return info;
-  
-  return NULL;
+  int n = findex_find (&(d->segment_index), code, NULL);
+  return n < 0 ? NULL : d->segment_info + n;
 }
 
 static edi_francesco_codelst_info_t *
 find_codelst_info (fdata *d, char *element, char *value)
 {
-  edi_francesco_codelst_info_t *info;
-  
-  if(!element || !value)
-    return NULL;
-
-  for (info = d->codelst_info; info->element; info++)
-    if (!strcmp (element, info->element) &&
-	!strcmp (value, info->value))
-      return info;
-
-  return NULL;
+  int n = findex_find (&(d->codelst_index), element, value);
+  return n < 0 ? NULL : d->codelst_info + n;
 }
 
 static char *
@@ -250,28 +326,15 @@ static edi_item_t element_repr
 static edi_francesco_cmpsite_list_t *
 standaloneCompositeContents (fdata *d, char *composite, char *content)
 {
-  edi_francesco_cmpsite_list_t *cmpsite_list =
-    d->cmpsite_list;
-
-  int n;
-  for (n = 0; cmpsite_list[n].composite; n++)
-    if (!strcmp (composite, cmpsite_list[n].composite) &&
-        !strcmp (content, cmpsite_list[n].content))
-      return cmpsite_list + n;
-  return NULL;
+  int n = findex_find (&(d->cmpsite_entry), composite, content);
+  return n < 0 ? NULL : d->cmpsite_list + n;
 }
 
 static edi_francesco_segment_list_t *
 standaloneSegmentContents (fdata *d, char *segment, char *content)
 {
-  edi_francesco_segment_list_t *contents;
-
-  for (contents = d->segment_list; contents->segment; contents++)
-    if (!strcmp (segment, contents->segment) &&
-        !strcmp (content, contents->content))
-      return contents;
-
-  return NULL;
+  int n = findex_find (&(d->segment_entry), segment, content);
+  return n < 0 ? NULL : d->segment_list + n;
 }
 
 
@@ -331,37 +394,23 @@ codelist_name (edi_directory_t *d, char *element, char *value)
 }
 
 
+/* the contents of a segment or composite are consecutive entries in
+   the list, so an element's position is its distance from the first */
+
 static int
 element_indx (edi_directory_t *d, char *segment,
 		char *element, char *subelement, int *xp, int *yp)
 {
-  edi_francesco_segment_list_t *segment_list =
-    ((fdata *) d->user_data)->segment_list;
-  edi_francesco_cmpsite_list_t *cmpsite_list =
-    ((fdata *) d->user_data)->cmpsite_list;
+  fdata *self = (fdata *) d->user_data;
+  int x = -1, y = -1, n;
   
-  int x = -1, y = -1;
-  
-  for (; segment_list->segment; segment_list++)
-    {
-      if (!strcmp (segment, segment_list->segment))
-        {
-          x++;
-          if (!strcmp (element, segment_list->content))
-            break;
-        }
-    }
+  if ((n = findex_find (&(self->segment_entry), segment, element)) >= 0)
+    x = n - findex_find (&(self->segment_first), segment, NULL);
 
   if (subelement)
     {
-      for (; cmpsite_list->composite;
-	   cmpsite_list++)
-        if (!strcmp (element, cmpsite_list->composite))
-          {
-            y++;
-            if (!strcmp (subelement, cmpsite_list->content))
-              break;
-          }
+      if ((n = findex_find (&(self->cmpsite_entry), element, subelement)) >= 0)
+	y = n - findex_find (&(self->cmpsite_first), element, NULL);
     }
   else
     y = 0;
@@ -589,9 +638,13 @@ static unsigned int segment_size (edi_directory_t *d, char *code)
     ((fdata *)d->user_data)->segment_list;
   int n, b;
   
-  for (n = b = 0; segment_list[n].segment; n++)
-    if (!strcmp (code, segment_list[n].segment))
-      b++;
+  if ((n = findex_find (&(((fdata *)d->user_data)->segment_first),
+			code, NULL)) < 0)
+    return 0;
+
+  for (b = 0; segment_list[n].segment &&
+	 !strcmp (code, segment_list[n].segment); n++)
+    b++;
   return b;
 }
 
@@ -605,10 +658,9 @@ static edi_item_t segment_item
   
   edi_item_t item = EDI_NULL_ITEM;
 
-  for (n = 0; segment_list[n].segment; n++)
-    if (!strcmp (code, segment_list[n].segment))
-      break;
-  
+  if ((n = findex_find (&(((fdata *)d->user_data)->segment_first),
+			code, NULL)) < 0)
+    return item;
   
   item.code = segment_list[n+i].content;
   item.type = segment_list[n+i].type == EDI_COMPOSITE ? 1 : 0;
@@ -641,9 +693,13 @@ static unsigned int composite_size (edi_directory_t *d, char *code)
       ((fdata *)d->user_data)->cmpsite_list;
     int n, b;
     
-    for (n = b = 0; cmpsite_list[n].composite; n++)
-      if (!strcmp (code, cmpsite_list[n].composite))
-	b++;
+    if ((n = findex_find (&(((fdata *)d->user_data)->cmpsite_first),
+			  code, NULL)) < 0)
+      return 0;
+
+    for (b = 0; cmpsite_list[n].composite &&
+	   !strcmp (code, cmpsite_list[n].composite); n++)
+      b++;
 
     return b;
 }
@@ -656,9 +712,9 @@ static edi_item_t composite_item
   edi_item_t item = EDI_NULL_ITEM;
   int n;
   
-  for (n = 0; cmpsite_list[n].composite; n++)
-    if (!strcmp (code, cmpsite_list[n].composite))
-      break;
+  if ((n = findex_find (&(((fdata *)d->user_data)->cmpsite_first),
+			code, NULL)) < 0)
+    return item;
   
   item.code = cmpsite_list[n+i].content;
   item.type = 0;
@@ -720,8 +776,33 @@ void * edi_francesco_create
     self->trnsctn_rule = trnsctn_rule;
     
     edi_stack_init (&(self->stack));
-    /*edi_hash_init (&(self->hash), 1847, 
-      (int(*)(void *,void*)) strcmp, gtk_hash);*/
+
+    /* index the tables, so that lookups don't have to search them */
+#define FINDEX(x, table, type, key1, key2, pair)			\
+    findex_init (&(self->x), table, sizeof (type),			\
+		 offsetof (type, key1), offsetof (type, key2), pair)
+
+    if (!FINDEX (element_index, element_info,
+		 edi_francesco_element_info_t, code, code, 0) ||
+	!FINDEX (cmpsite_index, cmpsite_info,
+		 edi_francesco_cmpsite_info_t, code, code, 0) ||
+	!FINDEX (segment_index, segment_info,
+		 edi_francesco_segment_info_t, code, code, 0) ||
+	!FINDEX (codelst_index, codelst_info,
+		 edi_francesco_codelst_info_t, element, value, 1) ||
+	!FINDEX (cmpsite_first, cmpsite_list,
+		 edi_francesco_cmpsite_list_t, composite, composite, 0) ||
+	!FINDEX (cmpsite_entry, cmpsite_list,
+		 edi_francesco_cmpsite_list_t, composite, content, 1) ||
+	!FINDEX (segment_first, segment_list,
+		 edi_francesco_segment_list_t, segment, segment, 0) ||
+	!FINDEX (segment_entry, segment_list,
+		 edi_francesco_segment_list_t, segment, content, 1))
+      {
+	edi_francesco_free (directory);
+	return NULL;
+      }
+#undef FINDEX
     
     directory->start = start_transaction;
     directory->old_parse = iterate_transaction_wrapper;
@@ -759,5 +840,68 @@ void * edi_francesco_create
 
 void edi_francesco_free(edi_directory_t * francesco)
 {
+  fdata *self = (fdata *) francesco;
+
+  if(!self)
+    return;
+
+  free(self->element_index.slot);
+  free(self->cmpsite_index.slot);
+  free(self->segment_index.slot);
+  free(self->codelst_index.slot);
+  free(self->cmpsite_first.slot);
+  free(self->cmpsite_entry.slot);
+  free(self->segment_first.slot);
+  free(self->segment_entry.slot);
   free(francesco);
 }
+
+/* a shared directory lasts as long as the process */
+static void edi_francesco_keep(edi_directory_t * francesco)
+{
+}
+
+/* held while a shared directory is looked for and created */
+static edi_lock_t edi_francesco_lock = EDI_LOCK_INITIALIZER;
+
+/**
+   \brief Returns a directory which is created once and then shared.
+   \param shared Where the directory is kept, initially NULL.
+   \return Pointer to the directory, or NULL on failure.
+
+   For the built-in service directories, which have no transaction
+   rules and so are only ever read from once created. The first caller
+   creates the directory under a lock, so that threads starting at once
+   agree on a single copy. It is never freed - edi_directory_free()
+   does nothing to it.
+*/
+edi_directory_t *edi_francesco_shared
+(
+ edi_directory_t **shared,
+ edi_francesco_element_info_t *element_info,
+ edi_francesco_cmpsite_info_t *cmpsite_info,
+ edi_francesco_segment_info_t *segment_info,
+ edi_francesco_cmpsite_list_t *cmpsite_list,
+ edi_francesco_segment_list_t *segment_list,
+ edi_francesco_codelst_info_t *codelst_info,
+ edi_francesco_trnsctn_rule_t *trnsctn_rule
+ )
+{
+  edi_directory_t *directory;
+
+  edi_lock(&edi_francesco_lock);
+
+  if(!(directory = *shared) &&
+     (directory = edi_francesco_create(element_info, cmpsite_info,
+				       segment_info, cmpsite_list,
+				       segment_list, codelst_info,
+				       trnsctn_rule)))
+    {
+      directory->free = edi_francesco_keep;
+      *shared = directory;
+    }
+
+  edi_unlock(&edi_francesco_lock);
+
+  return directory;
+}
@@ -113,3 +113,11 @@ void *edi_francesco_create(edi_francesco_element_info_t *,
 			   edi_francesco_trnsctn_rule_t *);
 
 void edi_francesco_free(edi_directory_t *);
+edi_directory_t *edi_francesco_shared(edi_directory_t **,
+				      edi_francesco_element_info_t *,
+				      edi_francesco_cmpsite_info_t *,
+				      edi_francesco_segment_info_t *,
+				      edi_francesco_cmpsite_list_t *,
+				      edi_francesco_segment_list_t *,
+				      edi_francesco_codelst_info_t *,
+				      edi_francesco_trnsctn_rule_t *);
@@ -50,6 +50,9 @@
 
 #define cmpfn ((int (*)(void *, void *)) mystrcmp)
 
+/* the directory may be a cursor, so always go through user_data */
+#define GIOVANNI(d) ((edi_giovanni_t *) ((d) ? (d)->user_data : NULL))
+
 static int mystrcmp(char *s1, char *s2)
 {
   if(s1 && s2)
@@ -60,6 +63,27 @@ static int mystrcmp(char *s1, char *s2)
     return 1;
 }
 
+/* codelist values are keyed by their element's entry and their code */
+static int value_cmp(void *a, void *b)
+{
+  edi_gitem_t *x = (edi_gitem_t *) a, *y = (edi_gitem_t *) b;
+  return x->parent == y->parent ? mystrcmp(x->item.code, y->item.code) : 1;
+}
+
+static unsigned long value_hash(void *v, unsigned int size)
+{
+  edi_gitem_t *gitem = (edi_gitem_t *) v;
+  return x31_hash(gitem->item.code, size) + ((unsigned long) gitem->parent >> 4);
+}
+
+/* the first definition of a code wins, as it did when these were
+   searched as lists */
+static void index_gitem(edi_hash_t *hash, void *key, edi_gitem_t *gitem)
+{
+  if(!edi_hash_exists(hash, key))
+    edi_hash_store(hash, key, gitem);
+}
+
 
 /**
    \defgroup edi_giovanni edi_giovanni
@@ -70,39 +94,39 @@ static int mystrcmp(char *s1, char *s2)
 edi_item_t *
 edi_giovanni_find_element (edi_directory_t *directory, char *code)
 {
-  edi_giovanni_t *giovanni = (edi_giovanni_t *) directory;
+  edi_giovanni_t *giovanni = GIOVANNI(directory);
   return giovanni && code ?
-    (edi_item_t *) edi_list_find(&(giovanni->elements), code, cmpfn) : NULL;
+    (edi_item_t *) edi_hash_fetch(&(giovanni->elements), code) : NULL;
 }
 
 edi_item_t *
 edi_giovanni_find_composite (edi_directory_t *directory, char *code)
 {
-  edi_giovanni_t *giovanni = (edi_giovanni_t *) directory;
+  edi_giovanni_t *giovanni = GIOVANNI(directory);
   return giovanni && code ?
-    (edi_item_t *) edi_list_find(&(giovanni->composites), code, cmpfn) : NULL;
+    (edi_item_t *) edi_hash_fetch(&(giovanni->composites), code) : NULL;
 }
 
 edi_item_t *
 edi_giovanni_find_segment (edi_directory_t *directory, char *code)
 {
-  edi_giovanni_t *giovanni = (edi_giovanni_t *) directory;
+  edi_giovanni_t *giovanni = GIOVANNI(directory);
   return giovanni && code ?
-    (edi_item_t *)  edi_list_find(&(giovanni->segments), code, cmpfn) : NULL;
+    (edi_item_t *) edi_hash_fetch(&(giovanni->segments), code) : NULL;
 }
 
 edi_item_t *edi_giovanni_find_codelist
 (edi_directory_t *directory, char *element, char *code)
 {
-  edi_gitem_t *entity;
-  
-  if(!(entity = (edi_gitem_t *) edi_giovanni_find_element(directory, element)))
-    return NULL;
+  edi_giovanni_t *giovanni = GIOVANNI(directory);
+  edi_gitem_t key;
   
-  if(!(entity = (edi_gitem_t *) edi_list_find(&(entity->list), code, cmpfn)))
+  if(!code || !(key.parent = (edi_gitem_t *)
+		edi_giovanni_find_element(directory, element)))
     return NULL;
   
-  return (edi_item_t *) entity;
+  key.item.code = code;
+  return (edi_item_t *) edi_hash_fetch(&(giovanni->codelists), &key);
 }
 
 
@@ -357,42 +381,235 @@ static edi_item_t element_repr (edi_directory_t *directory, char *code)
 
 
 
-static edi_node_t *first_node (edi_gitem_t *entity)
+/**********************************************************************
+ * Compiling transaction rules (see edi_gprogram_t)
+ **********************************************************************/
+
+/* steps are indexed by their block and code */
+static int step_cmp(void *a, void *b)
 {
-  edi_list_t *list;
-  list = &(entity->list);
-  return list->first;
+  edi_gstep_t *x = (edi_gstep_t *) a, *y = (edi_gstep_t *) b;
+  return x->block == y->block ? mystrcmp(x->code, y->code) : 1;
 }
 
+static unsigned long step_hash(void *v, unsigned int size)
+{
+  edi_gstep_t *step = (edi_gstep_t *) v;
+  return x31_hash(step->code, size) + step->block;
+}
 
+static void program_free(edi_gprogram_t *program)
+{
+  if(!program)
+    return;
+  
+  if(program->index.list)
+    edi_hash_fini(&(program->index), NULL);
+  
+  free(program->block);
+  free(program->step);
+  free(program);
+}
+
+/* count the blocks and steps in a transaction or loop */
+static void program_size(edi_gprogram_t *program, edi_gitem_t *container,
+			 unsigned int depth, unsigned int *blocks,
+			 unsigned int *steps)
+{
+  edi_gitem_t *gitem;
+  edi_node_t *node;
+  
+  (*blocks)++;
+  
+  if(depth > program->depth)
+    program->depth = depth;
+  
+  for(node = container->list.first; node; node = node->next)
+    {
+      (*steps)++;
+      
+      if((gitem = (edi_gitem_t *) node->data) && gitem->item.type)
+	program_size(program, gitem, depth + 1, blocks, steps);
+    }
+}
+
+/* fill in a block's steps, then the blocks of its loops */
+static int program_fill(edi_gprogram_t *program, edi_gitem_t *container,
+			unsigned int b, unsigned int *blocks,
+			unsigned int *steps)
+{
+  edi_gblock_t *block = program->block + b;
+  edi_gstep_t *step;
+  edi_gitem_t *first;
+  edi_node_t *node;
+  
+  block->first = *steps;
+  block->count = edi_list_length(&(container->list));
+  *steps += block->count;
+  
+  for(node = container->list.first, step = program->step + block->first;
+      node; node = node->next, step++)
+    {
+      if(!(step->item = (edi_gitem_t *) node->data))
+	return 0;
+      
+      step->block = b;
+      
+      if(!step->item->item.type)
+	step->code = step->item->item.code;
+      else
+	{
+	  /* a loop is selected by its first member, which must be a
+	     segment (see iterate_transaction()) */
+	  first = step->item->list.first ?
+	    (edi_gitem_t *) step->item->list.first->data : NULL;
+	  
+	  if(first && !first->item.type)
+	    step->code = first->item.code;
+	  else
+	    step->error = EDI_EBADTSG;
+	  
+	  step->body = (*blocks)++;
+	  
+	  if(!program_fill(program, step->item, step->body, blocks, steps))
+	    return 0;
+	}
+      
+      /* a step which can't repeat at all is always passed over */
+      if(!step->item->item.reps)
+	{
+	  step->code = NULL;
+	  step->error = EDI_ENONE;
+	}
+      else if(!step->error && step->item->item.reqr)
+	step->error = EDI_EREQUIRED;
+    }
+  
+  return 1;
+}
+
+static edi_gprogram_t *program_compile(edi_gitem_t *transaction)
+{
+  edi_gprogram_t *program;
+  edi_gblock_t *block;
+  edi_gstep_t *step, *head;
+  unsigned int blocks = 0, steps = 0, stop, b, n;
+  
+  if(!(program = (edi_gprogram_t *) calloc(1, sizeof(edi_gprogram_t))))
+    return NULL;
+  
+  program_size(program, transaction, 1, &blocks, &steps);
+  
+  /* one spare step, so that the end of the last block is a step too */
+  if(!(program->block = (edi_gblock_t *) calloc(blocks, sizeof(edi_gblock_t))) ||
+     !(program->step = (edi_gstep_t *) calloc(steps + 1, sizeof(edi_gstep_t))) ||
+     !edi_hash_init(&(program->index), 61, step_cmp, step_hash))
+    goto fail;
+  
+  blocks = 1;
+  steps = 0;
+  
+  if(!program_fill(program, transaction, 0, &blocks, &steps))
+    goto fail;
+  
+  program->blocks = blocks;
+  program->steps = steps;
+  
+  for(b = 0; b < blocks; b++)
+    {
+      block = program->block + b;
+      
+      /* the first step at or after each one which can't be passed */
+      stop = block->first + block->count;
+      for(n = stop; n-- > block->first;)
+	{
+	  step = program->step + n;
+	  if(step->error)
+	    stop = n;
+	  step->stop = stop;
+	}
+      
+      /* chain together the steps of each code, in order */
+      for(n = block->first; n < block->first + block->count; n++)
+	{
+	  step = program->step + n;
+	  
+	  if(!step->code)
+	    continue;
+	  
+	  if((head = (edi_gstep_t *) edi_hash_fetch(&(program->index), step)))
+	    {
+	      while(head->same)
+		head = head->same;
+	      head->same = step;
+	    }
+	  else if(!edi_hash_store(&(program->index), step, step))
+	    goto fail;
+	}
+    }
+  
+  return program;
+  
+ fail:
+  program_free(program);
+  return NULL;
+}
+
+
+
+
+static void clear_transaction(edi_gcursor_t *cursor)
+{
+  cursor->depth = 0;
+  cursor->program = NULL;
+  cursor->transaction = 0;
+}
 
 
 static edi_error_t
 start_transaction(edi_directory_t *directory, char *transaction)
 {
-  edi_giovanni_t *giovanni = (edi_giovanni_t *) directory;
+  edi_giovanni_t *giovanni = GIOVANNI(directory);
+  edi_gcursor_t *cursor = (edi_gcursor_t *) directory;
   edi_gitem_t *entity;
   edi_giterator_t *iterator;
   
   if(!giovanni)
     return EDI_EBADTSG;
   
-  edi_stack_init(&(giovanni->stack));
+  /* anything left over from a transaction which was abandoned */
+  clear_transaction(cursor);
   
   if(!(entity = (edi_gitem_t *) edi_list_find(&(giovanni->transactions),
 					      transaction, cmpfn)))
     return EDI_ETUNKNOWN;
 
-  giovanni->transaction = 1;
+  /* the rules are compiled as the transaction is read, so there are
+     none if it was never finished */
+  if(!entity->program)
+    return EDI_EBADTSG;
+  
+  cursor->transaction = 1;
+  
+  /* room for the deepest loop, so segments never need to allocate */
+  if(cursor->blck < entity->program->depth)
+    {
+      if(!(iterator = (edi_giterator_t *)
+	   realloc(cursor->stack, entity->program->depth *
+		   sizeof(edi_giterator_t))))
+	return EDI_ENOMEM;
+      
+      cursor->stack = iterator;
+      cursor->blck = entity->program->depth;
+    }
   
-  if(!(iterator = (edi_giterator_t *) malloc(sizeof(edi_giterator_t))))
-    return EDI_ENOMEM;
+  cursor->program = entity->program;
   
-  iterator->node = first_node(entity);
+  iterator = cursor->stack + cursor->depth++;
+  iterator->block = 0;
+  iterator->step = cursor->program->block[0].first;
   iterator->reps = 0;
 
-  edi_stack_push(&(giovanni->stack), iterator);
-
   return EDI_ENONE;
 }
 
@@ -400,29 +617,51 @@ start_transaction(edi_directory_t *directory, char *transaction)
 static edi_error_t
 end_transaction(edi_directory_t *directory)
 {
-  edi_giovanni_t *giovanni = (edi_giovanni_t *) directory;
-  edi_stack_t *stack;
+  edi_gcursor_t *cursor = (edi_gcursor_t *) directory;
   edi_error_t error = EDI_ENONE;
   
-  if(!giovanni)
+  if(!GIOVANNI(directory))
     return EDI_EBADTSG;
   
-  /* shorthand */
-  stack = &(giovanni->stack);
-  
-  if(edi_stack_size(stack))
+  if(cursor->depth)
     error = EDI_ECORRUPT;
   
   /* clear down stack */
-  while(edi_stack_size(stack))
-    free(edi_stack_pop(stack));
-
-  giovanni->transaction = 0;
+  clear_transaction(cursor);
   
   return error;
 }
 
 
+/* cursors made by edi_directory_cursor() share everything but the
+   state of the walk with the directory they were made from */
+
+static void cursor_free(edi_directory_t *directory)
+{
+  if(!directory)
+    return;
+  
+  free(((edi_gcursor_t *) directory)->stack);
+  free(directory);
+}
+
+static edi_directory_t *cursor_create(edi_directory_t *directory)
+{
+  edi_gcursor_t *cursor;
+  
+  if(!(cursor = (edi_gcursor_t *) malloc(sizeof(edi_gcursor_t))))
+    return NULL;
+  
+  memset(cursor, 0, sizeof(edi_gcursor_t));
+  cursor->directory = *directory;
+  cursor->directory.user_data = directory->user_data;
+  cursor->directory.cursor = NULL;
+  cursor->directory.free = cursor_free;
+  
+  return (edi_directory_t *) cursor;
+}
+
+
 
 
 
@@ -434,11 +673,12 @@ static void giovanni_free(edi_directory_t *directory)
   if(!giovanni)
     return;
   
-  /* clear down the finder lists (but NOT the data that the nodes point to) */
+  /* clear down the indexes (but NOT the data that the nodes point to) */
   
-  edi_list_drain(&(giovanni->elements), NULL);
-  edi_list_drain(&(giovanni->segments), NULL);
-  edi_list_drain(&(giovanni->composites), NULL);
+  edi_hash_fini(&(giovanni->elements), NULL);
+  edi_hash_fini(&(giovanni->segments), NULL);
+  edi_hash_fini(&(giovanni->composites), NULL);
+  edi_hash_fini(&(giovanni->codelists), NULL);
   edi_list_drain(&(giovanni->transactions), NULL);
   
   /* Now remove each item in turn */
@@ -450,6 +690,9 @@ static void giovanni_free(edi_directory_t *directory)
       /* clear the item's list (but NOT the data that the nodes point to) */
       edi_list_drain(&(item->list), NULL);
       
+      /* and a transaction's compiled rules */
+      program_free(item->program);
+      
       /* free the character strings associated with this item */
       free(item->item.code);
       free(item->item.name);
@@ -460,6 +703,9 @@ static void giovanni_free(edi_directory_t *directory)
       free(item);
     }
 
+  /* the directory's own cursor has iterators too */
+  free(giovanni->cursor.stack);
+
   /* finally, free the memory for the directory structure */
   free(giovanni);
 }
@@ -472,8 +718,27 @@ static void giovanni_free(edi_directory_t *directory)
 
 
 
-/* This routine is probably not quite buggy as it was, since i have
-   gone through it and commented the logic */
+/* the data behind a giovanni directory or one of its cursors, for
+   code which needs more than the vtable (see cosimo.c), else NULL */
+
+edi_giovanni_t *edi_giovanni_data(edi_directory_t *directory)
+{
+  if(directory && (directory->free == giovanni_free ||
+		   directory->free == cursor_free))
+    return GIOVANNI(directory);
+  
+  return NULL;
+}
+
+
+
+
+/* Matches a segment against the rules of the transaction, telling
+   the application about the loops which start and end before it. The
+   iterator at the top of the stack is the position within the
+   innermost loop (or the transaction itself); a segment either
+   repeats the step there, selects a later step in the same block, or
+   finishes the block and is tried against the enclosing one. */
 
 static edi_error_t iterate_transaction
 (edi_directory_t *directory, char *code,
@@ -482,230 +747,113 @@ static edi_error_t iterate_transaction
  edi_eventh_t end,
  edi_sgmnth_t segment)
 {
-  edi_giovanni_t *giovanni = (edi_giovanni_t *) directory;
-  edi_giterator_t *iterator, *new_iterator;
-  edi_gitem_t *entity, *new_entity;  
+  edi_gcursor_t *cursor = (edi_gcursor_t *) directory;
+  edi_gprogram_t *program = cursor->program;
+  edi_giterator_t *iterator;
+  edi_gblock_t *block;
+  edi_gstep_t *step, *match, key;
+  edi_gitem_t *entity;
   edi_parameters_t parameters;
-  edi_stack_t *stack;
-  edi_error_t error = EDI_EBADTSG;
-  edi_node_t *node;
+  edi_error_t error;
+  unsigned int last;
   
   edi_parameters_set(&parameters, LastParameter);
   
   /* check for non-null directory, otherwise we will segfault when
      dereferencing members */
   
-  if(!giovanni)
+  if(!GIOVANNI(directory))
     return EDI_EBADTSG;
   
   /* if the start_transaction method failed (no such transaction
      known) then we should probably just hand off the segment */
   
-  if(!giovanni->transaction)
+  if(!cursor->transaction)
     {
       if(segment)
 	segment (userdata, &parameters, directory);
       return EDI_ENONE;
     }
   
-  /* shorthand */
-  stack = &(giovanni->stack);
-  
-  /* an iterator at the top of the stack allows us to track progress
-     through the current loop */
-  
-  while((iterator = (edi_giterator_t *) edi_stack_peek(stack)))
+  while(cursor->depth)
     {
-      /* whilst there are still segments or loops in the container
-         loop the node member will contain a pointer to the next
-         member. if the node is null then there are no more left and
-         we need to clear down this instance of the loop and return to
-         the parent */
+      iterator = cursor->stack + cursor->depth - 1;
+      block = program->block + iterator->block;
+      last = block->first + block->count;
+      
+      /* at the end of the block an instance of the loop is complete:
+         tell the application, and count it in the enclosing block. if
+         there is nothing on the stack then we are at the end of the
+         message description */
       
-      if(!iterator->node)
-        {
-	  /* clear down and deallocate the memory for the expired iterator */
-          free(edi_stack_pop(stack));
+      if(iterator->step >= last)
+	{
+	  cursor->depth--;
 	  
-          /* inform application that the end of the loop has been reached */
-          if(edi_stack_peek(stack) && end)
+	  if(cursor->depth && end)
 	    end (userdata, EDI_LOOP, NULL);
 	  
-	  /* now that we have completed an instance of the containing
-             loop we need to update the count of the number of times
-             it has been completed. if there is nothing on the stack
-             then we are at the end of the message description */
+	  if(cursor->depth)
+	    cursor->stack[cursor->depth - 1].reps++;
 	  
-	  if((iterator = (edi_giterator_t *) edi_stack_peek(stack)))
-	    iterator->reps++;
-
-	  /* skip back to the top for another iteration */
-          continue;
-        }
-      
-      /* find a pointer to the information about the segment/loop.
-         'node' is just the entry in the list implementation, we want
-         the data which is being stored at that position in the
-         list. if the data pointer is null then the function which
-         built the tsg did bad */
-      
-      if(!(entity = (edi_gitem_t *) iterator->node->data))
-	return EDI_EBADTSG;
-      
-      /* if we have exceeded the reps for this item move on to the
-         next one in the list - hmmm, should never end up being
-         _greater_ than the reps, but it doesn't hurt to check ... */
+	  continue;
+	}
       
-      if(iterator->reps >= entity->item.reps)
-        {
-          iterator->reps = 0;
-          iterator->node = iterator->node->next;
-          continue;
-        }
+      step = program->step + iterator->step;
       
-      /* is this item marking the start of a loop ? */
+      /* a step which has been matched may repeat, up to its reps, and
+         needn't be matched again; otherwise it is left behind */
       
-      if(entity->item.type)
-        {
-	  /* find the first item in the list of children of this
-             loop. if there are no members in the list or the data
-             pointer is null then the tsg builder function did bad. */
-	  
-          if(!(node = first_node(entity)) || !node->data)
-            {
-              error = EDI_EBADTSG;
-              goto reject_segment;
-            }
-	  
-          /* a restriction in this code is that the first item in a
-             loop cannot itself be a loop, but must be a mandatory
-             segment. all tsg examples that i have seen conform to
-             this - otherwise we will have to recurse up to see if the
-             loop gets taken or not and it gets more complex to parse */
-	  
-          if(((edi_gitem_t *) node->data)->item.type)
-            {
-              error = EDI_EBADTSG;
-              goto reject_segment;
-            }
-          
-	  
-	  /* everything looks good so far - now we need to create a
-             new iterator to track progress through this loop */
-	  
-	  /* actually, we probably don't have to allocate the new
-             iterator until the first segment is matched, but what the
-             hoo? */
-	  
-          if(!(new_iterator = (edi_giterator_t *) malloc(sizeof(edi_gitem_t))))
+      if(iterator->reps)
+	{
+	  if(iterator->reps < step->item->item.reps)
 	    {
-	      error = EDI_ENOMEM;
-	      goto reject_segment;
-	    }
-	  
-	  /* Sanity checks */
-	  /* didn't we just do this? 
-	  if(!(node = first_node(entity)) || !node->data)
-            {
-              error = EDI_EBADTSG;
-              goto reject_segment;
-	      } */
-
-	  /* point this new iterator at the first item in the child list */
-	  
-          new_iterator->node = node;
-          new_iterator->reps = 0;
-          new_entity = (edi_gitem_t *) node->data;
-          
-          /* does the application provided segment code match the
-             first item in the new loop? */
-	  
-          if(code && !mystrcmp(new_entity->item.code, code))
-            {
-	      /* Yes, push this iterator onto the stack */
-	      
-              if(!edi_stack_push(stack, new_iterator))
+	      if(step->error == EDI_EBADTSG)
 		{
-		  error = EDI_ENOMEM;
+		  error = EDI_EBADTSG;
 		  goto reject_segment;
 		}
 	      
-	      /* Set up parameters to pass to the application for the
-                 containing loop and trigger it */
-	      
-	      if(start)
-		{
-		  /* populate parameters with context-specific info */
-		  edi_parameters_set(&parameters, LastParameter);
-		  edi_parameters_set_one(&parameters, Code, entity->item.code);
-		  edi_parameters_set_one(&parameters, Name, entity->item.name);
-		  edi_parameters_set_one(&parameters, Desc, entity->item.desc);
-		  edi_parameters_set_one(&parameters, Note, entity->item.note);
-		  start (userdata, EDI_LOOP, &parameters);
-		}
-	      
-	      /* update iterator and entity to reflect the new scope */
-	      iterator = new_iterator;
-	      entity = new_entity;
-	      /* surely this gets done down at 'accept_segment' */
-              /* iterator->reps++; */
-	      
-	      /* our work here is done, now all that remains is to
-                 inform the appliction of the successful matching of
-                 the segment */
-	      
-              goto accept_segment;
-            }
-	  
-	  /* no, the application provided segment code did not match
-             the first item in the new loop -- discard the new
-             iterator as we won't be needing it */
-	  
-	  free(new_iterator);
-          
-	  /* if the loop was mandatory and we have not already matched
-	     the minimum repetitions (FIXME - i'm assuming it's always
-	     a minimum of 1 here), then we have an error */
-	  
-          if(entity->item.reqr && !iterator->reps)
-            {
-              error = EDI_EREQUIRED;
-              goto reject_segment;
-            }
-          
-	  /* ok, so the loop either wasn't mandatory or we already
-             reached the minimum number of repetitions. we're done
-             with it now, so move on the next loop/segment */
+	      if(code && step->code && !strcmp(step->code, code))
+		goto accept_step;
+	    }
 	  
-          iterator->reps = 0;
-          iterator->node = iterator->node->next;
-
-	  /* skip back to the top */
-          continue;
-        }
+	  iterator->reps = 0;
+	  iterator->step++;
+	  continue;
+	}
+      
+      /* otherwise the segment selects the first step from here with
+	 its code, so long as there is no mandatory step before it
+	 which it would skip */
       
-      /* ok, the item was not a loop, so it must must be a
-         segment. does the appliction provided segment code match? if
-         so then accept the segment */
+      match = NULL;
       
-      if(code && !(mystrcmp(entity->item.code, code)))
-	goto accept_segment;
+      if(code)
+	{
+	  key.block = iterator->block;
+	  key.code = code;
+	  
+	  for(match = (edi_gstep_t *) edi_hash_fetch(&(program->index), &key);
+	      match && match < step; match = match->same)
+	    ;
+	}
       
-      /* no. if the segment was mandatory and we have not already
-	 matched minimum count (FIXME - i'm assuming it's always a
-	 minimum of 1 here), then we have an error */
+      if(match && match <= program->step + step->stop)
+	{
+	  iterator->step = match - program->step;
+	  goto accept_step;
+	}
       
-      if(entity->item.reqr && !iterator->reps)
-        {
-          error = EDI_EREQUIRED;
-          goto reject_segment;
-        }
+      /* the steps in between were optional, and have been passed */
       
-      /* ok, it wasn't mandatory, so just update the iterator to point */
-      /* to the next loop/segment and start the process again */
+      iterator->step = step->stop;
       
-      iterator->reps = 0;
-      iterator->node = iterator->node->next;
+      if(iterator->step < last)
+	{
+	  error = program->step[iterator->step].error;
+	  goto reject_segment;
+	}
     }
   
   /* We have fallen off the bottom of the stack - this is an error,
@@ -718,13 +866,41 @@ static edi_error_t iterate_transaction
   error = EDI_ECORRUPT;
   
  reject_segment:
-  /*fprintf(stderr, "--- %s\n", code);*/
   if(segment)
     segment (userdata, &parameters, directory);
   return error;
   
- accept_segment:
-  /*fprintf(stderr, "+++ %s %s\n", code, entity->item.desc);*/
+ accept_step:
+  step = program->step + iterator->step;
+  entity = step->item;
+  
+  /* a loop starts with its first segment, which has been matched */
+  
+  if(entity->item.type)
+    {
+      if(cursor->depth == cursor->blck)
+	{
+	  error = EDI_EBADTSG;
+	  goto reject_segment;
+	}
+      
+      iterator = cursor->stack + cursor->depth++;
+      iterator->block = step->body;
+      iterator->step = program->block[step->body].first;
+      iterator->reps = 0;
+      
+      if(start)
+	{
+	  edi_parameters_set(&parameters, LastParameter);
+	  edi_parameters_set_one(&parameters, Code, entity->item.code);
+	  edi_parameters_set_one(&parameters, Name, entity->item.name);
+	  edi_parameters_set_one(&parameters, Desc, entity->item.desc);
+	  edi_parameters_set_one(&parameters, Note, entity->item.note);
+	  start (userdata, EDI_LOOP, &parameters);
+	}
+      
+      entity = program->step[iterator->step].item;
+    }
   
   edi_parameters_set(&parameters, LastParameter);
   edi_parameters_set_one(&parameters, Code, entity->item.code);
@@ -823,9 +999,20 @@ edi_directory_t *edi_giovanni_create(void)
   /* quick and dirty way to initialise all the data structures */
   memset(giovanni, 0, sizeof(edi_giovanni_t));
   
+  /* the indexes grow as the directory is built */
+  if(!edi_hash_init(&(giovanni->elements), 61, cmpfn, x31_hash) ||
+     !edi_hash_init(&(giovanni->segments), 61, cmpfn, x31_hash) ||
+     !edi_hash_init(&(giovanni->composites), 61, cmpfn, x31_hash) ||
+     !edi_hash_init(&(giovanni->codelists), 61, value_cmp, value_hash))
+    {
+      giovanni_free((edi_directory_t *) giovanni);
+      return NULL;
+    }
+  
   directory = (edi_directory_t *) giovanni;
   
-  /* not strictly necessary as directory == giovanni */
+  /* directory == giovanni, but the lookups go through user_data so
+     that cursors can share the data */
   directory->user_data = giovanni;
   
   /* set all the function pointers in the edi_directory_t struct to
@@ -865,6 +1052,7 @@ edi_directory_t *edi_giovanni_create(void)
   directory->end = end_transaction;
 
   directory->free = giovanni_free;
+  directory->cursor = cursor_create;
   
   return directory;
 }
@@ -1021,6 +1209,7 @@ void edi_giovanni_start(void *data, const char *el, const char **attr)
   int type;
   edi_gitem_t *gitem;
   edi_list_t *list = NULL;
+  edi_hash_t *hash = NULL;
   edi_giovanni_t *tsg = (edi_giovanni_t *) data;
   
   if((type = tsg_elemtype(el)) == MY_UNKNOWN)
@@ -1042,15 +1231,15 @@ void edi_giovanni_start(void *data, const char *el, const char **attr)
   switch(type)
     {
     case MY_SEGMENT:
-      list = &(tsg->segments);
+      hash = &(tsg->segments);
       tsg->current = gitem;
       break;
     case MY_COMPOSITE:
-      list = &(tsg->composites);
+      hash = &(tsg->composites);
       tsg->current = gitem;
       break;
     case MY_ELEMENT:
-      list = &(tsg->elements);
+      hash = &(tsg->elements);
       tsg->current = gitem;
       break;
     case MY_TRANSACTION:
@@ -1069,9 +1258,18 @@ void edi_giovanni_start(void *data, const char *el, const char **attr)
       tsg->current = (edi_gitem_t *)
 	edi_giovanni_find_element((edi_directory_t *) tsg, gitem->item.code);
       break;
+    case MY_VALUE:
+      /* a codelist value - the current item is its element */
+      if(tsg->current)
+	{
+	  gitem->parent = tsg->current;
+	  if(gitem->item.code)
+	    index_gitem(&(tsg->codelists), gitem, gitem);
+	}
+      list = tsg->current ? &(tsg->current->list) : NULL;
+      break;
     case MY_COMPONENT:
     case MY_ELEMREF:
-    case MY_VALUE:
     case MY_SEGREF:
       list = tsg->current ? &(tsg->current->list) : NULL;
       break;
@@ -1082,16 +1280,26 @@ void edi_giovanni_start(void *data, const char *el, const char **attr)
   
   if(list)
     edi_list_push_key(list, gitem->item.code, gitem);
+  
+  if(hash && gitem->item.code)
+    index_gitem(hash, gitem->item.code, gitem);
 }
 
 
 void edi_giovanni_end(void *data, const char *el)
 {
   edi_giovanni_t *tsg = (edi_giovanni_t *) data;
+  edi_gitem_t *gitem;
   
   switch(tsg_elemtype(el))
     {
     case MY_TRANSACTION:
+      /* the rules are complete, so they can be compiled */
+      if((gitem = (edi_gitem_t *) edi_stack_pop (&(tsg->stack))) &&
+	 !gitem->program)
+	gitem->program = program_compile(gitem);
+      tsg->current = edi_stack_peek(&(tsg->stack));
+      break;
     case MY_LOOP:
       edi_stack_pop (&(tsg->stack));
       tsg->current = edi_stack_peek(&(tsg->stack));
@@ -22,33 +22,96 @@
 
 
 
-typedef struct {
+typedef struct edi_gitem_s {
   /* edi_item_t must be first member because of interchangable pointers */
   edi_item_t item;
   edi_list_t list;
+  /* for a codelist value, the element it belongs to */
+  struct edi_gitem_s *parent;
+  /* for a transaction, its rules compiled once it has been read */
+  struct edi_gprogram_s *program;
 } edi_gitem_t;
 
 
+/* A transaction's rules are compiled into a block of steps for the
+   transaction and for each loop, one step per segment or loop in the
+   order they appear. Each step knows the first step at or after it
+   which a segment cannot be skipped past (a mandatory segment or
+   loop), and the next step in its block which the same segment code
+   would select; so finding where a segment belongs doesn't mean
+   walking each optional sibling in turn. */
+
+typedef struct edi_gstep_s {
+  edi_gitem_t *item;
+  /* the segment code which selects this step - a loop's is that of
+     its first segment - or NULL if it can't be selected */
+  char *code;
+  unsigned int block;
+  /* the block of a loop's contents, else 0 */
+  unsigned int body;
+  /* the step which a segment can't be skipped past and the error if
+     it is not that segment, or the end of the block */
+  unsigned int stop;
+  edi_error_t error;
+  /* the next step in this block with the same code */
+  struct edi_gstep_s *same;
+} edi_gstep_t;
+
+typedef struct {
+  unsigned int first;
+  unsigned int count;
+} edi_gblock_t;
+
+typedef struct edi_gprogram_s {
+  edi_gblock_t *block;
+  edi_gstep_t *step;
+  unsigned int blocks, steps;
+  /* deepest nesting of loops, counting the transaction itself */
+  unsigned int depth;
+  /* first step of each code within a block */
+  edi_hash_t index;
+} edi_gprogram_t;
+
+/* position in a block, and times the step there has been matched */
 typedef struct {
-  edi_node_t *node;
+  unsigned int block;
+  unsigned int step;
   unsigned int reps;
 } edi_giterator_t;
 
-/* edi_directory_t is the first member of edi_giovanni_t. This is done
-   for convenience so that we can use the pointers interchangeably and
-   so we don't have to malloc another structure. */
+/* The state of a walk through a transaction. Each parser has its own
+   cursor, made by edi_directory_cursor(), so that the directory
+   itself is only read while parsing and can be shared between
+   parsers (and threads). The cursor's user_data points to the
+   edi_giovanni_t, which also has a cursor of its own for callers who
+   use the directory directly. */
 
 typedef struct {
   edi_directory_t directory;
-  edi_list_t segments;
-  edi_list_t composites;
-  edi_list_t elements;
+  edi_gprogram_t *program;
+  /* one iterator per level of loop, allocated for the deepest */
+  edi_giterator_t *stack;
+  unsigned int depth, blck;
+  int transaction;
+} edi_gcursor_t;
+
+/* edi_gcursor_t is the first member of edi_giovanni_t, and so
+   edi_directory_t is too. This is done for convenience so that we can
+   use the pointers interchangeably and so we don't have to malloc
+   another structure. */
+
+typedef struct {
+  edi_gcursor_t cursor;
+  /* indexes by code, and codelist values by element and code */
+  edi_hash_t segments;
+  edi_hash_t composites;
+  edi_hash_t elements;
+  edi_hash_t codelists;
   edi_list_t transactions;
   edi_list_t everything;
+  /* only used while the directory is being built */
   edi_stack_t stack;
   edi_gitem_t *current;
-  edi_error_t error;
-  int transaction;
 } edi_giovanni_t;
 
 
@@ -60,3 +123,4 @@ edi_item_t *edi_giovanni_find_segment(edi_directory_t *, char *);
 edi_item_t *edi_giovanni_find_codelist(edi_directory_t *, char *, char *);
 edi_directory_t *edi_giovanni_create(void);
 void edi_giovanni_free(edi_directory_t *);
+edi_giovanni_t *edi_giovanni_data(edi_directory_t *);
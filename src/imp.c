@@ -319,6 +319,14 @@ edi_imp_segment (edi_parser_t *SELF)
 }
 
 
+static void
+imp_reset (edi_parser_t *SELF)
+{
+  MESSAGE = NULL;
+  memset(self, 0, sizeof(edi_imp_t)); /* mitigate bugs */
+}
+
+
 static void
 imp_fini (edi_parser_t *SELF)
 {
@@ -328,13 +336,14 @@ imp_fini (edi_parser_t *SELF)
 edi_error_t
 edi_imp_init (edi_parser_t *SELF)
 {
-  memset(self, 0, sizeof(edi_imp_t)); /* mitigate bugs */
-  
   SERVICE = IMP();
   MESSAGE = NULL;
   
   SELF->syntax_fini = imp_fini;
+  SELF->syntax_reset = imp_reset;
   SELF->sgmnt_handler = edi_imp_segment;
+
+  imp_reset (SELF);
        
   return EDI_ENONE;
 }
@@ -433,7 +442,11 @@ static edi_francesco_codelst_info_t codelistinfo[] = {
 
 static edi_directory_t *IMP(void)
 {
-  return edi_francesco_create(elementinfo,
+  /* created once, and shared by every parser */
+  static edi_directory_t *shared = NULL;
+
+  return edi_francesco_shared(&shared,
+			      elementinfo,
 			      compositeinfo,
 			      segmentinfo,
 			      compositecontents,
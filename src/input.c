@@ -0,0 +1,339 @@
+/*
+
+  The MEDICI Electronic Data Interchange Library
+  Copyright (C) 2002  David Coles
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define EDI_INPUT_MMAP
+#endif
+
+#include "internal.h"
+
+/** \file input.c
+
+    \brief Feeds files to parsers.
+
+    Regular files are mapped and parsed in place, so that the views
+    the tokeniser hands out of the parsed buffer point straight into
+    the page cache and an element is only ever copied if it is split
+    by the end of a slice or holds release characters. Pipes, and
+    anything else which can't be mapped, are read in chunks instead.
+
+*/
+
+/**
+   \defgroup edi_input edi_input
+   \{
+*/
+
+#ifdef EDI_INPUT_MMAP
+/* maps a regular file, returning zero if it isn't one or can't be */
+static int edi_input_map (edi_input_t *self, int fd)
+{
+  struct stat st;
+  void *ptr;
+
+  if (fstat (fd, &st) || !S_ISREG (st.st_mode) || st.st_size <= 0 ||
+      (off_t) (size_t) st.st_size != st.st_size ||
+      (off_t) (unsigned long) st.st_size != st.st_size)
+    return 0;
+
+  if ((ptr = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0)) ==
+      MAP_FAILED)
+    return 0;
+
+#if defined(MADV_SEQUENTIAL)
+  /* the file is read once, front to back */
+  madvise (ptr, st.st_size, MADV_SEQUENTIAL);
+#endif
+
+  self->data = (char *) ptr;
+  self->size = st.st_size;
+  self->mapped = 1;
+  return 1;
+}
+#endif
+
+/* maps the file (standard input if path is NULL) if it can, or else
+   opens it as a stream, returning zero on failure */
+static int edi_input_open (edi_input_t *self, const char *path,
+			   FILE **stream)
+{
+#ifdef EDI_INPUT_MMAP
+  int fd;
+#endif
+
+  memset (self, 0, sizeof (edi_input_t));
+  *stream = NULL;
+
+#ifdef EDI_INPUT_MMAP
+  if ((fd = path ? open (path, O_RDONLY) : dup (STDIN_FILENO)) < 0)
+    return 0;
+
+  if (edi_input_map (self, fd))
+    {
+      close (fd);
+      return 1;
+    }
+
+  if (!(*stream = fdopen (fd, "rb")))
+    {
+      close (fd);
+      return 0;
+    }
+#else
+  if (!(*stream = path ? fopen (path, "rb") : stdin))
+    return 0;
+#endif
+
+  return 1;
+}
+
+static void edi_input_close (FILE *stream)
+{
+  if (stream != stdin)
+    fclose (stream);
+}
+
+/* reads the rest of a stream into memory */
+static int edi_input_read (edi_input_t *self, FILE *stream)
+{
+  unsigned long size = 0, n;
+  char *data;
+
+  do
+    {
+      if (self->size == size)
+	{
+	  size = size ? size * 2 : EDI_INPUT_CHUNK;
+
+	  if (!(data = realloc (self->data, size)))
+	    return 0;
+
+	  self->data = data;
+	}
+
+      n = fread (self->data + self->size, 1, size - self->size, stream);
+      self->size += n;
+    }
+  while (n);
+
+  return !ferror (stream);
+}
+
+/**
+   \brief Maps, or reads in, the whole of a file.
+   \param self Pointer to the structure to be filled in.
+   \param path Name of the file, or NULL for standard input.
+   \return Non-zero on success.
+
+   The data must not be written to, and is released with
+   edi_input_unload().
+*/
+int
+edi_input_load (edi_input_t *self, const char *path)
+{
+  FILE *stream;
+  int ok;
+
+  if (!edi_input_open (self, path, &stream))
+    return 0;
+
+  if (!stream)
+    return 1;
+
+  ok = edi_input_read (self, stream);
+  edi_input_close (stream);
+
+  if (!ok)
+    edi_input_unload (self);
+
+  return ok;
+}
+
+/**
+   \brief Releases a file loaded by edi_input_load().
+   \param self Pointer to the structure filled in by edi_input_load().
+*/
+void
+edi_input_unload (edi_input_t *self)
+{
+#ifdef EDI_INPUT_MMAP
+  if (self->mapped)
+    munmap ((void *) self->data, self->size);
+  else
+#endif
+    free (self->data);
+
+  self->data = NULL;
+  self->size = 0;
+  self->mapped = 0;
+}
+
+/* parses a piece of the stream, starting the parser afresh whenever
+   another interchange follows one which has been completed */
+void
+edi_input_feed (edi_parser_t *parser, char *buffer, unsigned long size)
+{
+  long n;
+
+  while (size && !parser->error)
+    {
+      if (edi_parser_is_complete (parser))
+	{
+	  /* as edi_interchange_scan(), the line ends (say) after the
+	     trailer may run on into the next piece */
+	  n = edi_interchange_skip (buffer, size);
+	  buffer += n;
+	  size -= n;
+
+	  if (!size)
+	    break;
+
+	  edi_parser_reset (parser);
+	}
+
+      n = edi_parser_parse_views (parser, buffer, size < EDI_INPUT_SLICE ?
+				  size : EDI_INPUT_SLICE, 0);
+      if (n <= 0)
+	break;
+
+      buffer += n;
+      size -= n;
+    }
+
+  /* the segment may still be looking at the buffer */
+  edi_parser_detach (parser);
+}
+
+/* a stream which stops part way through an interchange is truncated */
+void
+edi_input_finish (edi_parser_t *parser)
+{
+  if (!parser->error && parser->segment_count &&
+      !edi_parser_is_complete (parser))
+    edi_parser_raise_error (parser, EDI_EEOF);
+}
+
+/**
+   \brief Parses the interchanges in a buffer holding a whole stream.
+   \param parser Pointer to the parser.
+   \param buffer The stream, which is not modified.
+   \param size Length of the stream.
+   \return The error which stopped the parser, if any.
+
+   As edi_parser_parse_file(), but for a stream already in memory.
+*/
+edi_error_t
+edi_input_parse (edi_parser_t *parser, char *buffer, unsigned long size)
+{
+  edi_input_feed (parser, buffer, size);
+  edi_input_finish (parser);
+
+  return parser->error;
+}
+
+/**
+   \brief Parses the interchanges in a file.
+   \param parser Pointer to the parser.
+   \param path Name of the file, or NULL for standard input.
+   \param compression How the file is compressed, if at all.
+   \return Non-zero on success. On failure the parser's error code is
+   set, unless the file couldn't be opened or read (see errno).
+
+   The parser is reset between interchanges, and the last is left in
+   it, as complete or not, once the file has been parsed. A file which
+   ends part way through an interchange raises EDI_EEOF. A compressed
+   file is decompressed as it is parsed (see edi_input_filter_parse()).
+*/
+int
+edi_parser_parse_file (edi_parser_t *parser, const char *path,
+		       edi_compression_t compression)
+{
+  edi_input_filter_t *filter = NULL;
+  edi_input_t input;
+  FILE *stream;
+  char *buffer;
+  unsigned long n;
+  int ok = 1;
+
+  if (compression != EDI_COMPRESSION_NONE &&
+      !(filter = edi_input_filter_create (compression)))
+    {
+      edi_parser_raise_error (parser, EDI_EREAD);
+      return 0;
+    }
+
+  if (!edi_input_open (&input, path, &stream))
+    {
+      edi_input_filter_free (filter);
+      return 0;
+    }
+
+  if (!stream)
+    {
+      if (filter)
+	edi_input_filter_parse (filter, parser, input.data, input.size, 1);
+      else
+	edi_input_feed (parser, input.data, input.size);
+
+      edi_input_unload (&input);
+    }
+  else if ((buffer = malloc (EDI_INPUT_CHUNK)))
+    {
+      while (!parser->error &&
+	     (n = fread (buffer, 1, EDI_INPUT_CHUNK, stream)) > 0)
+	if (filter)
+	  edi_input_filter_parse (filter, parser, buffer, n, 0);
+	else
+	  edi_input_feed (parser, buffer, n);
+
+      ok = !ferror (stream);
+
+      if (ok && filter)
+	edi_input_filter_parse (filter, parser, NULL, 0, 1);
+
+      free (buffer);
+      edi_input_close (stream);
+    }
+  else
+    {
+      edi_input_close (stream);
+      edi_input_filter_free (filter);
+      return 0;
+    }
+
+  edi_input_filter_free (filter);
+
+  if (ok)
+    edi_input_finish (parser);
+
+  return ok && !parser->error;
+}
+
+/** \} */
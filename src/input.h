@@ -0,0 +1,51 @@
+/*
+
+  The MEDICI Electronic Data Interchange Library
+  Copyright (C) 2002  David Coles
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+#ifndef INPUT_H
+#define INPUT_H
+
+/* largest piece of a mapped file given to the tokeniser at once, as
+   it counts what it is given in an unsigned int */
+#define EDI_INPUT_SLICE 0x40000000UL
+
+/* size of the chunks read from files which can't be mapped */
+#define EDI_INPUT_CHUNK 65536
+
+/** \brief The whole of a file, mapped or read into memory */
+typedef struct
+{
+  char *data;
+  unsigned long size;
+
+  /** \brief Non-zero if data is mapped rather than allocated */
+  int mapped;
+}
+edi_input_t;
+
+/* input.c */
+int edi_input_load(edi_input_t *, const char *);
+void edi_input_unload(edi_input_t *);
+void edi_input_feed(edi_parser_t *, char *, unsigned long);
+void edi_input_finish(edi_parser_t *);
+edi_error_t edi_input_parse(edi_parser_t *, char *, unsigned long);
+int edi_parser_parse_file(edi_parser_t *, const char *, edi_compression_t);
+
+#endif /*INPUT_H*/
@@ -29,6 +29,7 @@ extern "C" {
 #include "ascii.h"
 #include "adt.h"
 #include "fsa.h"
+#include "lock.h"
 
 #include "common.h"
 
@@ -36,6 +37,7 @@ extern "C" {
 #include "prmtrs.h"
 #include "segment.h"
 #include "drctry.h"
+#include "cache.h"
 
 #include "edifact.h"
 #include "ungtdi.h"
@@ -43,6 +45,13 @@ extern "C" {
 #include "imp.h"
 
 #include "parser.h"
+#include "pipeline.h"
+#include "reader.h"
+#include "pool.h"
+#include "parallel.h"
+#include "input.h"
+#include "filter.h"
+#include "batch.h"
 
 #ifdef __cplusplus
 }
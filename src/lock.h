@@ -0,0 +1,48 @@
+/*
+
+  The MEDICI Electronic Data Interchange Library
+  Copyright (C) 2002  David Coles
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+#ifndef LOCK_H
+#define LOCK_H
+
+/* the lock guarding anything which the library lets threads share -
+   the parser pool, the directory cache and so on. These are
+   documented as safe to share, so the library won't build without
+   one rather than quietly leaving them unguarded */
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <pthread.h>
+typedef pthread_mutex_t edi_lock_t;
+#define EDI_LOCK_INITIALIZER PTHREAD_MUTEX_INITIALIZER
+#define edi_lock_init(l) pthread_mutex_init ((l), NULL)
+#define edi_lock_destroy(l) pthread_mutex_destroy (l)
+#define edi_lock(l) pthread_mutex_lock (l)
+#define edi_unlock(l) pthread_mutex_unlock (l)
+typedef pthread_cond_t edi_cond_t;
+#define edi_cond_init(c) pthread_cond_init ((c), NULL)
+#define edi_cond_destroy(c) pthread_cond_destroy (c)
+#define edi_cond_wait(c,l) pthread_cond_wait ((c), (l))
+#define edi_cond_signal(c) pthread_cond_signal (c)
+#define edi_cond_broadcast(c) pthread_cond_broadcast (c)
+#else
+#error "a pthread mutex is needed to guard structures shared between threads"
+#endif
+
+#endif /*LOCK_H*/
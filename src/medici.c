@@ -25,6 +25,7 @@
 
 #include "internal.h"
 #include "medici.h"
+#include "cosimo.h"
 
 /** \file medici.c
 
@@ -66,6 +67,37 @@ EDI_SetPragma (EDI_Parser p, EDI_Pragma pragma)
   return (old);
 }
 
+/**
+   \brief Select how runs of element data are found.
+   \return The previously selected method.
+
+   The default, EDI_SCAN_AVX2, uses the widest vector instructions
+   available on the processor. EDI_SCAN_NONE passes every character
+   through the tokeniser's state machine and produces identical output.
+*/
+EDI_Scan
+EDI_SetScan (EDI_Parser p, EDI_Scan scan)
+{
+  return edi_parser_set_scan ((edi_parser_t *) p, scan);
+}
+
+/**
+   \brief Parse on two threads - tokenising on the calling thread and
+   doing everything else, including calling the handlers, on another.
+   \return Zero if a pipeline couldn't be set up.
+
+   Only worthwhile for large chunks of a stream, such as those which
+   EDI_ParseFile() gives the parser, and particularly when segments
+   are being checked against a TSG; smaller chunks are parsed on the
+   calling thread as usual. The handlers are called one at a time and
+   in order, and the output is identical.
+*/
+int
+EDI_SetPipeline (EDI_Parser p, int pipeline)
+{
+  return edi_parser_set_pipeline ((edi_parser_t *) p, pipeline);
+}
+
 /**
    \brief Set handler for start of structural elements.
    \return Pointer to previously set handler.
@@ -168,6 +200,51 @@ EDI_Parse (EDI_Parser p, char *buffer, long length, int done)
   return edi_parser_parse((edi_parser_t *) p, buffer, length, done);
 }
 
+/* parses a file (standard input if path is NULL) from a mapping of it
+   where possible, resetting the parser between interchanges, and
+   returns zero on failure - if the error code isn't set then the file
+   couldn't be read */
+int
+EDI_ParseFile (EDI_Parser p, const char *path)
+{
+  return edi_parser_parse_file ((edi_parser_t *) p, path,
+				EDI_COMPRESSION_NONE);
+}
+
+/* as EDI_ParseFile, but decompressing the file as it goes - fails with
+   EDI_EREAD if support for the compression wasn't built in */
+int
+EDI_ParseFileFiltered (EDI_Parser p, const char *path,
+		       EDI_Compression compression)
+{
+  return edi_parser_parse_file ((edi_parser_t *) p, path, compression);
+}
+
+/* a decompressor for one stream which is to be handed to
+   EDI_ParseFiltered in chunks, or NULL if the compression isn't
+   supported */
+EDI_InputFilter
+EDI_InputFilterCreate (EDI_Compression compression)
+{
+  return (EDI_InputFilter) edi_input_filter_create (compression);
+}
+
+void
+EDI_InputFilterFree (EDI_InputFilter f)
+{
+  edi_input_filter_free ((edi_input_filter_t *) f);
+}
+
+/* parses a chunk of a compressed stream, with done set for the last,
+   resetting the parser between interchanges; returns zero on error */
+int
+EDI_ParseFiltered (EDI_Parser p, EDI_InputFilter f, char *buffer,
+		   unsigned long length, int done)
+{
+  return edi_input_filter_parse ((edi_input_filter_t *) f,
+				 (edi_parser_t *) p, buffer, length, done);
+}
+
 int
 EDI_GetErrorCode (EDI_Parser p)
 {
@@ -232,11 +309,66 @@ EDI_GetElement (EDI_Segment s, int x, int y)
   return edi_segment_get_element ((edi_segment_t *) s, x, y);
 }
 
+int
+EDI_GetElementView (EDI_Segment s, int x, int y, EDI_ElementView *view)
+{
+  return edi_segment_get_view ((edi_segment_t *) s, x, y,
+			       (edi_element_view_t *) view);
+}
+
+/* the value of an element view - the view's own, unterminated, data if
+   it has no release indicators, else an unescaped, terminated copy in
+   buffer (NULL if that is too small) */
+const char *
+EDI_UnescapeElement (const EDI_ElementView *view, char *buffer,
+		     unsigned long size, unsigned long *length)
+{
+  unsigned long n;
+
+  if (!view->release)
+    {
+      if (length)
+	*length = view->size;
+      return view->data;
+    }
+
+  /* the value is never longer than its escaped form */
+  if (!buffer || size <= view->size)
+    return NULL;
+
+  n = edi_segment_unescape (buffer, view->data, view->size, view->release);
+  buffer[n] = '\0';
+
+  if (length)
+    *length = n;
+  return buffer;
+}
+
 unsigned long EDI_GetCurrentByteIndex (EDI_Parser p)
 {
   return edi_parser_get_byte_index ((edi_parser_t *) p);
 }
 
+EDI_Offset EDI_GetCurrentByteOffset (EDI_Parser p)
+{
+  return edi_parser_get_byte_index ((edi_parser_t *) p);
+}
+
+unsigned long EDI_GetAllocationCount (EDI_Parser p)
+{
+  return edi_parser_get_allocation_count ((edi_parser_t *) p);
+}
+
+unsigned long EDI_GetBufferHighWater (EDI_Parser p)
+{
+  return edi_parser_get_high_water ((edi_parser_t *) p);
+}
+
+int EDI_ReserveBuffers (EDI_Parser p, unsigned long size)
+{
+  return edi_parser_reserve ((edi_parser_t *) p, size);
+}
+
 char *EDI_GetParameterString (EDI_Parameter p)
 {
   return (char *) edi_parameters_get_string(p);
@@ -414,6 +546,20 @@ void EDI_DirectoryFree(EDI_Directory d)
   edi_directory_free((edi_directory_t *) d);
 }
 
+/* a directory compiled by EDI_DirectoryCompile(), mapped read-only;
+   NULL if the file is missing or not a valid image */
+EDI_Directory EDI_DirectoryMap(const char *path)
+{
+  return edi_cosimo_map(path);
+}
+
+/* writes a directory loaded from a TSG file as an image for
+   EDI_DirectoryMap(), returning non-zero on success */
+int EDI_DirectoryCompile(EDI_Directory d, const char *path)
+{
+  return edi_cosimo_compile((edi_directory_t *) d, path);
+}
+
 
 EDI_Directory
 EDI_GetServiceDirectory(EDI_Parser p)
@@ -434,4 +580,182 @@ EDI_CompositeItem (EDI_Directory d, char *code, unsigned int n)
 }
 
 
+/* the pull interface - see reader.c */
+
+EDI_Reader
+EDI_ReaderCreate (char *data, long size)
+{
+  return edi_reader_create (data, size);
+}
+
+EDI_Reader
+EDI_ReaderCreateStream (EDI_ReadHandler input, void *user)
+{
+  return edi_reader_create_input ((edi_reader_input_t) input, user);
+}
+
+void
+EDI_ReaderFree (EDI_Reader r)
+{
+  edi_reader_free ((edi_reader_t *) r);
+}
+
+EDI_ReaderEvent *
+EDI_NextEvent (EDI_Reader r)
+{
+  return (EDI_ReaderEvent *) edi_reader_next ((edi_reader_t *) r);
+}
+
+int
+EDI_ReaderGetErrorCode (EDI_Reader r)
+{
+  return edi_reader_error ((edi_reader_t *) r);
+}
+
+/* for setting pragmas etc. - the handlers belong to the reader */
+EDI_Parser
+EDI_ReaderGetParser (EDI_Reader r)
+{
+  return &(((edi_reader_t *) r)->parser);
+}
+
+void
+EDI_ReaderSetDirectoryHandler (EDI_Reader r, EDI_DirectoryHandler h,
+			       void *user)
+{
+  edi_reader_set_directory_handler ((edi_reader_t *) r,
+				    (edi_directory_handler_t) h, user);
+}
+
+
+/* parser pools - see pool.c */
+
+EDI_ParserPool
+EDI_ParserPoolCreate (unsigned int size)
+{
+  return edi_parser_pool_create (size);
+}
+
+void
+EDI_ParserPoolFree (EDI_ParserPool pool)
+{
+  edi_parser_pool_free ((edi_parser_pool_t *) pool);
+}
+
+EDI_Parser
+EDI_ParserPoolGet (EDI_ParserPool pool)
+{
+  return edi_parser_pool_get ((edi_parser_pool_t *) pool);
+}
+
+void
+EDI_ParserPoolPut (EDI_ParserPool pool, EDI_Parser p)
+{
+  edi_parser_pool_put ((edi_parser_pool_t *) pool, (edi_parser_t *) p);
+}
+
+
+/* directory caches - see cache.c */
+
+EDI_DirectoryCache
+EDI_DirectoryCacheCreate (EDI_DirectoryLoader loader, void *user,
+			  unsigned long budget)
+{
+  return edi_directory_cache_create ((edi_directory_loader_t) loader,
+				     user, budget);
+}
+
+void
+EDI_DirectoryCacheFree (EDI_DirectoryCache cache)
+{
+  edi_directory_cache_free ((edi_directory_cache_t *) cache);
+}
+
+/* messages which the directory handler (if any) returns no directory
+   for get one from the cache, which may be shared between parsers */
+void
+EDI_SetDirectoryCache (EDI_Parser p, EDI_DirectoryCache cache)
+{
+  edi_parser_set_directory_cache ((edi_parser_t *) p,
+				  (edi_directory_cache_t *) cache);
+}
+
+
+/* parallel parsing - see parallel.c */
+
+static void
+edi_parallel_handlers (edi_parallel_handlers_t *h, EDI_ParallelHandlers *p)
+{
+  h->start = (edi_interchange_start_t) p->start;
+  h->end = (edi_interchange_end_t) p->end;
+  h->user_data = p->user;
+  h->ordered = p->ordered;
+}
+
+/* parses the concatenated interchanges of a file on the given number
+   of threads (zero for one per processor), returning the number of
+   interchanges or -1 if the file couldn't be read */
+long
+EDI_ParseParallel (const char *path, unsigned int threads,
+		   EDI_ParallelHandlers *handlers)
+{
+  edi_parallel_handlers_t h;
+
+  edi_parallel_handlers (&h, handlers);
+  return edi_parallel_parse_file (path, threads, &h);
+}
+
+long
+EDI_ParseParallelBuffer (char *buffer, unsigned long size,
+			 unsigned int threads, EDI_ParallelHandlers *handlers)
+{
+  edi_parallel_handlers_t h;
+
+  edi_parallel_handlers (&h, handlers);
+  return edi_parallel_parse (buffer, size, threads, &h);
+}
+
+/* parses the envelopes of the interchanges in a buffer with the given
+   parser, and their messages on several threads, returning the number
+   of messages or -1 on failure */
+long
+EDI_ParseMessagesParallel (EDI_Parser p, char *buffer, unsigned long size,
+			   unsigned int threads,
+			   EDI_ParallelHandlers *handlers)
+{
+  edi_parallel_handlers_t h;
+
+  edi_parallel_handlers (&h, handlers);
+  return edi_parallel_parse_messages ((edi_parser_t *) p, buffer, size,
+				      threads, &h);
+}
+
+/* reads the files named in a batch, keeping up to depth of them in
+   flight (zero for the default), and parses them on the given number
+   of threads with parsers from the pool, or from one of its own if
+   the pool is NULL; returns the number of files or -1 on failure */
+long
+EDI_ParseBatch (EDI_ParserPool pool, const char **path, unsigned long count,
+		unsigned int threads, unsigned int depth,
+		EDI_ParallelHandlers *handlers, EDI_BatchStats *stats)
+{
+  edi_parallel_handlers_t h;
+  edi_batch_stats_t s;
+  long n;
+
+  edi_parallel_handlers (&h, handlers);
+  n = edi_batch_parse ((edi_parser_pool_t *) pool, path, count, threads,
+		       depth, &h, &s);
+
+  if (stats)
+    {
+      stats->files = s.files;
+      stats->failed = s.failed;
+      stats->bytes = s.bytes;
+    }
+
+  return n;
+}
+
+
 /** \} */
@@ -37,11 +37,18 @@ extern "C" {
   typedef void *EDI_Parser;
   typedef void *EDI_Segment;
   typedef void *EDI_Token;
+  typedef void *EDI_Reader;
+  typedef void *EDI_ParserPool;
+  typedef void *EDI_DirectoryCache;
+  typedef void *EDI_InputFilter;
   
   typedef edi_event_t EDI_Event;
   typedef edi_pragma_t EDI_Pragma;
+  typedef edi_scan_t EDI_Scan;
   typedef edi_parameter_t EDI_Parameter;
   typedef edi_data_type_t EDI_DataType;
+  typedef edi_offset_t EDI_Offset;
+  typedef edi_compression_t EDI_Compression;
   
   typedef void (*EDI_SeparatorHandler) (void *, edi_event_t, char);
   typedef void (*EDI_ErrorHandler) (void *, int);
@@ -53,6 +60,66 @@ extern "C" {
 				      EDI_Segment, EDI_Directory);
   
   typedef EDI_Directory (*EDI_DirectoryHandler) (void *, EDI_Parameters);
+  typedef EDI_Directory (*EDI_DirectoryLoader) (void *, EDI_Parameters,
+						unsigned long *);
+  typedef long (*EDI_ReadHandler) (void *, char *, long);
+  
+  /* a view of an element's value, valid until the next segment starts
+     or the call to EDI_Parse() returns; if release is non-zero then it
+     escapes characters in data - see EDI_UnescapeElement().
+
+     EDI_UnescapeElement (view, buffer, size, &length) gives the value
+     itself. If the view has no release indicator that is view->data,
+     which is NOT terminated - only length characters of it belong to
+     the value - and buffer isn't touched. Otherwise the value is
+     unescaped into buffer, terminated, and buffer is returned; NULL is
+     returned if buffer is NULL or size isn't more than view->size */
+  typedef struct
+  {
+    const char *data;           /* the characters (not terminated) */
+    unsigned long size;         /* the number of characters */
+    char release;               /* release indicator in data, or 0 */
+  }
+  EDI_ElementView;
+  
+  /* an event pulled from an EDI_Reader - the pointers are only valid
+     until the next call to EDI_NextEvent() */
+  typedef struct
+  {
+    EDI_Event type;             /* EDI_INTERCHANGE ... EDI_ELEMENT */
+    int end;                    /* non-zero at the end of a structure */
+    EDI_Parameters parameters;  /* for the start of a structure */
+    EDI_Segment segment;        /* for segments and elements */
+    EDI_Directory directory;    /* for segments and elements */
+    const char *data;           /* a view of the value of an element, */
+    unsigned long size;         /* as EDI_ElementView */
+    char release;
+    int element, subelement;    /* the position of an element */
+  }
+  EDI_ReaderEvent;
+  
+  /* handlers for EDI_ParseParallel(), EDI_ParseMessagesParallel() and
+     EDI_ParseBatch(): start is called on the parsing thread to set up
+     the parser for the interchange, message or file with the given
+     index, returning data which is passed to end along with the error
+     code, if any, once it has been parsed; end is called in the order
+     of the file (or files) if ordered is non-zero */
+  typedef struct
+  {
+    void *(*start) (void *, EDI_Parser, unsigned long);
+    void (*end) (void *, void *, unsigned long, int);
+    void *user;
+    int ordered;
+  }
+  EDI_ParallelHandlers;
+
+  /* totals for EDI_ParseBatch() */
+  typedef struct
+  {
+    unsigned long files, failed; /* files, and those which couldn't be read */
+    EDI_Offset bytes;            /* bytes read */
+  }
+  EDI_BatchStats;
   
   /* obsolete */
   
@@ -60,6 +127,8 @@ extern "C" {
   EDI_Parser EDI_ParserCreate(void);
   void EDI_ParserReset(EDI_Parser);
   EDI_Pragma EDI_SetPragma(EDI_Parser, EDI_Pragma);
+  EDI_Scan EDI_SetScan(EDI_Parser, EDI_Scan);
+  int EDI_SetPipeline(EDI_Parser, int);
   EDI_StartHandler EDI_SetStartHandler(EDI_Parser, EDI_StartHandler);
   EDI_EndHandler EDI_SetEndHandler(EDI_Parser, EDI_EndHandler);
   EDI_ErrorHandler EDI_SetErrorHandler(EDI_Parser, EDI_ErrorHandler);
@@ -72,6 +141,12 @@ extern "C" {
   EDI_SeparatorHandler EDI_SetSeparatorHandler(EDI_Parser, EDI_SeparatorHandler);
   void *EDI_SetUserData(EDI_Parser, void *);
   long EDI_Parse(EDI_Parser, char *, long, int);
+  int EDI_ParseFile(EDI_Parser, const char *);
+  int EDI_ParseFileFiltered(EDI_Parser, const char *, EDI_Compression);
+  EDI_InputFilter EDI_InputFilterCreate(EDI_Compression);
+  void EDI_InputFilterFree(EDI_InputFilter);
+  int EDI_ParseFiltered(EDI_Parser, EDI_InputFilter, char *, unsigned long,
+			int);
   int EDI_GetErrorCode(EDI_Parser);
   char *EDI_GetErrorString(int);
   char *EDI_GetEventString(EDI_Event);
@@ -82,7 +157,13 @@ extern "C" {
   int EDI_GetElementCount(EDI_Segment);
   int EDI_GetSubelementCount(EDI_Segment, int);
   char *EDI_GetElement(EDI_Segment, int, int);
+  int EDI_GetElementView(EDI_Segment, int, int, EDI_ElementView *);
+  const char *EDI_UnescapeElement(const EDI_ElementView *, char *, unsigned long, unsigned long *);
   unsigned long EDI_GetCurrentByteIndex(EDI_Parser);
+  EDI_Offset EDI_GetCurrentByteOffset(EDI_Parser);
+  unsigned long EDI_GetAllocationCount(EDI_Parser);
+  unsigned long EDI_GetBufferHighWater(EDI_Parser);
+  int EDI_ReserveBuffers(EDI_Parser, unsigned long);
   char *EDI_GetParameterString(EDI_Parameter);
   char *EDI_GetElementByName(EDI_Directory, EDI_Segment, char *);
   int EDI_EvaluateString(edi_data_type_t, char *, edi_data_type_t, void *);
@@ -108,9 +189,34 @@ extern "C" {
   int EDI_ElementIndex(EDI_Directory, char *, int *, int *);
   char *EDI_GetCodelistValue(EDI_Directory, char *, char *);
   void EDI_DirectoryFree(EDI_Directory);
+  EDI_Directory EDI_DirectoryMap(const char *);
+  int EDI_DirectoryCompile(EDI_Directory, const char *);
   EDI_Directory EDI_GetServiceDirectory(EDI_Parser);
   edi_item_t EDI_SegmentItem(EDI_Directory, char *, unsigned int);
   edi_item_t EDI_CompositeItem(EDI_Directory, char *, unsigned int);
+  EDI_Reader EDI_ReaderCreate(char *, long);
+  EDI_Reader EDI_ReaderCreateStream(EDI_ReadHandler, void *);
+  void EDI_ReaderFree(EDI_Reader);
+  EDI_ReaderEvent *EDI_NextEvent(EDI_Reader);
+  int EDI_ReaderGetErrorCode(EDI_Reader);
+  EDI_Parser EDI_ReaderGetParser(EDI_Reader);
+  void EDI_ReaderSetDirectoryHandler(EDI_Reader, EDI_DirectoryHandler, void *);
+  EDI_ParserPool EDI_ParserPoolCreate(unsigned int);
+  void EDI_ParserPoolFree(EDI_ParserPool);
+  EDI_Parser EDI_ParserPoolGet(EDI_ParserPool);
+  void EDI_ParserPoolPut(EDI_ParserPool, EDI_Parser);
+  EDI_DirectoryCache EDI_DirectoryCacheCreate(EDI_DirectoryLoader, void *,
+					      unsigned long);
+  void EDI_DirectoryCacheFree(EDI_DirectoryCache);
+  void EDI_SetDirectoryCache(EDI_Parser, EDI_DirectoryCache);
+  long EDI_ParseParallel(const char *, unsigned int, EDI_ParallelHandlers *);
+  long EDI_ParseParallelBuffer(char *, unsigned long, unsigned int,
+			       EDI_ParallelHandlers *);
+  long EDI_ParseMessagesParallel(EDI_Parser, char *, unsigned long,
+				 unsigned int, EDI_ParallelHandlers *);
+  long EDI_ParseBatch(EDI_ParserPool, const char **, unsigned long,
+		      unsigned int, unsigned int, EDI_ParallelHandlers *,
+		      EDI_BatchStats *);
 
 #ifdef __cplusplus
 }
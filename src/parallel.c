@@ -0,0 +1,851 @@
+/*
+
+  The MEDICI Electronic Data Interchange Library
+  Copyright (C) 2002  David Coles
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "internal.h"
+
+/** \file parallel.c
+
+    \brief Parses the interchanges, or messages, of a stream on
+    several threads.
+
+    A stream of concatenated interchanges is first scanned for where
+    each one starts and ends - which only needs the separators from
+    the UNA or ISA header, not a parser - and then each thread takes
+    the next interchange not yet claimed and parses it with a parser
+    of its own. Threads which are given short interchanges simply
+    come back for more, so the work balances itself.
+
+    A single large interchange can be split up the same way, by
+    message. The envelope is parsed by the application's parser, and
+    each message by a thread's parser which has first been fed the
+    interchange and group headers, so as to be in the same state as
+    the envelope parser would be at the start of the message. Once the
+    messages are done, the syntax module of the envelope parser is
+    told of them so that the group and interchange control counts can
+    be checked.
+
+    The start handler is called on the parsing thread to set up the
+    parser's handlers for an interchange or message. If the handlers
+    are ordered the end handler for each is called in the order of the
+    stream, and parsing runs no more than a few interchanges or
+    messages per thread ahead of it, so that the application needs
+    only buffer the results of that many.
+
+*/
+
+/**
+   \defgroup edi_parallel edi_parallel
+   \{
+*/
+
+
+#if defined(__GNUC__) && (defined(__unix__) || defined(__APPLE__))
+#define EDI_PARALLEL_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+/* how many interchanges or messages per thread may be parsed ahead of
+   the one waiting for its end handler to be called, when ordered */
+#define EDI_PARALLEL_WINDOW 4
+
+
+/* the separators and service segments of an interchange, enough to
+   find its messages and where it ends */
+typedef struct
+{
+  char st, ri;
+  int has_ri;
+
+  /* the interchange trailer, group header, message header and trailer
+     - a syntax without messages to find has NULL for the last three */
+  const char *trailer, *group, *head, *tail;
+
+  /* offset just after the interchange header segment */
+  unsigned long header;
+}
+edi_parallel_syntax_t;
+
+typedef struct
+{
+  char *buffer;
+  edi_ranges_t ranges;
+  edi_parallel_handlers_t *handlers;
+
+  /* for messages, the start of the interchange whose header (up to
+     ranges.head) the parsers are fed first, and the index in the
+     stream of the first message */
+  unsigned long origin, base;
+
+  /* the next range to be claimed, guarded by the order's lock */
+  unsigned long next;
+
+  edi_parallel_order_t order;
+}
+edi_parallel_t;
+
+typedef struct
+{
+  edi_parallel_t *shared;
+  edi_parser_t *parser;
+#if defined(EDI_PARALLEL_THREADS)
+  pthread_t thread;
+  int started;
+#endif
+}
+edi_parallel_worker_t;
+
+
+static int edi_parallel_space (char c)
+{
+  return c == ASCII_SPACE || c == ASCII_HT || c == ASCII_CR || c == ASCII_LF;
+}
+
+/* segment tags are made of upper case letters and digits */
+static int edi_parallel_tag (char c)
+{
+  return (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+}
+
+/* non-zero if the segment from tag to end has the given tag */
+static int edi_parallel_is
+(const char *buffer, unsigned long tag, unsigned long end, const char *name)
+{
+  unsigned long length;
+
+  if (!name)
+    return 0;
+
+  length = strlen (name);
+
+  return end - tag > length && !memcmp (buffer + tag, name, length) &&
+    !edi_parallel_tag (buffer[tag + length]);
+}
+
+/* finds the next segment at or after i, storing where its tag starts
+   - after any line breaks - and returning the offset just after its
+   terminator, stepping over any character which follows a release
+   indicator */
+static unsigned long edi_parallel_segment
+(edi_parallel_syntax_t *syntax, const char *buffer, unsigned long i,
+ unsigned long size, unsigned long *tag)
+{
+  while (i < size && (buffer[i] == ASCII_CR || buffer[i] == ASCII_LF))
+    i++;
+
+  for (*tag = i; i < size; i++)
+    if (syntax->has_ri && buffer[i] == syntax->ri)
+      i++;
+    else if (buffer[i] == syntax->st)
+      return i + 1;
+
+  return size;
+}
+
+/* works out the syntax of the interchange which starts at pos,
+   returning zero if it isn't known */
+static int edi_parallel_syntax
+(edi_parallel_syntax_t *syntax, const char *buffer, unsigned long pos,
+ unsigned long size)
+{
+  const char *b = buffer + pos;
+  unsigned long left = size - pos, tag;
+
+  memset (syntax, 0, sizeof (edi_parallel_syntax_t));
+
+  if (left < 4)
+    return 0;
+
+  if (!memcmp (b, "UNA", 3) || !memcmp (b, "UNB", 3))
+    {
+      syntax->trailer = "UNZ";
+      syntax->group = "UNG";
+      syntax->head = "UNH";
+      syntax->tail = "UNT";
+
+      if (b[2] == 'A')
+	{
+	  /* UNA:+.? ' - the release indicator is a space if not used */
+	  if (left < 9)
+	    return 0;
+	  syntax->has_ri = b[6] != ASCII_SPACE;
+	  syntax->ri = b[6];
+	  syntax->st = b[8];
+	  pos += 9;
+	}
+      else if (b[3] == ASCII_GS)
+	/* level B syntaxes use information separators and no release */
+	syntax->st = ASCII_FS;
+      else
+	{
+	  syntax->st = ASCII_APOSTROPHE;
+	  syntax->has_ri = 1;
+	  syntax->ri = ASCII_QUESTIONMARK;
+	}
+    }
+  else if (!memcmp (b, "ISA", 3))
+    {
+      /* the ISA segment is of fixed length, ending with the terminator */
+      if (left < 106)
+	return 0;
+      syntax->st = b[105];
+      syntax->trailer = "IEA";
+      syntax->group = "GS";
+      syntax->head = "ST";
+      syntax->tail = "SE";
+      syntax->header = pos + 106;
+      return 1;
+    }
+  else if (!memcmp (b, "STX", 3))
+    {
+      syntax->st = ASCII_APOSTROPHE;
+      syntax->has_ri = 1;
+      syntax->ri = ASCII_QUESTIONMARK;
+      syntax->trailer = "END";
+    }
+  else
+    return 0;
+
+  syntax->header = edi_parallel_segment (syntax, buffer, pos, size, &tag);
+
+  return 1;
+}
+
+/* the offset just after the trailer segment of the interchange which
+   starts at pos, or the size of the buffer if the syntax isn't known
+   or the trailer is missing */
+static unsigned long edi_parallel_interchange_end
+(const char *buffer, unsigned long pos, unsigned long size)
+{
+  edi_parallel_syntax_t syntax;
+  unsigned long i, tag;
+
+  if (!edi_parallel_syntax (&syntax, buffer, pos, size))
+    return size;
+
+  for (i = syntax.header; i < size; )
+    {
+      i = edi_parallel_segment (&syntax, buffer, i, size, &tag);
+
+      if (edi_parallel_is (buffer, tag, i, syntax.trailer))
+	return i;
+    }
+
+  return size;
+}
+
+static int edi_parallel_push
+(edi_ranges_t *ranges, unsigned long offset, unsigned long size,
+ unsigned long group, unsigned long group_size)
+{
+  edi_range_t *range;
+
+  if (ranges->count == ranges->size)
+    {
+      if (!(range = realloc (ranges->range, (ranges->size * 2 + 16) *
+			     sizeof (edi_range_t))))
+	{
+	  free (ranges->range);
+	  ranges->range = NULL;
+	  return 0;
+	}
+
+      ranges->range = range;
+      ranges->size = ranges->size * 2 + 16;
+    }
+
+  range = ranges->range + ranges->count++;
+  range->offset = offset;
+  range->size = size;
+  range->group = group;
+  range->group_size = group_size;
+
+  return 1;
+}
+
+/**
+   \brief Measures the whitespace which may come between interchanges.
+   \param buffer The stream, from the end of an interchange.
+   \param size Length of the stream.
+   \return How many bytes of whitespace the stream starts with.
+*/
+unsigned long
+edi_interchange_skip (const char *buffer, unsigned long size)
+{
+  unsigned long pos = 0;
+
+  while (pos < size && edi_parallel_space (buffer[pos]))
+    pos++;
+
+  return pos;
+}
+
+/**
+   \brief Finds the interchanges in a stream.
+   \param ranges Where to store the offset and size of each.
+   \param buffer The stream.
+   \param size Length of the stream.
+   \return Non-zero on success, zero if memory ran out.
+
+   Whitespace between interchanges is skipped. Anything which is not
+   recognised as an interchange header, and everything after it, is
+   left as one range for the parser to make sense of.
+*/
+int
+edi_interchange_scan (edi_ranges_t *ranges, const char *buffer,
+		      unsigned long size)
+{
+  unsigned long pos = 0, end;
+
+  memset (ranges, 0, sizeof (edi_ranges_t));
+
+  for (;;)
+    {
+      pos += edi_interchange_skip (buffer + pos, size - pos);
+
+      if (pos >= size)
+	return 1;
+
+      end = edi_parallel_interchange_end (buffer, pos, size);
+
+      if (!edi_parallel_push (ranges, pos, end - pos, 0, 0))
+	return 0;
+
+      pos = end;
+    }
+}
+
+/**
+   \brief Finds the messages in an interchange.
+   \param ranges Where to store the offset and size of each, and of
+   the group header each is in.
+   \param buffer The stream.
+   \param offset Where in the stream the interchange starts.
+   \param size Length of the interchange.
+   \return Non-zero on success, zero if memory ran out.
+
+   No messages are found if the syntax isn't known, or doesn't allow
+   for messages to be parsed apart from the envelope.
+*/
+int
+edi_message_scan (edi_ranges_t *ranges, const char *buffer,
+		  unsigned long offset, unsigned long size)
+{
+  edi_parallel_syntax_t syntax;
+  unsigned long i, tag, start = 0, group = 0, group_size = 0;
+  int in = 0;
+
+  memset (ranges, 0, sizeof (edi_ranges_t));
+  size += offset;
+
+  if (!edi_parallel_syntax (&syntax, buffer, offset, size) || !syntax.head)
+    return 1;
+
+  for (i = ranges->head = syntax.header; i < size; )
+    {
+      i = edi_parallel_segment (&syntax, buffer, i, size, &tag);
+
+      if (edi_parallel_is (buffer, tag, i, syntax.group))
+	{
+	  group = tag;
+	  group_size = i - tag;
+	}
+      else if (edi_parallel_is (buffer, tag, i, syntax.head))
+	{
+	  start = tag;
+	  in = 1;
+	}
+      else if (in && edi_parallel_is (buffer, tag, i, syntax.tail))
+	{
+	  if (!edi_parallel_push (ranges, start, i - start, group, group_size))
+	    return 0;
+	  in = 0;
+	}
+      else if (edi_parallel_is (buffer, tag, i, syntax.trailer))
+	break;
+    }
+
+  return 1;
+}
+
+/* feeds part of a stream to a parser, returning the error (if any)
+   which stopped it */
+static edi_error_t edi_parallel_feed
+(edi_parser_t *parser, char *buffer, unsigned long size, int done)
+{
+  edi_error_t error;
+  long n;
+
+  while (size)
+    {
+      n = edi_parser_parse (parser, buffer, size, done);
+
+      if ((error = edi_parser_get_error_code (parser)) || n <= 0)
+	return error;
+
+      buffer += n;
+      size -= n;
+    }
+
+  return EDI_ENONE;
+}
+
+/* parses a range as a stream of its own, returning the error (if any)
+   which stopped the parser */
+static edi_error_t edi_parallel_parse_range
+(edi_parser_t *parser, char *buffer, unsigned long size)
+{
+  edi_error_t error;
+  long n;
+
+  while (size)
+    {
+      n = edi_parser_parse (parser, buffer, size, 1);
+
+      if ((error = edi_parser_get_error_code (parser)))
+	return error;
+
+      if (n <= 0 || !edi_parser_is_complete (parser))
+	break;
+
+      buffer += n;
+      size -= n;
+      n = edi_interchange_skip (buffer, size);
+      buffer += n;
+      size -= n;
+
+      if (size)
+	edi_parser_reset (parser);
+    }
+
+  return edi_parser_get_error_code (parser);
+}
+
+/* takes the index of the next range to parse, waiting for room in the
+   reorder buffer if need be; zero once there are none left */
+static int edi_parallel_claim (edi_parallel_t *self, unsigned long *index)
+{
+  edi_parallel_order_t *order = &(self->order);
+  int claimed = 0;
+
+  edi_lock (&(order->lock));
+
+  while (self->handlers->ordered && self->next < self->ranges.count &&
+	 self->next >= order->delivered + order->window)
+    edi_cond_wait (&(order->room), &(order->lock));
+
+  if (self->next < self->ranges.count)
+    {
+      *index = self->next++;
+      claimed = 1;
+    }
+
+  edi_unlock (&(order->lock));
+
+  return claimed;
+}
+
+/**
+   \brief Sets up the delivery of results to the end handler.
+   \param self Pointer to the structure to be filled in.
+   \param handlers The handlers.
+   \param window The most results which may be waiting for the one
+   before them, when ordered.
+   \param base Added to each index given to the end handler.
+   \return Non-zero on success. Either way it is finished with
+   edi_parallel_order_fini().
+*/
+int
+edi_parallel_order_init (edi_parallel_order_t *self,
+			 edi_parallel_handlers_t *handlers,
+			 unsigned long window, unsigned long base)
+{
+  memset (self, 0, sizeof (edi_parallel_order_t));
+  self->handlers = handlers;
+  self->window = window;
+  self->base = base;
+
+  edi_lock_init (&(self->lock));
+  edi_cond_init (&(self->room));
+
+  return !handlers->ordered ||
+    (self->result = calloc (window, sizeof (edi_parallel_result_t)));
+}
+
+/**
+   \brief Frees the reorder buffer.
+   \param self Pointer to the structure, which was set up with
+   edi_parallel_order_init().
+*/
+void
+edi_parallel_order_fini (edi_parallel_order_t *self)
+{
+  edi_cond_destroy (&(self->room));
+  edi_lock_destroy (&(self->lock));
+  free (self->result);
+  self->result = NULL;
+}
+
+/**
+   \brief Hands a result to the end handler.
+   \param self Pointer to the structure.
+   \param index Index of the interchange, message or file, which must
+   lie within the window of those not yet delivered.
+   \param data The start handler's data.
+   \param error The error which stopped the parser, if any.
+   \param item Passed to the release function once the end handler
+   has been called.
+
+   When ordered, results which follow one still being parsed are held
+   back; the thread delivering that one then delivers them too, unless
+   another thread is already doing so and will pick them up. The end
+   handler and release function are called without the lock held.
+*/
+void
+edi_parallel_order_deliver (edi_parallel_order_t *self, unsigned long index,
+			    void *data, edi_error_t error, void *item)
+{
+  edi_parallel_handlers_t *h = self->handlers;
+  edi_parallel_result_t *result;
+
+  if (!h->ordered)
+    {
+      if (h->end)
+	h->end (h->user_data, data, self->base + index, error);
+      if (self->release)
+	self->release (self->owner, item);
+      return;
+    }
+
+  edi_lock (&(self->lock));
+
+  result = self->result + (index % self->window);
+  result->data = data;
+  result->item = item;
+  result->error = error;
+  result->done = 1;
+
+  if (self->delivering)
+    {
+      edi_unlock (&(self->lock));
+      return;
+    }
+
+  self->delivering = 1;
+
+  while ((result = self->result + (self->delivered % self->window))->done)
+    {
+      result->done = 0;
+      data = result->data;
+      item = result->item;
+      error = result->error;
+      index = self->delivered;
+
+      edi_unlock (&(self->lock));
+      if (h->end)
+	h->end (h->user_data, data, self->base + index, error);
+      if (self->release)
+	self->release (self->owner, item);
+      edi_lock (&(self->lock));
+
+      self->delivered++;
+      edi_cond_broadcast (&(self->room));
+    }
+
+  self->delivering = 0;
+  edi_unlock (&(self->lock));
+}
+
+static void *edi_parallel_work (void *v)
+{
+  edi_parallel_worker_t *worker = (edi_parallel_worker_t *) v;
+  edi_parallel_t *self = worker->shared;
+  edi_parallel_handlers_t *h = self->handlers;
+  edi_parser_t *parser = worker->parser;
+  edi_range_t *range;
+  unsigned long index;
+  edi_error_t error;
+  void *data;
+
+  while (edi_parallel_claim (self, &index))
+    {
+      range = self->ranges.range + index;
+      error = EDI_ENONE;
+
+      edi_parser_recycle (parser);
+
+      /* a message needs the headers it comes after, which aren't
+	 reported to the application */
+      if (self->ranges.head)
+	{
+	  error = edi_parallel_feed (parser, self->buffer + self->origin,
+				     self->ranges.head - self->origin, 0);
+	  if (!error && range->group_size)
+	    error = edi_parallel_feed (parser, self->buffer + range->group,
+				       range->group_size, 0);
+	}
+
+      data = h->start ?
+	h->start (h->user_data, parser, self->base + index) : NULL;
+
+      if (error)
+	;
+      else if (self->ranges.head)
+	error = edi_parallel_feed (parser, self->buffer + range->offset,
+				   range->size, 0);
+      else
+	error = edi_parallel_parse_range
+	  (parser, self->buffer + range->offset, range->size);
+
+      edi_parallel_order_deliver (&(self->order), index, data, error, NULL);
+    }
+
+  return NULL;
+}
+
+/* parses the ranges on up to the given number of threads, the calling
+   thread being one of them, returning zero on failure */
+static int edi_parallel_run (edi_parallel_t *self, unsigned int threads)
+{
+  edi_parallel_worker_t *worker = NULL;
+  unsigned int n;
+  int ok = 0;
+
+#if defined(EDI_PARALLEL_THREADS)
+  if (!threads)
+    {
+      long online = sysconf (_SC_NPROCESSORS_ONLN);
+      threads = online > 0 ? online : 1;
+    }
+#else
+  threads = 1;
+#endif
+
+  if (threads > self->ranges.count)
+    threads = self->ranges.count ? self->ranges.count : 1;
+
+  if (!edi_parallel_order_init (&(self->order), self->handlers,
+				threads * EDI_PARALLEL_WINDOW, self->base) ||
+      !(worker = calloc (threads, sizeof (edi_parallel_worker_t))))
+    goto out;
+
+  for (n = 0; n < threads; n++)
+    {
+      worker[n].shared = self;
+      if (!(worker[n].parser = edi_parser_create (EDI_UNKNOWN)))
+	goto out;
+    }
+
+#if defined(EDI_PARALLEL_THREADS)
+  /* if a thread can't be started the others take up its share */
+  for (n = 1; n < threads; n++)
+    worker[n].started =
+      !pthread_create (&(worker[n].thread), NULL, edi_parallel_work,
+		       worker + n);
+#endif
+
+  edi_parallel_work (worker);
+
+#if defined(EDI_PARALLEL_THREADS)
+  for (n = 1; n < threads; n++)
+    if (worker[n].started)
+      pthread_join (worker[n].thread, NULL);
+#endif
+
+  ok = 1;
+
+ out:
+  for (n = 0; worker && n < threads; n++)
+    edi_parser_free (worker[n].parser);
+
+  free (worker);
+  edi_parallel_order_fini (&(self->order));
+
+  return ok;
+}
+
+/**
+   \brief Parses the interchanges in a buffer on several threads.
+   \param buffer The stream, which the parsers may modify.
+   \param size Length of the stream.
+   \param threads The number of threads to use, or zero for one for
+   each processor.
+   \param handlers Handlers to set up and finish each interchange.
+   \return The number of interchanges, or -1 on failure.
+
+   The calling thread is one of the threads, and this returns once
+   every interchange has been given to the end handler.
+*/
+long
+edi_parallel_parse (char *buffer, unsigned long size, unsigned int threads,
+		    edi_parallel_handlers_t *handlers)
+{
+  edi_parallel_t self;
+  long count = -1;
+
+  memset (&self, 0, sizeof (edi_parallel_t));
+  self.buffer = buffer;
+  self.handlers = handlers;
+
+  if (!edi_interchange_scan (&(self.ranges), buffer, size))
+    return -1;
+
+  if (edi_parallel_run (&self, threads))
+    count = self.ranges.count;
+
+  free (self.ranges.range);
+
+  return count;
+}
+
+/**
+   \brief Parses the messages of each interchange in a buffer on
+   several threads.
+   \param parser The parser for the envelopes.
+   \param buffer The stream, which the parsers may modify.
+   \param size Length of the stream.
+   \param threads As for edi_parallel_parse().
+   \param handlers Handlers to set up and finish each message.
+   \return The number of messages, or -1 on failure.
+
+   The envelope parser sees the interchange and group headers before
+   any of the messages are parsed, and the trailers after all of them
+   are. Messages are numbered from the start of the stream. Should the
+   syntax not allow for messages to be parsed apart, the envelope
+   parser parses them with its own handlers. The parser's error code
+   is that of the envelope; errors in messages go to the end handler.
+*/
+long
+edi_parallel_parse_messages (edi_parser_t *parser, char *buffer,
+			     unsigned long size, unsigned int threads,
+			     edi_parallel_handlers_t *handlers)
+{
+  edi_ranges_t interchanges;
+  edi_parallel_t self;
+  edi_range_t *ic, *m;
+  unsigned long n, end;
+  long count = 0;
+
+  if (!edi_interchange_scan (&interchanges, buffer, size))
+    return -1;
+
+  memset (&self, 0, sizeof (edi_parallel_t));
+  self.buffer = buffer;
+  self.handlers = handlers;
+
+  for (ic = interchanges.range;
+       ic < interchanges.range + interchanges.count; ic++)
+    {
+      end = ic->offset + ic->size;
+
+      if (ic != interchanges.range)
+	edi_parser_reset (parser);
+
+      if (!edi_message_scan (&(self.ranges), buffer, ic->offset, ic->size))
+	{
+	  count = -1;
+	  break;
+	}
+
+      m = self.ranges.range;
+      n = self.ranges.count ? m->offset : ic->offset;
+
+      /* the interchange and first group headers */
+      if (n > ic->offset &&
+	  edi_parallel_feed (parser, buffer + ic->offset, n - ic->offset, 0))
+	{
+	  free (self.ranges.range);
+	  break;
+	}
+
+      if (!self.ranges.count || !parser->syntax_skip)
+	{
+	  free (self.ranges.range);
+	  if (edi_parallel_feed (parser, buffer + n, end - n, 1))
+	    break;
+	  continue;
+	}
+
+      self.origin = ic->offset;
+      self.next = 0;
+
+      if (!edi_parallel_run (&self, threads))
+	{
+	  free (self.ranges.range);
+	  count = -1;
+	  break;
+	}
+
+      /* each message is followed by any trailers and headers between
+	 it and the next */
+      for (n = 0; n < self.ranges.count; n++, m++)
+	{
+	  edi_parser_skip_message (parser);
+
+	  if (edi_parallel_feed (parser, buffer + m->offset + m->size,
+				 (n + 1 < self.ranges.count ?
+				  m[1].offset : end) - m->offset - m->size,
+				 n + 1 == self.ranges.count))
+	    break;
+	}
+
+      count += self.ranges.count;
+      self.base += self.ranges.count;
+      free (self.ranges.range);
+
+      if (edi_parser_get_error_code (parser))
+	break;
+    }
+
+  free (interchanges.range);
+
+  return count;
+}
+
+/**
+   \brief Maps, or reads in, a file and parses its interchanges on
+   several threads.
+   \param path Name of the file, or NULL for standard input.
+   \param threads As for edi_parallel_parse().
+   \param handlers As for edi_parallel_parse().
+   \return The number of interchanges, or -1 on failure.
+*/
+long
+edi_parallel_parse_file (const char *path, unsigned int threads,
+			 edi_parallel_handlers_t *handlers)
+{
+  edi_input_t input;
+  long count;
+
+  if (!edi_input_load (&input, path))
+    return -1;
+
+  count = edi_parallel_parse (input.data, input.size, threads, handlers);
+  edi_input_unload (&input);
+
+  return count;
+}
+
+/** \} */
@@ -0,0 +1,132 @@
+/*
+
+  The MEDICI Electronic Data Interchange Library
+  Copyright (C) 2002  David Coles
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+/** \brief Where an interchange or message lies in a stream */
+typedef struct
+{
+  unsigned long offset, size;
+
+  /** \brief For a message, the group header segment it is in, if any */
+  unsigned long group, group_size;
+}
+edi_range_t;
+
+/**
+   \brief The interchanges found in a stream by edi_interchange_scan(),
+   or the messages in an interchange by edi_message_scan()
+*/
+typedef struct
+{
+  edi_range_t *range;
+  unsigned long count, size;
+
+  /** \brief For messages, the end of the interchange header segment */
+  unsigned long head;
+}
+edi_ranges_t;
+
+/**
+   \brief Sets up a parser for an interchange
+
+   Called on the parsing thread with the handlers' user data, a parser
+   which has been recycled (see edi_parser_recycle()) and the index of
+   the interchange, or message, in the stream. Returns the data to be
+   given to the end handler for it.
+*/
+typedef void *(*edi_interchange_start_t) (void *, edi_parser_t *,
+					  unsigned long);
+
+/**
+   \brief Finishes with an interchange
+
+   Called with the handlers' user data, the start handler's data, the
+   index of the interchange, or message, and the error which stopped
+   it, if any.
+*/
+typedef void (*edi_interchange_end_t) (void *, void *, unsigned long,
+				       edi_error_t);
+
+/** \brief Handlers for the interchanges or messages of a parallel parse */
+typedef struct
+{
+  edi_interchange_start_t start;
+  edi_interchange_end_t end;
+  void *user_data;
+
+  /** \brief Non-zero to call the end handler in order of the stream */
+  int ordered;
+}
+edi_parallel_handlers_t;
+
+/** \brief An interchange, message or file parsed but not yet handed
+    to the end handler */
+typedef struct
+{
+  void *data, *item;
+  edi_error_t error;
+  int done;
+}
+edi_parallel_result_t;
+
+/**
+   \brief Hands parsed interchanges, messages or files to the end
+   handler - in order of their index if the handlers are ordered
+*/
+typedef struct
+{
+  edi_parallel_handlers_t *handlers;
+
+  /** \brief Added to each index given to the end handler */
+  unsigned long base;
+
+  /** \brief Called with owner and the item of each result once it has
+      been given to the end handler, if not NULL */
+  void (*release) (void *, void *);
+  void *owner;
+
+  /** \brief The reorder buffer, holding results for the indexes from
+      delivered to delivered + window - 1 */
+  edi_parallel_result_t *result;
+  unsigned long window, delivered;
+  int delivering;
+
+  /** \brief Guards the above, and is signalled as results are
+      delivered */
+  edi_lock_t lock;
+  edi_cond_t room;
+}
+edi_parallel_order_t;
+
+/* parallel.c */
+unsigned long edi_interchange_skip(const char *, unsigned long);
+int edi_interchange_scan(edi_ranges_t *, const char *, unsigned long);
+int edi_message_scan(edi_ranges_t *, const char *, unsigned long, unsigned long);
+int edi_parallel_order_init(edi_parallel_order_t *, edi_parallel_handlers_t *, unsigned long, unsigned long);
+void edi_parallel_order_fini(edi_parallel_order_t *);
+void edi_parallel_order_deliver(edi_parallel_order_t *, unsigned long, void *, edi_error_t, void *);
+long edi_parallel_parse(char *, unsigned long, unsigned int, edi_parallel_handlers_t *);
+long edi_parallel_parse_messages(edi_parser_t *, char *, unsigned long, unsigned int, edi_parallel_handlers_t *);
+long edi_parallel_parse_file(const char *, unsigned int, edi_parallel_handlers_t *);
+
+#endif /*PARALLEL_H*/
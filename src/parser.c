@@ -80,6 +80,8 @@ static void edi_parser_init_tokeniser(edi_parser_t *self)
   self->tokeniser.cmplt_handler = edi_parser_cmplt_handler;
   self->tokeniser.token_handler = edi_parser_token_handler;
   self->tokeniser.error_handler = (edi_error_handler_t) edi_parser_raise_error;
+  self->tokeniser.slices = 1;
+  edi_tokeniser_set_scan(&(self->tokeniser), self->scan);
 }
 
 static void edi_parser_init_state(edi_parser_t *self)
@@ -94,17 +96,39 @@ static void edi_parser_init_state(edi_parser_t *self)
 
 static void edi_parser_init_dynamic(edi_parser_t *self)
 {
-  edi_list_init(&(self->token_queue));
-  edi_buffer_init (&(self->parse_buffer));
-  edi_stack_init (&(self->stack));
   self->advice = &(self->tokeniser.advice);
+}
+
+/* working storage which is kept, emptied, from one interchange to the next */
+static void edi_parser_init_buffers(edi_parser_t *self)
+{
+  edi_token_ring_init(&(self->token_ring));
+  edi_buffer_init (&(self->parse_buffer));
+  self->view = NULL;
   self->segment = edi_segment_create ();
+  self->stack = NULL;
+  self->depth = self->stack_blck = 0;
+}
+
+static void edi_parser_reset_buffers(edi_parser_t *self)
+{
+  edi_token_ring_clear (&(self->token_ring));
+  edi_buffer_reset (&(self->parse_buffer));
+  edi_buffer_shrink (&(self->parse_buffer), EDI_BUFFER_RETAIN);
+  edi_segment_clear (self->segment);
+  edi_segment_shrink (self->segment, EDI_BUFFER_RETAIN);
+  self->view = NULL;
+  self->stale = 0;
+  self->depth = 0;
 }
 
 static void edi_parser_init_syntax(edi_parser_t *self)
 {
   self->syntax_fini = NULL;
+  self->syntax_reset = NULL;
+  self->syntax_skip = NULL;
   self->sgmnt_handler = NULL;
+  self->syntax_type = EDI_UNKNOWN;
 }
 
 void
@@ -113,23 +137,66 @@ edi_parser_init (edi_parser_t *self)
   memset(self, 0, sizeof(edi_parser_t)); /* mitigate bugs */
   
   self->pragma = EDI_PCHARSET | EDI_PTUNKNOWN | EDI_PSEGMENT;
+  self->scan = EDI_SCAN_AVX2;
   edi_parser_init_handlers(self);
   
   edi_parser_init_state(self);
   edi_parser_init_tokeniser(self);
   edi_parser_init_dynamic(self);
+  edi_parser_init_buffers(self);
   edi_parser_init_syntax(self);
 }
 
-/* must avoid clearing stuff the app has set up - such as callback handlers */
+static void edi_parser_fini_syntax (edi_parser_t *self)
+{
+  if (self->syntax_fini)
+    self->syntax_fini (self);
+
+  edi_parser_init_syntax (self);
+}
+
+static void edi_parser_fini_dynamic (edi_parser_t *self)
+{
+  edi_parser_fini_syntax (self);
+
+  edi_tokeniser_fini (&(self->tokeniser));
+}
+
+/* must avoid clearing stuff the app has set up - such as callback
+   handlers - and keeps the memory and syntax module in use, so costs
+   next to nothing for the small interchanges parsed one after another
+   by a long running application */
 void edi_parser_reset (edi_parser_t *self)
 {
-  edi_parser_fini (self);
+  if (self->syntax_reset)
+    self->syntax_reset (self);
 
   edi_parser_init_state(self);
-  edi_parser_init_tokeniser(self);
-  edi_parser_init_dynamic(self);
-  edi_parser_init_syntax(self);
+  edi_tokeniser_reset(&(self->tokeniser));
+  edi_parser_reset_buffers(self);
+
+  if (self->pipeline)
+    edi_pipeline_reset(self->pipeline);
+}
+
+/* as edi_parser_reset(), but the application's handlers and settings
+   are forgotten too - leaving the parser as edi_parser_create() would,
+   apart from the memory and syntax module kept */
+void edi_parser_recycle (edi_parser_t *self)
+{
+  edi_parser_reset (self);
+
+  self->pragma = EDI_PCHARSET | EDI_PTUNKNOWN | EDI_PSEGMENT;
+  self->scan = EDI_SCAN_AVX2;
+  edi_tokeniser_set_scan (&(self->tokeniser), self->scan);
+  self->envelope_only = 0;
+  edi_parser_set_pipeline (self, 0);
+  edi_parser_init_handlers (self);
+
+  /* the next user's directories may be different */
+  edi_parser_set_directory_cache (self, NULL);
+  edi_directory_free (self->cursor);
+  self->cursor = NULL;
 }
 
 
@@ -185,15 +252,25 @@ void edi_parser_fini (edi_parser_t *self)
   if (!self)
     return;
 
-  if (self->syntax_fini)
-    self->syntax_fini (self);
+  edi_parser_fini_dynamic (self);
 
   edi_buffer_clear (&(self->parse_buffer));
-  edi_stack_clear (&(self->stack), free);
-  edi_list_clear (&(self->token_queue), free);
+  edi_token_ring_fini (&(self->token_ring));
+  edi_parser_set_pipeline (self, 0);
+
+  while (self->stack_blck)
+    edi_segment_free (self->stack[--self->stack_blck]);
+  free (self->stack);
+  self->stack = NULL;
+  self->depth = 0;
 
   if (self->segment)
     edi_segment_free (self->segment);
+  self->segment = NULL;
+
+  edi_parser_set_directory_cache (self, NULL);
+  edi_directory_free (self->cursor);
+  self->cursor = NULL;
 }
 
 /**
@@ -209,6 +286,53 @@ edi_parser_free (edi_parser_t *self)
 }
 
 
+static void edi_parser_detach_view (edi_parser_t *self)
+{
+  if (edi_buffer_reserve (&(self->parse_buffer), self->view_size))
+    self->parse_buffer.size = edi_segment_unescape
+      ((char *) edi_buffer_data (&(self->parse_buffer)),
+       self->view, self->view_size, self->view_release);
+  self->view = NULL;
+}
+
+/**
+   \brief Copies anything which is still a view of the parsed buffer.
+   \param self Pointer to the parser.
+
+   Must be called before a buffer passed to edi_parser_parse_views()
+   is reused.
+*/
+
+void
+edi_parser_detach (edi_parser_t *self)
+{
+  if (self->view)
+    edi_parser_detach_view (self);
+
+  edi_segment_detach (self->segment);
+}
+
+/**
+   \brief Parse a chunk of an EDI stream, leaving the segment with
+   views of it.
+   \param self Pointer to the parser which should parse the chunk.
+   \param buffer Pointer to the buffer containing the chunk, which must
+   not be changed until edi_parser_detach() has been called.
+   \param length Length in characters of the chunk.
+   \param done Non-zero if this is the last chunk in the stream.
+   \return Number of characters consumed by the parser.
+*/
+
+long
+edi_parser_parse_views (edi_parser_t *self, char *buffer, long length,
+			int done)
+{
+  if (self->pipeline && length >= EDI_PIPELINE_MIN)
+    return edi_pipeline_parse(self, buffer, length, done);
+
+  return edi_tokeniser_parse(&(self->tokeniser), buffer, length, done);
+}
+
 /**
    \brief Parse a chunk of an EDI stream,
    \param self Pointer to the parser which should parse the chunk.
@@ -228,7 +352,13 @@ edi_parser_free (edi_parser_t *self)
 long
 edi_parser_parse (edi_parser_t *self, char *buffer, long length, int done)
 {  
-  return edi_tokeniser_parse(&(self->tokeniser), buffer, length, done);
+  long n = edi_parser_parse_views(self, buffer, length, done);
+
+  /* the segment may hold views of the buffer, which the caller is
+     free to reuse once this returns */
+  edi_parser_detach (self);
+
+  return n;
 }
 
 
@@ -246,10 +376,16 @@ edi_parser_parse (edi_parser_t *self, char *buffer, long length, int done)
  **********************************************************************/
 
 /** \brief Returns the byte offset of the position in the stream. */
-unsigned long
+edi_offset_t
 edi_parser_get_byte_index (edi_parser_t *self)
 {
-  return self ? self->tokeniser.byte_count : 0;
+  edi_offset_t offset;
+
+  /* the tokeniser may be ahead of the parser */
+  if (self && self->pipeline && edi_pipeline_offset (self->pipeline, &offset))
+    return offset;
+
+  return self ? edi_tokeniser_byte_count(&(self->tokeniser)) : 0;
 }
 
 /** \brief Returns the segment index of the position in the stream. */
@@ -259,6 +395,32 @@ edi_parser_get_segment_index (edi_parser_t *self)
   return self ? self->segment_count : 0;
 }
 
+/** \brief Returns the number of heap allocations made for queued
+    tokens; this stops rising once the parser has seen its largest
+    segment. */
+unsigned long
+edi_parser_get_allocation_count (edi_parser_t *self)
+{
+  return self ? self->token_ring.allocations : 0;
+}
+
+/** \brief Returns the largest number of bytes the parser has needed
+    to hold a segment. */
+unsigned long
+edi_parser_get_high_water (edi_parser_t *self)
+{
+  return self ? edi_segment_peak (self->segment) : 0;
+}
+
+/** \brief Sizes the parser's buffers to hold a segment of the given
+    number of bytes without further allocation. */
+int
+edi_parser_reserve (edi_parser_t *self, unsigned long size)
+{
+  return self && edi_buffer_reserve (&(self->parse_buffer), size) &&
+    edi_segment_reserve (self->segment, size);
+}
+
 /** \brief Returns the type of error that has occured. */
 int
 edi_parser_get_error_code (edi_parser_t *self)
@@ -300,12 +462,63 @@ edi_set_pragma_t (edi_parser_t *p, edi_pragma_t pragma)
   return (old);
 }
 
+/** \brief Selects how runs of element data are skipped (see
+    edi_tokeniser_set_scan); the setting survives a reset */
+edi_scan_t
+edi_parser_set_scan (edi_parser_t *self, edi_scan_t scan)
+{
+  edi_scan_t old = self->scan;
+  self->scan = scan;
+  edi_tokeniser_set_scan(&(self->tokeniser), scan);
+  return old;
+}
+
+
+/**
+   \brief Parses large chunks of a stream on two threads, or not.
+   \param self Pointer to the parser.
+   \param pipeline Non-zero to tokenise on the calling thread and
+   parse on another.
+   \return Zero if a pipeline couldn't be set up (or there are no
+   threads), otherwise non-zero.
+
+   The handlers are then called on the other thread, one at a time
+   and in order. The setting survives a reset but not a recycle, and
+   mustn't be changed during a parse.
+*/
+int
+edi_parser_set_pipeline (edi_parser_t *self, int pipeline)
+{
+  if (!pipeline)
+    {
+      edi_pipeline_free (self->pipeline);
+      self->pipeline = NULL;
+      return 1;
+    }
+
+  if (!self->pipeline)
+    self->pipeline = edi_pipeline_create (self);
+
+  return self->pipeline != NULL;
+}
 
 int edi_parser_is_complete(edi_parser_t *self)
 {
   return self->done;
 }
 
+/* tells the syntax module that a message of the interchange being
+   parsed was parsed by another parser - see edi_parallel_parse_messages() -
+   returning zero if the syntax doesn't allow for that */
+int edi_parser_skip_message(edi_parser_t *self)
+{
+  if (!self->syntax_skip)
+    return 0;
+
+  self->syntax_skip (self);
+  return 1;
+}
+
 
 
 
@@ -341,7 +554,12 @@ edi_parser_raise_error (edi_parser_t *self, edi_error_t error)
   if (error == EDI_ESYNTAX || !warning)
     {
       self->error = error;
-      self->tokeniser.error = error;
+
+      /* the tokeniser may be running on another thread */
+      if (self->pipeline && edi_pipeline_active(self->pipeline))
+	edi_pipeline_halt(self->pipeline);
+      else
+	edi_tokeniser_set_error(&(self->tokeniser), error);
     }
 
   
@@ -377,12 +595,44 @@ void edi_parser_handle_segment
     edi_parser_segment_events (self, d);
 }
 
+/* gives back the directory held from the cache, first dropping the
+   cursor which may be walking it */
+static void edi_parser_release_directory (edi_parser_t *self)
+{
+  if (!self->cached)
+    return;
+
+  edi_directory_free (self->cursor);
+  self->cursor = NULL;
+
+  edi_directory_cache_put (self->cache, self->cached);
+  self->cached = NULL;
+}
+
 /** \brief Requests the client for a directory (to parse transaction) */
 edi_directory_t *
 edi_parser_handle_directory (edi_parser_t *self, edi_parameters_t *p)
 {
-  return (self->directory_handler ?
-	  self->directory_handler (self->user_data, p) : NULL);
+  edi_directory_t *directory = self->directory_handler ?
+    self->directory_handler (self->user_data, p) : NULL;
+  edi_directory_entry_t *e;
+
+  if (directory || !self->cache)
+    return directory;
+
+  /* the previous message's directory is held on to until now, so that
+     it isn't evicted and reloaded between messages of the same type */
+  e = edi_directory_cache_get (self->cache, p);
+
+  if (e == self->cached)
+    edi_directory_cache_put (self->cache, e);
+  else
+    {
+      edi_parser_release_directory (self);
+      self->cached = e;
+    }
+
+  return e ? e->directory : NULL;
 }
 
 /** \brief Notifies the client of the start of a structural event */
@@ -451,12 +701,34 @@ void edi_parser_handle_separator
 #define edi_parser_handle_error NULL
 
 
+/* the directory to walk a transaction with: the parser's own cursor
+   if the directory can make one, so that the directory itself is
+   never changed and may be shared with other parsers */
+
+static edi_directory_t *
+edi_parser_cursor (edi_parser_t *self, edi_directory_t *directory)
+{
+  if (!directory || !directory->cursor)
+    return directory;
+
+  if (self->cursor && self->cursor->user_data == directory->user_data)
+    return self->cursor;
+
+  edi_directory_free (self->cursor);
+
+  /* fall back to the directory itself if there's no memory */
+  return (self->cursor = edi_directory_cursor (directory)) ?
+    self->cursor : directory;
+}
+
 void edi_parser_transaction_head
 (edi_parser_t *self,
  edi_segment_t *segment,
  edi_directory_t *directory,
  char *transaction)
 {
+  directory = edi_parser_cursor (self, directory);
+
   edi_directory_start(directory, transaction);  
   edi_directory_parse(directory, edi_segment_get_code(segment), 0, self,
 		      (edi_eventh_t) edi_parser_handle_start,
@@ -470,6 +742,8 @@ void edi_parser_transaction_body
  edi_segment_t *segment,
  edi_directory_t *directory)
 {
+  directory = edi_parser_cursor (self, directory);
+
   edi_directory_parse(directory, edi_segment_get_code(segment), 0, self,
 		      (edi_eventh_t) edi_parser_handle_start,
 		      (edi_eventh_t) edi_parser_handle_end,
@@ -482,6 +756,7 @@ void edi_parser_transaction_tail
  edi_segment_t *segment,
  edi_directory_t *directory)
 {
+  directory = edi_parser_cursor (self, directory);
 
   edi_directory_parse(directory, edi_segment_get_code(segment), 1, self,
                       (edi_eventh_t) edi_parser_handle_start,
@@ -507,37 +782,97 @@ void edi_parser_transaction_tail
  * Functions for building up the segment data structure
  **********************************************************************/
 
+/* the last segment is left intact after it has been handed to the
+   application - until the next one starts */
+
+static edi_segment_t *edi_parser_current_segment (edi_parser_t *self)
+{
+  if (self->stale)
+    {
+      edi_segment_clear (self->segment);
+      self->stale = 0;
+    }
+
+  return self->segment;
+}
+
 static void edi_parser_end_tag (edi_parser_t *self)
 {
-  edi_segment_set_code (self->segment, (char *)
+  edi_segment_set_code (edi_parser_current_segment (self), (char *)
 			edi_buffer_data (&(self->parse_buffer)),
 			edi_buffer_size (&(self->parse_buffer)));
-  edi_buffer_clear (&(self->parse_buffer));
+  edi_buffer_reset (&(self->parse_buffer));
   self->de = 0;
   self->cde = 0;
 }
 
+/* sets a component from the view, if there is one, or else from the
+   characters collected in the parse buffer */
+
+static void edi_parser_set_value (edi_parser_t *self, int x, int y)
+{
+  if (self->view)
+    edi_segment_set_view (edi_parser_current_segment (self), x, y,
+			  self->view, self->view_size, self->view_release);
+  else
+    edi_segment_set_element (edi_parser_current_segment (self), x, y,
+			     (char *) edi_buffer_data (&(self->parse_buffer)),
+			     edi_buffer_size (&(self->parse_buffer)));
+  edi_buffer_reset (&(self->parse_buffer));
+  self->view = NULL;
+}
+
+/* an element which is a single, uncarried slice can be left where it
+   is; anything else - including a copy from a pipeline - is collected
+   (cooked) in the parse buffer */
+
+static void edi_parser_add_value (edi_parser_t *self, edi_token_t *token)
+{
+  unsigned long n;
+
+  /* a view followed by more of the same element becomes a copy */
+  if (self->view)
+    edi_parser_detach_view (self);
+
+  if (token->type == EDI_TEL && token->slice && token->first &&
+      token->last &&
+      !(self->pipeline && edi_pipeline_active (self->pipeline)) &&
+      !self->tokeniser.carried &&
+      !edi_buffer_size (&(self->parse_buffer)))
+    {
+      self->view = token->slice;
+      self->view_size = token->rsize;
+      self->view_release = 0;
+
+      for (n = 0; token->rimap && n < token->rsize; n++)
+	if (edi_token_is_ri (token, n))
+	  {
+	    self->view_release = token->slice[n];
+	    break;
+	  }
+      return;
+    }
+
+  edi_buffer_append (&(self->parse_buffer), (char *) edi_token_cooked (token),
+		     token->csize);
+}
+
 static void edi_parser_end_element (edi_parser_t *self)
 {
-  edi_segment_set_element (self->segment, self->de++, self->cde, (char *)
-			   edi_buffer_data (&(self->parse_buffer)),
-			   edi_buffer_size (&(self->parse_buffer)));
-  edi_buffer_clear (&(self->parse_buffer));
+  edi_parser_set_value (self, self->de++, self->cde);
   self->cde = 0;
 }
 
 static void edi_parser_end_subelement (edi_parser_t *self)
 {
-  edi_segment_set_element (self->segment, self->de, self->cde++, (char *)
-			   edi_buffer_data (&(self->parse_buffer)),
-			   edi_buffer_size (&(self->parse_buffer)));
-  edi_buffer_clear (&(self->parse_buffer));
+  edi_parser_set_value (self, self->de, self->cde++);
 }
 
 static void edi_parser_new_segment (edi_parser_t *self)
 {
-  edi_buffer_clear (&(self->parse_buffer));
-  edi_segment_clear (self->segment);
+  edi_buffer_reset (&(self->parse_buffer));
+  self->view = NULL;
+  self->stale = 1;
   self->segment_count++;
   self->cde = 0;
   self->de = 0;
@@ -572,27 +907,45 @@ static void edi_parser_new_segment (edi_parser_t *self)
  * Functions for building an internal progress stack
  **********************************************************************/
 
+/* the segments popped off are kept, and copied over when pushed again */
+
 int
 edi_parser_push_segment (edi_parser_t *self, edi_segment_t *segment)
 {
-  edi_segment_t *copy;
-  
-  if((copy = edi_segment_dup (segment)))
-    edi_stack_push (&(self->stack), copy);
+  void *ptr;
+  int n;
+
+  if(self->depth == self->stack_blck)
+    {
+      n = self->stack_blck ? self->stack_blck * 2 : 4;
+      if(!(ptr = realloc (self->stack, n * sizeof (edi_segment_t *))))
+	return 0;
+      self->stack = ptr;
+      memset (self->stack + self->stack_blck, 0,
+	      (n - self->stack_blck) * sizeof (edi_segment_t *));
+      self->stack_blck = n;
+    }
+
+  if(!self->stack[self->depth] &&
+     !(self->stack[self->depth] = edi_segment_create ()))
+    return 0;
+
+  edi_segment_copy (self->stack[self->depth++], segment);
   
-  return copy ? 1 : 0;
+  return 1;
 }
 
 void
 edi_parser_pop_segment (edi_parser_t *self)
 {
-  edi_segment_free ((edi_segment_t *) edi_stack_pop (&(self->stack)));
+  if(self->depth)
+    self->depth--;
 }
 
 edi_segment_t *
 edi_parser_peek_segment (edi_parser_t *self)
 {
-  return (edi_segment_t *) edi_stack_peek (&self->stack);
+  return self->depth ? self->stack[self->depth - 1] : NULL;
 }
 
 
@@ -672,6 +1025,16 @@ edi_parser_set_directory_handler (edi_parser_t *self, edi_directory_handler_t d)
   return old;
 }
 
+/* the cache is not owned by the parser, and must outlive its use */
+void
+edi_parser_set_directory_cache (edi_parser_t *self, edi_directory_cache_t *c)
+{
+  if (c != self->cache)
+    edi_parser_release_directory (self);
+
+  self->cache = c;
+}
+
 edi_segment_handler_t
 edi_parser_set_segment_handler (edi_parser_t *self, edi_segment_handler_t h)
 {
@@ -754,6 +1117,19 @@ edi_parser_set_user_data (edi_parser_t *self, void *user_data)
  **********************************************************************/
 
 
+/* non-zero if any of the handlers fed by replaying a segment's tokens
+   are set - an application with just a segment handler needs none of
+   that work done */
+
+static int
+edi_parser_replays_tokens (edi_parser_t *self)
+{
+  return !self->envelope_only &&
+    (self->start_handler || self->end_handler ||
+     self->text_handler || self->default_handler ||
+     self->separator_handler || self->token_handler);
+}
+
 /**
    \brief Called when the tokeniser completes a token
    \param v Pointer to the edi_parser_t structure
@@ -771,12 +1147,14 @@ int
 edi_parser_token_handler (void *v, edi_token_t *token)
 {
   edi_parser_t *self = (edi_parser_t *) v;
-  edi_token_t *copy_of_token;
   
-  if((copy_of_token = (edi_token_t *) malloc(sizeof(edi_token_t))))
+  /* tokens are only kept if there are handlers for the events which
+     are replayed from them - see edi_parser_segment_events() */
+  if(edi_parser_replays_tokens(self) &&
+     !edi_token_ring_push(&(self->token_ring), token))
     {
-      *copy_of_token = *token;
-      edi_queue_queue(&(self->token_queue), copy_of_token);
+      edi_parser_raise_error(self, EDI_ENOMEM);
+      return self->done;
     }
   
   switch(token->type)
@@ -788,12 +1166,9 @@ edi_parser_token_handler (void *v, edi_token_t *token)
       edi_parser_new_segment(self);
       /* FIXME - this should now be handled within the segment/events */
       /* handler but it doesn't hurt to mop up here for now just in case */
-      while((token = (edi_token_t *) edi_queue_dequeue(&(self->token_queue))))
-	{
-	  fprintf(stderr, "DEBUG: Cleaning up stray token (%.*s)!\n",
-		  (int) token->csize, token->cdata);
-	  free(token);
-	}
+      while((token = edi_token_ring_shift(&(self->token_ring))))
+	fprintf(stderr, "DEBUG: Cleaning up stray token (%.*s)!\n",
+		(int) token->csize, edi_token_cooked(token));
       break;
       
     case EDI_TSS:
@@ -810,7 +1185,7 @@ edi_parser_token_handler (void *v, edi_token_t *token)
       
     case EDI_TTG:
     case EDI_TEL:
-      edi_buffer_append(&(self->parse_buffer), token->cdata, token->csize);
+      edi_parser_add_value(self, token);
       break;
       
     default:
@@ -842,6 +1217,13 @@ void edi_parser_itype_handler
 
   self->interchange_type = type;
 
+  /* still set up from the last interchange */
+  if(type == EDI_UNKNOWN || type == self->syntax_type)
+    return;
+
+  edi_parser_fini_syntax(self);
+  self->syntax_type = type;
+
   switch(type) {
   case EDI_EDIFACT:
     edi_edifact_init(self);
@@ -909,7 +1291,8 @@ static void handle_advice(edi_parser_t *self, edi_token_t *token)
     edi_parameters_set_one(p, DecimalNotation, advice[6]);
   
   edi_parser_handle_start (self, EDI_ADVICE, p);
-  edi_parser_handle_default (self, token->cdata, token->csize);
+  edi_parser_handle_default (self, (char *) edi_token_cooked(token),
+			     token->csize);
   edi_parser_handle_end (self, EDI_ADVICE, NULL);  
 }
 
@@ -927,47 +1310,79 @@ typedef struct
 
 
 
+/* the dictionary entries for an element, looked up when first asked for */
+
+typedef struct
+{
+  edi_element_info_t *info;
+  const char *value;
+  char ei[EDI_TOKEN_MAX], si[EDI_TOKEN_MAX];
+} edi_element_context_t;
+
+static const char *
+resolve_element(edi_parameters_t *p, edi_parameter_t k)
+{
+  edi_element_context_t *c = (edi_element_context_t *) p->context;
+  edi_directory_t *d = c->info->d;
+  char *code;
+  
+  switch(k)
+    {
+    case Element:
+      sprintf(c->ei, "%d", c->info->e);
+      return c->ei;
+      
+    case Subelement:
+      sprintf(c->si, "%d", c->info->s);
+      return c->si;
+      
+    case Code:
+      return edi_directory_find_element(d, c->info->tag, c->info->e,
+					c->info->s);
+    default:
+      break;
+    }
+  
+  code = (char *) edi_parameters_get(p, Code);
+  
+  switch(k)
+    {
+    case Name:
+      return edi_directory_element_name(d, code);
+    case Desc:
+      return edi_directory_element_desc(d, code);
+    case Note:
+      return edi_directory_element_note(d, code);
+    case List:
+      return edi_directory_codelist_value(d, code, (char *) c->value);
+    default:
+      return NULL;
+    }
+}
+
 static void
 handle_chars(edi_parser_t *self, edi_event_t event, edi_token_t *token,
 	     edi_element_info_t info)
 {
   unsigned int n = 0, x = 0;
-  char ei[EDI_TOKEN_MAX], si[EDI_TOKEN_MAX];
-  char *code = NULL, *name = NULL, *desc = NULL, *note = NULL, *list = NULL;
-  edi_directory_t *d = info.d;
+  char *raw = (char *) edi_token_raw(token);
+  edi_element_context_t context;
   edi_parameters_t parameters, *p;
   
   p = &parameters;
   
   edi_parameters_set(p, NULL);
 
-  if(token->first)
+  if(token->first && token->type != EDI_TTG)
     {
-      ei[0] = '\0';
-      si[0] = '\0';
+      context.info = &info;
+      context.value = edi_token_cooked(token);
       
-      if(token->type != EDI_TTG) {
-	code = edi_directory_find_element(d, info.tag, info.e, info.s);
-	name = edi_directory_element_name(d, code);
-	desc = edi_directory_element_desc(d, code);
-	note = edi_directory_element_note(d, code);
-	list = edi_directory_codelist_value(d, code, token->cdata);
-	
-	sprintf(ei, "%d", info.e);
-	sprintf(si, "%d", info.s);
-	
-	p->element = info.e;
-	p->subelement = info.s;
-      }
-
-      edi_parameters_set_one(p, Element, ei[0] ? ei : NULL);
-      edi_parameters_set_one(p, Subelement, si[0] ? si : NULL);
+      p->element = info.e;
+      p->subelement = info.s;
       
-      edi_parameters_set_one(p, Code, code);
-      edi_parameters_set_one(p, Name, name);
-      edi_parameters_set_one(p, Desc, desc);
-      edi_parameters_set_one(p, Note, note);
-      edi_parameters_set_one(p, List, list);
+      edi_parameters_defer(p, resolve_element, &context, Element, Subelement,
+			   Code, Name, Desc, Note, List, LastParameter);
     }
 
 
@@ -983,24 +1398,25 @@ handle_chars(edi_parser_t *self, edi_event_t event, edi_token_t *token,
     {
       for(n = 0; n < token->rsize; n++)
 	{
-	  if(token->ri[n])
+	  if(edi_token_is_ri(token, n))
 	    {
 	      if(n > x)
-		edi_parser_handle_text (self, token->rdata + x, n - x);
-	      edi_parser_handle_separator(self, EDI_RI, token->rdata[n]);
+		edi_parser_handle_text (self, raw + x, n - x);
+	      edi_parser_handle_separator(self, EDI_RI, raw[n]);
 	      
 	      x = n + 1;
 	    }
 	}
       
       if(n > x)
-	edi_parser_handle_text (self, token->rdata + x, n - x);
+	edi_parser_handle_text (self, raw + x, n - x);
       
     }
   else
     {
       if(token->csize)
-	edi_parser_handle_text (self, token->cdata, token->csize);
+	edi_parser_handle_text (self, (char *) edi_token_cooked(token),
+				token->csize);
     }
   
   
@@ -1026,8 +1442,6 @@ void edi_parser_segment_events
   edi_parameters_t pxx, *px;
   edi_element_info_t elem_info;
 
-  memset(&elem_info, 0, sizeof(elem_info));
-
   px = &pxx;
   edi_parameters_set(px, NULL);
   
@@ -1035,7 +1449,13 @@ void edi_parser_segment_events
   if (self->segment_handler)
     self->segment_handler (self->user_data, px, self->segment, d);
   
-  while((token = (edi_token_t *) edi_queue_dequeue(&(self->token_queue))))
+  /* nothing was queued if there is nobody to replay to */
+  if(!self->token_ring.count)
+    return;
+
+  memset(&elem_info, 0, sizeof(elem_info));
+  
+  while((token = edi_token_ring_shift(&(self->token_ring))))
     {
       /* higher level token handler - mostly obsolete really */
       edi_parser_handle_token(self, token);
@@ -1056,14 +1476,14 @@ void edi_parser_segment_events
 	      /* FIXME - flag a warning or error here */
 	    }
 	  
-	  c = token->cdata;
+	  c = (char *) edi_token_cooked(token);
 	  edi_parameters_set_one(px, Code, c);
           edi_parameters_set_one(px, Name, edi_directory_segment_name(d, c));
           edi_parameters_set_one(px, Desc, edi_directory_segment_desc(d, c));
           edi_parameters_set_one(px, Note, edi_directory_segment_note(d, c));
 	  
 	  edi_parser_handle_start (self, EDI_SEGMENT, px);
-	  strncpy(elem_info.tag, token->cdata, EDI_TOKEN_MAX);
+	  strncpy(elem_info.tag, c, EDI_TOKEN_MAX);
 	  elem_info.tag[EDI_TOKEN_MAX] = '\0';
 	}
       
@@ -1122,7 +1542,7 @@ void edi_parser_segment_events
 	  break;
 
 	case EDI_TTS:
-	  edi_parser_handle_separator(self, EDI_TS, token->rdata[0]);
+	  edi_parser_handle_separator(self, EDI_TS, edi_token_raw(token)[0]);
 	  break;
 
 	case EDI_TES:
@@ -1131,17 +1551,17 @@ void edi_parser_segment_events
 	      elem_info.e++;
 	      elem_info.s = 0;
 	    }
-	  edi_parser_handle_separator(self, EDI_ES, token->rdata[0]);
+	  edi_parser_handle_separator(self, EDI_ES, edi_token_raw(token)[0]);
 	  break;
 	  
 	case EDI_TSS:
 	  if(token->first)
 	    elem_info.s++;
-	  edi_parser_handle_separator(self, EDI_SS, token->rdata[0]);
+	  edi_parser_handle_separator(self, EDI_SS, edi_token_raw(token)[0]);
 	  break;
 	  
 	case EDI_TST:
-	  edi_parser_handle_separator(self, EDI_ST, token->rdata[0]);
+	  edi_parser_handle_separator(self, EDI_ST, edi_token_raw(token)[0]);
 
 	  if(token->last)
 	    edi_parser_handle_end (self, EDI_SEGMENT, NULL);
@@ -1150,8 +1570,6 @@ void edi_parser_segment_events
 	default:
 	  break;
 	}      
-
-      free(token);
     }
 }
 
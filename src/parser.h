@@ -22,6 +22,8 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+typedef struct edi_pipeline_s edi_pipeline_t;
+
 typedef void (*edi_syntax_fini_t) (edi_parser_t *);
 typedef edi_parameters_t* (*edi_parser_info_t) (edi_parser_t *);
 
@@ -70,21 +72,39 @@ struct edi_parser_s
   
   /* maybe put these in a struct? */
   edi_syntax_fini_t syntax_fini;
+  edi_syntax_fini_t syntax_reset;
   edi_syntax_sgmnt_t sgmnt_handler;
 
+  /* counts a message parsed by another parser into the envelope, if
+     the syntax allows messages to be parsed apart from it */
+  edi_syntax_fini_t syntax_skip;
+
+  /* the syntax module is kept from one interchange to the next */
+  edi_interchange_type_t syntax_type;
+
   edi_interchange_type_t interchange_type;
 
 
-  edi_stack_t stack;
+  /* copies of the open envelope segments, innermost last - those
+     above depth are kept for reuse */
+  edi_segment_t **stack;
+  int depth, stack_blck;
   edi_segment_t *segment;
+  int stale; /* segment is kept until the next one starts */
   edi_error_t error;
   edi_pragma_t pragma;
+  edi_scan_t scan;
   edi_advice_t *advice;
 
   unsigned long segment_count;
 
   edi_buffer_t parse_buffer;
 
+  /* an element seen whole in the parsed buffer is only a view of it */
+  const char *view;
+  unsigned long view_size;
+  char view_release;
+
   int de;
   int cde;
 
@@ -108,12 +128,28 @@ struct edi_parser_s
   edi_segment_handler_t segment_handler;
   edi_directory_handler_t directory_handler;
 
+  /* start/end handlers only want envelope and loop events */
+  int envelope_only;
+
   edi_tokeniser_t tokeniser;
-  edi_queue_t token_queue;
+  edi_token_ring_t token_ring;
+
+  /* if set, large chunks are tokenised on the calling thread and
+     parsed on another - see edi_pipeline_parse() */
+  edi_pipeline_t *pipeline;
 
   edi_directory_t *service;
   edi_directory_t *message;
 
+  /* this parser's cursor for walking transactions in the (possibly
+     shared) message directory - see edi_directory_cursor() */
+  edi_directory_t *cursor;
+
+  /* directories for messages the directory handler has none for, and
+     the one held from it for the current message */
+  edi_directory_cache_t *cache;
+  edi_directory_entry_t *cached;
+
   int done;
 };
 
@@ -121,19 +157,28 @@ struct edi_parser_s
 /* parser.c */
 void edi_parser_init(edi_parser_t *);
 void edi_parser_reset(edi_parser_t *);
+void edi_parser_recycle(edi_parser_t *);
 edi_parser_t *edi_parser_create(edi_interchange_type_t);
 void edi_parser_fini(edi_parser_t *);
 void edi_parser_free(edi_parser_t *);
 long edi_parser_parse(edi_parser_t *, char *, long, int);
-unsigned long edi_parser_get_byte_index(edi_parser_t *);
+long edi_parser_parse_views(edi_parser_t *, char *, long, int);
+void edi_parser_detach(edi_parser_t *);
+edi_offset_t edi_parser_get_byte_index(edi_parser_t *);
 unsigned long edi_parser_get_segment_index(edi_parser_t *);
+unsigned long edi_parser_get_allocation_count(edi_parser_t *);
+unsigned long edi_parser_get_high_water(edi_parser_t *);
+int edi_parser_reserve(edi_parser_t *, unsigned long);
 int edi_parser_get_error_code(edi_parser_t *);
 edi_interchange_type_t edi_parser_interchange_type(edi_parser_t *);
 edi_parameters_t *edi_parser_info(edi_parser_t *);
 edi_directory_t *edi_parser_service(edi_parser_t *);
 edi_directory_t *edi_parser_message(edi_parser_t *);
 edi_pragma_t edi_set_pragma_t(edi_parser_t *, edi_pragma_t);
+edi_scan_t edi_parser_set_scan(edi_parser_t *, edi_scan_t);
+int edi_parser_set_pipeline(edi_parser_t *, int);
 int edi_parser_is_complete(edi_parser_t *);
+int edi_parser_skip_message(edi_parser_t *);
 edi_error_t edi_parser_raise_error(edi_parser_t *, edi_error_t);
 void edi_parser_handle_segment(edi_parser_t *, edi_parameters_t *, edi_directory_t *);
 edi_directory_t *edi_parser_handle_directory(edi_parser_t *, edi_parameters_t *);
@@ -155,6 +200,7 @@ edi_error_handler_t edi_parser_set_error_handler(edi_parser_t *, edi_error_handl
 edi_error_handler_t edi_parser_set_warning_handler(edi_parser_t *, edi_error_handler_t);
 edi_token_handler_t edi_parser_set_token_handler(edi_parser_t *, edi_token_handler_t);
 edi_directory_handler_t edi_parser_set_directory_handler(edi_parser_t *, edi_directory_handler_t);
+void edi_parser_set_directory_cache(edi_parser_t *, edi_directory_cache_t *);
 edi_segment_handler_t edi_parser_set_segment_handler(edi_parser_t *, edi_segment_handler_t);
 edi_character_handler_t edi_parser_set_text_handler(edi_parser_t *, edi_character_handler_t);
 edi_character_handler_t edi_parser_set_default_handler(edi_parser_t *, edi_character_handler_t);
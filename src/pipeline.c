@@ -0,0 +1,607 @@
+/*
+
+  The MEDICI Electronic Data Interchange Library
+  Copyright (C) 2002  David Coles
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "internal.h"
+
+/** \file pipeline.c
+
+    \brief Splits the parse of a stream between two threads.
+
+    The tokeniser runs on the calling thread and queues a copy of each
+    token in a ring, from which a second thread takes them and does
+    the rest of the work of the parser - building segments, checking
+    them against the syntax and message directories and calling the
+    application's handlers - so that a single large stream can be
+    parsed on two cores.
+
+    The parser tells the tokeniser a few things as it goes: whether
+    an interchange has ended, whether it has had an error, and - when
+    the type of the stream is recognised or its service string advice
+    is read - the tokeniser calls back into it. At each of those
+    points the tokeniser waits for the parser to catch up with it, so
+    that everything happens as it would on one thread. The tokeniser
+    only has to wait at the few segments which could end an
+    interchange, as an error just has it throw away the tokens queued
+    after it.
+
+    The parser's thread is started with the first chunk and lasts as
+    long as the pipeline, sleeping while there is nothing to parse.
+
+*/
+
+/**
+   \defgroup edi_pipeline edi_pipeline
+   \{
+*/
+
+
+#if defined(__GNUC__) && (defined(__unix__) || defined(__APPLE__))
+#define EDI_PIPELINE_THREADS
+#include <pthread.h>
+#include <sched.h>
+#define edi_pipeline_load(p) __atomic_load_n ((p), __ATOMIC_ACQUIRE)
+#define edi_pipeline_store(p,v) __atomic_store_n ((p), (v), __ATOMIC_RELEASE)
+#define edi_pipeline_fence() __atomic_thread_fence (__ATOMIC_SEQ_CST)
+#define edi_pipeline_yield() sched_yield ()
+#else
+/* no threads, so no pipeline */
+#define edi_pipeline_load(p) (*(p))
+#define edi_pipeline_store(p,v) (*(p) = (v))
+#endif
+
+/* longest segment tag looked for as a possible interchange trailer */
+#define EDI_PIPELINE_TAG 4
+
+/* times the parser's thread looks for more tokens before sleeping */
+#define EDI_PIPELINE_SPIN 256
+
+/* the tokeniser makes sure the parser is awake, and the parser that
+   the tokeniser is, every so many tokens */
+#define EDI_PIPELINE_WAKE 256
+
+
+/* the tokeniser and the parser share one ring; head and tail count
+   the tokens taken by the parser and queued by the tokeniser */
+struct edi_pipeline_s
+{
+  edi_parser_t *parser;
+
+  edi_token_slot_t *slot;
+  edi_offset_t *offset; /* of each queued token in the stream */
+  unsigned long head, tail;
+
+  /* non-zero while a chunk is being parsed through the pipeline -
+     with the parser's handlers on the other thread */
+  int active;
+
+  /* set by the parser once it has an error, which stops the
+     tokeniser after the character at stop */
+  int halt;
+  edi_offset_t stop;
+
+  /* the position of the token being parsed, which is that of the
+     parser while use_at is set */
+  edi_offset_t at;
+  int use_at;
+
+  /* the tag of the interchange trailer of the syntax being parsed
+     (NULL if it isn't known) and of the current segment */
+  const char *trailer;
+  char tag[EDI_PIPELINE_TAG + 1];
+  int tagged;
+
+  /* the tokeniser's handlers, while the pipeline's stand in */
+  edi_token_handler_t token_handler;
+  edi_itype_handler_t itype_handler;
+  edi_error_handler_t error_handler;
+  edi_cmplt_handler_t cmplt_handler;
+
+#if defined(EDI_PIPELINE_THREADS)
+  pthread_t thread;
+  int started, quit, sleeping, waiting;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+#endif
+};
+
+
+/**
+   \brief Creates a pipeline for a parser.
+   \param parser Pointer to the parser.
+   \return Pointer to the pipeline, or NULL on failure - or if there
+   are no threads to run one on.
+*/
+edi_pipeline_t *
+edi_pipeline_create (edi_parser_t *parser)
+{
+#if defined(EDI_PIPELINE_THREADS)
+  edi_pipeline_t *self;
+  unsigned int n;
+
+  if (!(self = calloc (1, sizeof (edi_pipeline_t))))
+    return NULL;
+
+  if (!(self->slot = malloc (EDI_PIPELINE_DEPTH * sizeof (edi_token_slot_t))) ||
+      !(self->offset = malloc (EDI_PIPELINE_DEPTH * sizeof (edi_offset_t))))
+    {
+      free (self->slot);
+      free (self);
+      return NULL;
+    }
+
+  for (n = 0; n < EDI_PIPELINE_DEPTH; n++)
+    edi_buffer_init (&(self->slot[n].data));
+
+  pthread_mutex_init (&(self->lock), NULL);
+  pthread_cond_init (&(self->wake), NULL);
+  self->parser = parser;
+
+  return self;
+#else
+  return NULL;
+#endif
+}
+
+#if defined(EDI_PIPELINE_THREADS)
+/* makes sure the parser's thread isn't asleep, if it has been started */
+static void
+edi_pipeline_wake (edi_pipeline_t *self)
+{
+  /* the parser sets sleeping before it looks at the tail one last
+     time, and this has set the tail, so one or other will see it */
+  edi_pipeline_fence ();
+
+  /* both threads sleep on wake, so all of its waiters are woken */
+  if (edi_pipeline_load (&(self->sleeping)))
+    {
+      pthread_mutex_lock (&(self->lock));
+      pthread_cond_broadcast (&(self->wake));
+      pthread_mutex_unlock (&(self->lock));
+    }
+}
+
+/* makes sure the tokeniser isn't asleep waiting for the parser - the
+   other side of edi_pipeline_wait() */
+static void
+edi_pipeline_release (edi_pipeline_t *self)
+{
+  edi_pipeline_fence ();
+
+  if (edi_pipeline_load (&(self->waiting)))
+    {
+      pthread_mutex_lock (&(self->lock));
+      pthread_cond_broadcast (&(self->wake));
+      pthread_mutex_unlock (&(self->lock));
+    }
+}
+#endif
+
+/**
+   \brief Frees a pipeline, stopping the parser's thread.
+   \param self Pointer to the pipeline.
+*/
+void
+edi_pipeline_free (edi_pipeline_t *self)
+{
+  unsigned int n;
+
+  if (!self)
+    return;
+
+#if defined(EDI_PIPELINE_THREADS)
+  if (self->started)
+    {
+      edi_pipeline_store (&(self->quit), 1);
+      edi_pipeline_wake (self);
+      pthread_join (self->thread, NULL);
+    }
+
+  pthread_mutex_destroy (&(self->lock));
+  pthread_cond_destroy (&(self->wake));
+#endif
+
+  for (n = 0; n < EDI_PIPELINE_DEPTH; n++)
+    edi_buffer_clear (&(self->slot[n].data));
+
+  free (self->slot);
+  free (self->offset);
+  free (self);
+}
+
+/**
+   \brief Readies a pipeline for a new interchange.
+   \param self Pointer to the pipeline.
+
+   Called by edi_parser_reset().
+*/
+void
+edi_pipeline_reset (edi_pipeline_t *self)
+{
+  self->halt = 0;
+  self->use_at = 0;
+  self->trailer = NULL;
+  self->tagged = 0;
+}
+
+/**
+   \brief Non-zero while the parser's handlers are being called on the
+   pipeline's thread - when the tokeniser belongs to the other one.
+   \param self Pointer to the pipeline.
+*/
+int
+edi_pipeline_active (edi_pipeline_t *self)
+{
+  return self->active;
+}
+
+/**
+   \brief Gives the position in the stream of the token being parsed,
+   or at which the parser had an error.
+   \param self Pointer to the pipeline.
+   \param offset Where to store the position.
+   \return Zero if the tokeniser's position is the parser's.
+*/
+int
+edi_pipeline_offset (edi_pipeline_t *self, edi_offset_t *offset)
+{
+  if (!self->use_at)
+    return 0;
+
+  *offset = self->at;
+  return 1;
+}
+
+/**
+   \brief Stops the tokeniser after the current token's character.
+   \param self Pointer to the pipeline.
+
+   Called by edi_parser_raise_error() in place of setting the error of
+   the tokeniser, which belongs to the other thread.
+*/
+void
+edi_pipeline_halt (edi_pipeline_t *self)
+{
+  if (edi_pipeline_load (&(self->halt)))
+    return;
+
+  self->stop = self->at;
+  edi_pipeline_store (&(self->halt), 1);
+}
+
+#if defined(EDI_PIPELINE_THREADS)
+/* sleeps until there are tokens after head, returning zero if the
+   pipeline is being freed */
+static int
+edi_pipeline_sleep (edi_pipeline_t *self, unsigned long head)
+{
+  pthread_mutex_lock (&(self->lock));
+  edi_pipeline_store (&(self->sleeping), 1);
+  edi_pipeline_fence ();
+
+  while (edi_pipeline_load (&(self->tail)) == head &&
+	 !edi_pipeline_load (&(self->quit)))
+    pthread_cond_wait (&(self->wake), &(self->lock));
+
+  edi_pipeline_store (&(self->sleeping), 0);
+  pthread_mutex_unlock (&(self->lock));
+
+  return edi_pipeline_load (&(self->tail)) != head ||
+    !edi_pipeline_load (&(self->quit));
+}
+
+/* the parser's thread - parses tokens as they are queued */
+static void *
+edi_pipeline_run (void *v)
+{
+  edi_pipeline_t *self = (edi_pipeline_t *) v;
+  unsigned long head = self->head, tail, n;
+  unsigned int idle = 0;
+
+  for (;;)
+    {
+      if ((tail = edi_pipeline_load (&(self->tail))) == head)
+	{
+	  if (edi_pipeline_load (&(self->quit)))
+	    break;
+
+	  if (++idle < EDI_PIPELINE_SPIN)
+	    edi_pipeline_yield ();
+	  else if (!edi_pipeline_sleep (self, head))
+	    break;
+	  else
+	    idle = 0;
+	  continue;
+	}
+
+      for (idle = 0; head != tail; head++)
+	{
+	  n = head % EDI_PIPELINE_DEPTH;
+
+	  /* once there is an error only the tokens of the character it
+	     was found at are parsed, as the tokeniser would have
+	     stopped there */
+	  if (!edi_pipeline_load (&(self->halt)) ||
+	      self->offset[n] <= self->stop)
+	    {
+	      self->at = self->offset[n];
+	      self->use_at = 1;
+	      edi_parser_token_handler (self->parser,
+					&(self->slot[n].token));
+	    }
+
+	  edi_pipeline_store (&(self->head), head + 1);
+
+	  if (!((head + 1) % EDI_PIPELINE_WAKE))
+	    edi_pipeline_release (self);
+	}
+
+      edi_pipeline_release (self);
+    }
+
+  return NULL;
+}
+
+/* sleeps until no more than queued tokens are left in the ring - the
+   tokeniser sets waiting before it looks at the head, and the parser
+   sets the head before it looks at waiting, so one or other will see
+   it */
+static void
+edi_pipeline_wait (edi_pipeline_t *self, unsigned long queued)
+{
+  edi_pipeline_wake (self);
+
+  pthread_mutex_lock (&(self->lock));
+  edi_pipeline_store (&(self->waiting), 1);
+  edi_pipeline_fence ();
+
+  while (self->tail - edi_pipeline_load (&(self->head)) > queued)
+    pthread_cond_wait (&(self->wake), &(self->lock));
+
+  edi_pipeline_store (&(self->waiting), 0);
+  pthread_mutex_unlock (&(self->lock));
+}
+
+/* waits for the parser to take every token queued, and stops the
+   tokeniser if the parser has had an error - after which the parser
+   is idle, and can be called from this thread */
+static void
+edi_pipeline_sync (edi_pipeline_t *self)
+{
+  edi_parser_t *parser = self->parser;
+
+  if (edi_pipeline_load (&(self->head)) != self->tail)
+    edi_pipeline_wait (self, 0);
+
+  if (!edi_pipeline_load (&(self->halt)))
+    self->use_at = 0;
+  else if (!edi_tokeniser_error (&(parser->tokeniser)))
+    edi_tokeniser_set_error (&(parser->tokeniser), parser->error);
+}
+
+/* the tag of the segment which ends an interchange of a syntax */
+static const char *
+edi_pipeline_trailer (edi_interchange_type_t type)
+{
+  switch (type)
+    {
+    case EDI_EDIFACT:
+      return "UNZ";
+
+    case EDI_X12:
+      return "IEA";
+
+    case EDI_UNGTDI:
+    case EDI_IMP:
+      return "END";
+
+    default:
+      return NULL;
+    }
+}
+
+/* notes the tag of each segment, returning non-zero at the end of one
+   which could end the interchange */
+static int
+edi_pipeline_tag (edi_pipeline_t *self, edi_token_t *token)
+{
+  switch (token->type)
+    {
+    case EDI_TTG:
+    case EDI_TEL:
+      if (self->tagged)
+	return 0;
+
+      self->tagged = 1;
+      self->tag[0] = '\0';
+
+      if (token->first && token->last && token->csize <= EDI_PIPELINE_TAG)
+	{
+	  memcpy (self->tag, edi_token_cooked (token), token->csize);
+	  self->tag[token->csize] = '\0';
+	}
+      return 0;
+
+    case EDI_TST:
+      self->tagged = 0;
+      return !self->trailer || !strcmp (self->tag, self->trailer);
+
+    default:
+      return 0;
+    }
+}
+
+/* stands in for edi_parser_token_handler(), queueing the token for
+   the other thread */
+static int
+edi_pipeline_token (void *v, edi_token_t *token)
+{
+  edi_parser_t *parser = (edi_parser_t *) v;
+  edi_pipeline_t *self = parser->pipeline;
+  edi_offset_t offset = edi_tokeniser_byte_count (&(parser->tokeniser));
+  unsigned long n;
+  int end;
+
+  if (edi_pipeline_load (&(self->halt)) && offset > self->stop)
+    {
+      edi_pipeline_sync (self);
+      return parser->done;
+    }
+
+  end = edi_pipeline_tag (self, token);
+
+  if (self->tail - edi_pipeline_load (&(self->head)) == EDI_PIPELINE_DEPTH)
+    edi_pipeline_wait (self, EDI_PIPELINE_DEPTH - 1);
+
+  n = self->tail % EDI_PIPELINE_DEPTH;
+
+  if (!edi_token_slot_copy (self->slot + n, token))
+    {
+      edi_pipeline_sync (self);
+      edi_parser_raise_error (parser, EDI_ENOMEM);
+      edi_pipeline_sync (self);
+      return parser->done;
+    }
+
+  self->offset[n] = offset;
+  edi_pipeline_store (&(self->tail), self->tail + 1);
+
+  if (!(self->tail % EDI_PIPELINE_WAKE))
+    edi_pipeline_wake (self);
+
+  /* the tokeniser mustn't run on past the end of the interchange, or
+     change the advice while the parser is reading it */
+  if (end || token->type == EDI_TSA)
+    {
+      edi_pipeline_sync (self);
+      return parser->done;
+    }
+
+  return 0;
+}
+
+static void
+edi_pipeline_itype (void *v, edi_interchange_type_t type)
+{
+  edi_parser_t *parser = (edi_parser_t *) v;
+  edi_pipeline_t *self = parser->pipeline;
+
+  edi_pipeline_sync (self);
+  self->itype_handler (v, type);
+  self->trailer = edi_pipeline_trailer (type);
+}
+
+static void
+edi_pipeline_error (void *v, edi_error_t error)
+{
+  edi_parser_t *parser = (edi_parser_t *) v;
+
+  edi_pipeline_sync (parser->pipeline);
+  parser->pipeline->error_handler (v, error);
+}
+
+static void
+edi_pipeline_cmplt (void *v)
+{
+  edi_parser_t *parser = (edi_parser_t *) v;
+
+  edi_pipeline_sync (parser->pipeline);
+  parser->pipeline->cmplt_handler (v);
+}
+
+/* puts the pipeline's handlers in place of the parser's, or back */
+static void
+edi_pipeline_swap (edi_pipeline_t *self, edi_tokeniser_t *tokeniser, int on)
+{
+  if (on)
+    {
+      self->token_handler = tokeniser->token_handler;
+      self->itype_handler = tokeniser->itype_handler;
+      self->error_handler = tokeniser->error_handler;
+      self->cmplt_handler = tokeniser->cmplt_handler;
+
+      tokeniser->token_handler = edi_pipeline_token;
+      tokeniser->itype_handler = edi_pipeline_itype;
+      tokeniser->error_handler = edi_pipeline_error;
+      tokeniser->cmplt_handler = edi_pipeline_cmplt;
+    }
+  else
+    {
+      tokeniser->token_handler = self->token_handler;
+      tokeniser->itype_handler = self->itype_handler;
+      tokeniser->error_handler = self->error_handler;
+      tokeniser->cmplt_handler = self->cmplt_handler;
+    }
+}
+#endif
+
+/**
+   \brief Parses a chunk of a stream through the pipeline.
+   \param parser Pointer to the parser, which has a pipeline.
+   \param buffer The chunk.
+   \param length Length in characters of the chunk.
+   \param done Non-zero if this is the last chunk in the stream.
+   \return Number of characters consumed by the tokeniser.
+
+   As edi_parser_parse_views(), but the parser's handlers are called
+   on the pipeline's thread, which has finished with the chunk when
+   this returns. The tokens are copied, so the segment is left with no
+   views of the chunk. After an error the tokeniser may have consumed
+   more of the chunk than it would otherwise, but the parser's byte
+   index is still that of the error.
+*/
+long
+edi_pipeline_parse (edi_parser_t *parser, char *buffer, long length,
+		    int done)
+{
+  edi_tokeniser_t *tokeniser = &(parser->tokeniser);
+#if defined(EDI_PIPELINE_THREADS)
+  edi_pipeline_t *self = parser->pipeline;
+  long n;
+
+  if (edi_tokeniser_error (tokeniser))
+    return 0;
+
+  /* no thread, so the chunk is parsed on this one */
+  if (!self->started &&
+      !(self->started = !pthread_create (&(self->thread), NULL,
+					 edi_pipeline_run, self)))
+    return edi_tokeniser_parse (tokeniser, buffer, length, done);
+
+  self->halt = 0;
+  self->active = 1;
+  edi_pipeline_swap (self, tokeniser, 1);
+
+  n = edi_tokeniser_parse (tokeniser, buffer, length, done);
+  edi_pipeline_sync (self);
+
+  edi_pipeline_swap (self, tokeniser, 0);
+  self->active = 0;
+
+  return n;
+#else
+  return edi_tokeniser_parse (tokeniser, buffer, length, done);
+#endif
+}
+
+/** \} */
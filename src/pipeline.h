@@ -0,0 +1,41 @@
+/*
+
+  The MEDICI Electronic Data Interchange Library
+  Copyright (C) 2002  David Coles
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+/* number of tokens the tokeniser may run ahead of the parser */
+#define EDI_PIPELINE_DEPTH 4096
+
+/* chunks shorter than this are parsed on the calling thread, as
+   handing the tokens over would cost more than it could save */
+#define EDI_PIPELINE_MIN 16384
+
+/* pipeline.c */
+edi_pipeline_t *edi_pipeline_create(edi_parser_t *);
+void edi_pipeline_free(edi_pipeline_t *);
+void edi_pipeline_reset(edi_pipeline_t *);
+int edi_pipeline_active(edi_pipeline_t *);
+int edi_pipeline_offset(edi_pipeline_t *, edi_offset_t *);
+void edi_pipeline_halt(edi_pipeline_t *);
+long edi_pipeline_parse(edi_parser_t *, char *, long, int);
+
+#endif /*PIPELINE_H*/
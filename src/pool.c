@@ -0,0 +1,142 @@
+/*
+
+  The MEDICI Electronic Data Interchange Library
+  Copyright (C) 2002  David Coles
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "internal.h"
+
+/** \file pool.c
+
+    \brief A thread-safe pool of reusable parsers.
+
+    The list of parsers is guarded by a mutex, which is only held
+    for long enough to take a parser from, or add one to, the list;
+    parsers are reset, created and freed outside of it.
+
+*/
+
+/**
+   \defgroup edi_parser_pool edi_parser_pool
+   \{
+*/
+
+
+/**
+   \brief Creates a pool of parsers.
+   \param size The most parsers the pool will keep for reuse.
+   \return Pointer to the pool, or NULL on failure.
+*/
+edi_parser_pool_t *
+edi_parser_pool_create (unsigned int size)
+{
+  edi_parser_pool_t *self;
+
+  if (!(self = (edi_parser_pool_t *) malloc (sizeof (edi_parser_pool_t))))
+    return NULL;
+
+  memset (self, 0, sizeof (edi_parser_pool_t));
+  self->size = size;
+
+  if (size && !(self->parser = malloc (size * sizeof (edi_parser_t *))))
+    {
+      free (self);
+      return NULL;
+    }
+
+  edi_lock_init (&(self->lock));
+
+  return self;
+}
+
+/**
+   \brief Frees a pool and the parsers in it.
+   \param self Pointer to the pool.
+
+   Parsers which are still checked out are not affected, and should
+   be freed with edi_parser_free().
+*/
+void
+edi_parser_pool_free (edi_parser_pool_t *self)
+{
+  unsigned int n;
+
+  if (!self)
+    return;
+
+  for (n = 0; n < self->count; n++)
+    edi_parser_free (self->parser[n]);
+
+  edi_lock_destroy (&(self->lock));
+  free (self->parser);
+  free (self);
+}
+
+/**
+   \brief Checks a parser out of a pool.
+   \param self Pointer to the pool.
+   \return Pointer to the parser, or NULL on failure.
+
+   A parser is created if there are none in the pool.
+*/
+edi_parser_t *
+edi_parser_pool_get (edi_parser_pool_t *self)
+{
+  edi_parser_t *parser = NULL;
+
+  edi_lock (&(self->lock));
+  if (self->count)
+    parser = self->parser[--self->count];
+  edi_unlock (&(self->lock));
+
+  return parser ? parser : edi_parser_create (EDI_UNKNOWN);
+}
+
+/**
+   \brief Checks a parser back in to a pool.
+   \param self Pointer to the pool.
+   \param parser Pointer to the parser, which must not be used again
+   by the caller.
+
+   The parser is recycled (see edi_parser_recycle()), or freed if the
+   pool is full.
+*/
+void
+edi_parser_pool_put (edi_parser_pool_t *self, edi_parser_t *parser)
+{
+  if (!parser)
+    return;
+
+  edi_parser_recycle (parser);
+
+  edi_lock (&(self->lock));
+  if (self->count < self->size)
+    {
+      self->parser[self->count++] = parser;
+      parser = NULL;
+    }
+  edi_unlock (&(self->lock));
+
+  if (parser)
+    edi_parser_free (parser);
+}
+
+/** \} */
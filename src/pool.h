@@ -0,0 +1,50 @@
+/*
+
+  The MEDICI Electronic Data Interchange Library
+  Copyright (C) 2002  David Coles
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+#ifndef POOL_H
+#define POOL_H
+
+/**
+   \brief A pool of parsers
+
+   Parsers are checked in to the pool once they are finished with and
+   checked out again, as good as new but with their memory and syntax
+   module kept, instead of being freed and created. The pool may be
+   shared between threads.
+*/
+typedef struct
+{
+  /** \brief Parsers waiting to be checked out */
+  edi_parser_t **parser;
+  unsigned int count, size;
+
+  /** \brief Held while a thread is using the list of parsers */
+  edi_lock_t lock;
+}
+edi_parser_pool_t;
+
+/* pool.c */
+edi_parser_pool_t *edi_parser_pool_create(unsigned int);
+void edi_parser_pool_free(edi_parser_pool_t *);
+edi_parser_t *edi_parser_pool_get(edi_parser_pool_t *);
+void edi_parser_pool_put(edi_parser_pool_t *, edi_parser_t *);
+
+#endif /*POOL_H*/
@@ -36,6 +36,9 @@
    \{
 */
 
+/* marks a parameter whose value is to be resolved when asked for */
+static const char edi_parameters_deferred[] = "";
+
 
 /**
    \brief Set edi_parameters_t fields to the list of key, value pairs.
@@ -62,6 +65,9 @@ edi_parameters_set (edi_parameters_t *p, ...)
   for (key = LastParameter; key < MaxParameter; key++)
     p->value[key] = NULL;
 
+  p->resolver = NULL;
+  p->context = NULL;
+
   va_start (ap, p);
   while ((key = va_arg (ap, edi_parameter_t)))
     p->value[key] = va_arg (ap, char *);
@@ -91,6 +97,38 @@ void edi_parameters_set_one
 
 
 
+/**
+   \brief Defer the values of a list of keys until they are queried.
+   
+   \param p Pointer to the edi_parameters_t structure to modify.
+   \param r Function which will supply the value of a key.
+   \param c Context for the function, available as p->context.
+   \param ... List of keys, punctuated with a trailing LastParameter.
+   
+   Work to find values which the application may never ask for can
+   be avoided. The resolver is called at most once for each key, the
+   first time edi_parameters_get() is called for it, so must only be
+   relied upon while the context is valid.
+*/
+
+void
+edi_parameters_defer
+(edi_parameters_t *p, edi_parameters_resolver_t r, void *c, ...)
+{
+  unsigned int key;
+  va_list ap;
+
+  p->resolver = r;
+  p->context = c;
+
+  va_start (ap, c);
+  while ((key = va_arg (ap, edi_parameter_t)))
+    p->value[key] = edi_parameters_deferred;
+  va_end (ap);
+}
+
+
+
 /**
    \brief Query the value of an edi_parameters_t key.
    
@@ -108,6 +146,9 @@ void edi_parameters_set_one
 const char *
 edi_parameters_get (edi_parameters_t *p, edi_parameter_t k)
 {
+  if (p->value[k] == edi_parameters_deferred)
+    p->value[k] = p->resolver ? p->resolver (p, k) : NULL;
+
   return p->value[k];
 }
 
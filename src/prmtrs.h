@@ -107,16 +107,24 @@ typedef enum
 edi_parameter_t;
 
 
-typedef struct edi_parameters_s
+typedef struct edi_parameters_s edi_parameters_t;
+
+/* supplies the value of a deferred parameter when it is first asked for */
+typedef const char *(*edi_parameters_resolver_t)
+     (edi_parameters_t *, edi_parameter_t);
+
+struct edi_parameters_s
 {
   const char *value[MaxParameter];
   unsigned int element, subelement;
-}
-edi_parameters_t;
+  edi_parameters_resolver_t resolver;
+  void *context;
+};
 
 
 void edi_parameters_set(edi_parameters_t *, ...);
 void edi_parameters_set_one(edi_parameters_t *, edi_parameter_t, const char *);
+void edi_parameters_defer(edi_parameters_t *, edi_parameters_resolver_t, void *, ...);
 const char *edi_parameters_get(edi_parameters_t *, edi_parameter_t);
 const char *edi_parameters_get_string(edi_parameter_t);
 
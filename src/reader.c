@@ -0,0 +1,344 @@
+/*
+
+  The MEDICI Electronic Data Interchange Library
+  Copyright (C) 2002  David Coles
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "internal.h"
+
+/** \file reader.c
+
+    \brief A pull interface to the parser.
+
+    The parser's handlers queue the events for a segment and pause the
+    tokeniser at the end of it; events are then handed out one at a
+    time, and the parser resumed only when the queue is empty.
+
+*/
+
+/**
+   \defgroup edi_reader edi_reader
+   \{
+*/
+
+
+static edi_reader_entry_t *
+edi_reader_queue (edi_reader_t *self, edi_event_t type, int end)
+{
+  edi_reader_entry_t *entry;
+  void *ptr;
+  unsigned int blck;
+
+  if (self->count == self->blck)
+    {
+      blck = self->blck ? self->blck * 2 : 16;
+      if (!(ptr = realloc (self->queue, blck * sizeof (edi_reader_entry_t))))
+	{
+	  edi_parser_raise_error (&(self->parser), EDI_ENOMEM);
+	  return NULL;
+	}
+      self->queue = ptr;
+      self->blck = blck;
+    }
+
+  entry = self->queue + self->count++;
+  memset (&(entry->event), 0, sizeof (entry->event));
+  entry->event.type = type;
+  entry->event.end = end;
+
+  return entry;
+}
+
+static void
+edi_reader_start_handler (void *v, edi_event_t event, edi_parameters_t *p)
+{
+  edi_reader_t *self = (edi_reader_t *) v;
+  edi_reader_entry_t *entry;
+  edi_parameter_t k;
+
+  if (!(entry = edi_reader_queue (self, event, 0)))
+    return;
+
+  /* the values point into the segment or directories, which outlive
+     the event, but anything deferred must be resolved now */
+  edi_parameters_set (&(entry->parameters), LastParameter);
+  if (p)
+    {
+      for (k = MinParameter; k < MaxParameter; k++)
+	edi_parameters_set_one (&(entry->parameters), k,
+				edi_parameters_get (p, k));
+      entry->parameters.element = p->element;
+      entry->parameters.subelement = p->subelement;
+    }
+}
+
+static void
+edi_reader_end_handler (void *v, edi_event_t event)
+{
+  edi_reader_queue ((edi_reader_t *) v, event, 1);
+}
+
+static void
+edi_reader_segment_handler (void *v, edi_parameters_t *p,
+			    edi_segment_t *segment, edi_directory_t *d)
+{
+  edi_reader_t *self = (edi_reader_t *) v;
+  edi_reader_entry_t *entry;
+
+  if ((entry = edi_reader_queue (self, EDI_SEGMENT, 0)))
+    {
+      entry->event.segment = segment;
+      entry->event.directory = d;
+    }
+
+  /* stop once this segment's events have been generated */
+  edi_tokeniser_pause (&(self->parser.tokeniser));
+}
+
+static edi_directory_t *
+edi_reader_directory_handler (void *v, edi_parameters_t *p)
+{
+  edi_reader_t *self = (edi_reader_t *) v;
+
+  return self->directory_handler ?
+    self->directory_handler (self->user_data, p) : NULL;
+}
+
+static edi_reader_t *
+edi_reader_init (edi_reader_t *self)
+{
+  memset (self, 0, sizeof (edi_reader_t));
+
+  edi_parser_init (&(self->parser));
+  edi_parser_set_user_data (&(self->parser), self);
+  edi_parser_set_start_handler (&(self->parser), edi_reader_start_handler);
+  edi_parser_set_end_handler (&(self->parser), edi_reader_end_handler);
+  edi_parser_set_segment_handler (&(self->parser),
+				  edi_reader_segment_handler);
+  edi_parser_set_directory_handler (&(self->parser),
+				    edi_reader_directory_handler);
+
+  /* segments and elements come from the segment itself */
+  self->parser.envelope_only = 1;
+
+  return self;
+}
+
+/**
+   \brief Creates a reader for a stream held in memory.
+   \param data The stream, which must remain valid while it is read.
+   \param size The number of characters in the stream.
+   \return Pointer to the reader, or NULL on failure.
+*/
+edi_reader_t *
+edi_reader_create (char *data, unsigned long size)
+{
+  edi_reader_t *self;
+
+  if (!(self = (edi_reader_t *) malloc (sizeof (edi_reader_t))))
+    return NULL;
+
+  edi_reader_init (self);
+  self->data = data;
+  self->size = size;
+
+  return self;
+}
+
+/**
+   \brief Creates a reader for a stream supplied by a function.
+   \param input Function which reads the next part of the stream.
+   \param user Argument to the function.
+   \return Pointer to the reader, or NULL on failure.
+*/
+edi_reader_t *
+edi_reader_create_input (edi_reader_input_t input, void *user)
+{
+  edi_reader_t *self;
+
+  if (!(self = (edi_reader_t *) malloc (sizeof (edi_reader_t))))
+    return NULL;
+
+  edi_reader_init (self);
+
+  if (!(self->chunk = malloc (EDI_READER_CHUNK)))
+    {
+      edi_reader_free (self);
+      return NULL;
+    }
+
+  self->input = input;
+  self->input_data = user;
+  self->data = self->chunk;
+
+  return self;
+}
+
+/**
+   \brief Frees a reader and its parser.
+   \param self Pointer to the reader.
+*/
+void
+edi_reader_free (edi_reader_t *self)
+{
+  if (!self)
+    return;
+
+  edi_parser_fini (&(self->parser));
+  free (self->queue);
+  free (self->chunk);
+  free (self);
+}
+
+/**
+   \brief Sets the function asked for the directory of a transaction.
+   \param self Pointer to the reader.
+   \param h The handler.
+   \param user Argument to the handler.
+*/
+void
+edi_reader_set_directory_handler (edi_reader_t *self,
+				  edi_directory_handler_t h, void *user)
+{
+  self->directory_handler = h;
+  self->user_data = user;
+}
+
+/**
+   \brief Returns the error which stopped the reader, if any.
+   \param self Pointer to the reader.
+*/
+edi_error_t
+edi_reader_error (edi_reader_t *self)
+{
+  return self->parser.error;
+}
+
+/* parse until something has been queued, or the stream runs out */
+
+static int
+edi_reader_parse (edi_reader_t *self)
+{
+  long n;
+
+  self->head = self->count = 0;
+
+  while (!self->count && !self->finished && !self->parser.error)
+    {
+      /* the last interchange is kept until its events have been read,
+	 and until something other than whitespace follows it */
+      if (edi_parser_is_complete (&(self->parser)))
+	{
+	  self->offset += edi_interchange_skip (self->data + self->offset,
+						self->size - self->offset);
+
+	  if (self->offset < self->size)
+	    edi_parser_reset (&(self->parser));
+	}
+
+      if (self->offset == self->size)
+	{
+	  /* the segment may still be looking at the old chunk */
+	  edi_parser_detach (&(self->parser));
+
+	  n = self->input ?
+	    self->input (self->input_data, self->chunk, EDI_READER_CHUNK) : 0;
+
+	  if (n <= 0)
+	    {
+	      self->finished = 1;
+
+	      if (n < 0 || (self->parser.segment_count &&
+			    !edi_parser_is_complete (&(self->parser))))
+		edi_parser_raise_error (&(self->parser), EDI_EEOF);
+	      break;
+	    }
+
+	  self->size = n;
+	  self->offset = 0;
+	  continue;
+	}
+
+      self->offset += edi_parser_parse_views (&(self->parser),
+					      self->data + self->offset,
+					      self->size - self->offset, 0);
+    }
+
+  return self->count;
+}
+
+/**
+   \brief Returns the next event from the stream.
+   \param self Pointer to the reader.
+   \return Pointer to the event, or NULL at the end of the stream or
+   on error (see edi_reader_error()).
+
+   The event, and the views of the stream it contains, are only valid
+   until the next call.
+*/
+edi_reader_event_t *
+edi_reader_next (edi_reader_t *self)
+{
+  edi_reader_entry_t *entry;
+  edi_segment_value_t *v;
+  edi_element_view_t view;
+
+  for (;;)
+    {
+      if (self->segment && self->value < self->segment->values)
+	{
+	  v = self->segment->value + self->value++;
+	  self->event.type = EDI_ELEMENT;
+	  self->event.parameters = NULL;
+	  edi_segment_value_view (self->segment, v, &view);
+	  self->event.data = view.data;
+	  self->event.size = view.size;
+	  self->event.release = view.release;
+	  self->event.element = v->element;
+	  self->event.subelement = v->component;
+	  return &(self->event);
+	}
+
+      self->segment = NULL;
+
+      if (self->head < self->count)
+	{
+	  entry = self->queue + self->head++;
+	  self->event = entry->event;
+
+	  if (!entry->event.end && entry->event.type != EDI_SEGMENT)
+	    self->event.parameters = &(entry->parameters);
+
+	  if (entry->event.type == EDI_SEGMENT)
+	    {
+	      self->segment = entry->event.segment;
+	      self->value = 0;
+	    }
+
+	  return &(self->event);
+	}
+
+      if (!edi_reader_parse (self))
+	return NULL;
+    }
+}
+
+/** \} */
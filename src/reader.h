@@ -0,0 +1,125 @@
+/*
+
+  The MEDICI Electronic Data Interchange Library
+  Copyright (C) 2002  David Coles
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+#ifndef READER_H
+#define READER_H
+
+/* size of the chunks read from an input function */
+#define EDI_READER_CHUNK 8192
+
+/* fills a buffer with up to the given number of characters, returning
+   the number read, 0 at the end of the stream or -1 on error */
+typedef long (*edi_reader_input_t) (void *, char *, long);
+
+/**
+   \brief An event pulled from a reader
+
+   Must have the same layout as EDI_ReaderEvent in medici.h.
+*/
+typedef struct
+{
+  /** \brief EDI_INTERCHANGE, EDI_GROUP, EDI_TRANSACTION, EDI_SECTION,
+      EDI_LOOP, EDI_SEGMENT or EDI_ELEMENT */
+  edi_event_t type;
+
+  /** \brief Non-zero for the end (rather than start) of a structure */
+  int end;
+
+  /** \brief Parameters for the start of a structure */
+  edi_parameters_t *parameters;
+
+  /** \brief The segment, for segment and element events */
+  edi_segment_t *segment;
+
+  /** \brief Directory which describes the segment */
+  edi_directory_t *directory;
+
+  /** \brief View of the value of an element (see edi_element_view_t) */
+  const char *data;
+  unsigned long size;
+  char release;
+
+  /** \brief Position of an element within the segment and composite */
+  int element, subelement;
+}
+edi_reader_event_t;
+
+/* a queued event, with its own copy of any parameters */
+typedef struct
+{
+  edi_reader_event_t event;
+  edi_parameters_t parameters;
+}
+edi_reader_entry_t;
+
+/**
+   \brief A pull parser
+
+   Wraps a parser which is paused after every segment, so that the
+   stream is only parsed as far as events are asked for. The views of
+   segments and element values point into the parser or the stream,
+   and remain valid until the next segment is parsed.
+*/
+typedef struct
+{
+  /** \brief The underlying parser */
+  edi_parser_t parser;
+
+  /** \brief Characters available to parse */
+  char *data;
+  unsigned long size, offset;
+
+  /** \brief Function to read more characters, or NULL for a buffer */
+  edi_reader_input_t input;
+  void *input_data;
+
+  /** \brief Buffer for characters read by input */
+  char *chunk;
+
+  /** \brief Events queued since the parser was last resumed */
+  edi_reader_entry_t *queue;
+  unsigned int head, count, blck;
+
+  /** \brief Segment whose values are being returned as elements */
+  edi_segment_t *segment;
+  int value;
+
+  /** \brief The event most recently returned */
+  edi_reader_event_t event;
+
+  /** \brief Application's directory handler and its argument */
+  edi_directory_handler_t directory_handler;
+  void *user_data;
+
+  /** \brief Non-zero once the input is exhausted */
+  int finished;
+}
+edi_reader_t;
+
+/* reader.c */
+edi_reader_t *edi_reader_create(char *, unsigned long);
+edi_reader_t *edi_reader_create_input(edi_reader_input_t, void *);
+void edi_reader_free(edi_reader_t *);
+edi_reader_event_t *edi_reader_next(edi_reader_t *);
+edi_error_t edi_reader_error(edi_reader_t *);
+void edi_reader_set_directory_handler(edi_reader_t *, edi_directory_handler_t, void *);
+
+#endif /*READER_H*/
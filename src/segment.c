@@ -28,36 +28,52 @@
 void
 edi_segment_init (edi_segment_t *s)
 {
-  int n, m;
-
+  edi_buffer_init (&(s->arena));
+  s->code = -1;
+  s->value = NULL;
+  s->values = 0;
+  s->value_blck = 0;
+  s->element = NULL;
+  s->element_blck = 0;
   s->de = 0;
-  for (n = 0; n < EDI_NELEMS; n++)
-    s->cde[n] = 0;
-
-  for (n = 0; n < EDI_NELEMS; n++)
-    for (m = 0; m < EDI_NELEMS; m++)
-      s->defined[n][m] = 0;
+  s->pending = 0;
+  s->reserve = 0;
 }
 
 void
 edi_segment_clear (edi_segment_t *self)
 {
-  int n, m;
-  
   if(!self)
     return;
   
+  /* the memory is kept for the next segment */
+  edi_buffer_reset (&(self->arena));
+  self->code = -1;
+  self->values = 0;
   self->de = 0;
-  for (n = 0; n < EDI_NELEMS; n++)
-    self->cde[n] = 0;
-  
-  for (n = 0; n < EDI_NELEMS; n++)
-    for (m = 0; m < EDI_NELEMS; m++)
-      if(self->defined[n][m])
-	{
-	  self->defined[n][m] = 0;
-	  edi_buffer_clear(&(self->elements[n][m]));
-	}
+  self->pending = 0;
+  self->reserve = 0;
+}
+
+/* give back an arena which has grown larger than limit */
+void
+edi_segment_shrink (edi_segment_t *self, unsigned long limit)
+{
+  edi_buffer_shrink (&(self->arena), limit);
+}
+
+/* make room in the arena for size bytes of code and values */
+int
+edi_segment_reserve (edi_segment_t *self, unsigned long size)
+{
+  return edi_buffer_reserve (&(self->arena), size);
+}
+
+/* the largest number of bytes the arena has held */
+unsigned long
+edi_segment_peak (edi_segment_t *self)
+{
+  return edi_buffer_peak (&(self->arena));
 }
 
 
@@ -67,7 +83,9 @@ edi_segment_free (edi_segment_t *self)
   if (!self)
     return;
   
-  edi_segment_clear (self);
+  edi_buffer_clear (&(self->arena));
+  free (self->value);
+  free (self->element);
   
   free (self);
 }
@@ -82,38 +100,299 @@ edi_segment_create (void)
   return s;
 }
 
+/* add a (terminated) string to the arena, returning its offset */
+
+static long
+edi_segment_store (edi_segment_t *s, char *c, unsigned long l)
+{
+  unsigned long offset = s->arena.size;
+
+  if((c && l && !edi_buffer_append (&(s->arena), c, l)) ||
+     !edi_buffer_append (&(s->arena), "", 1))
+    {
+      s->arena.size = offset;
+      return -1;
+    }
+
+  return offset;
+}
+
 char *
 edi_segment_get_code (edi_segment_t *s)
 {
-  return s->tag;
+  static char empty[] = "";
+
+  if (s->code < 0)
+    return empty;
+
+  /* make sure that copying the values later won't move the code */
+  if (s->pending)
+    edi_buffer_reserve (&(s->arena), s->arena.size + s->reserve);
+
+  return (char *) s->arena.data + s->code;
 }
 
 int
 edi_segment_cmp_code (edi_segment_t *s, char *c)
 {
-  return strncmp (s->tag, c, strlen (c));
+  return strncmp (edi_segment_get_code (s), c, strlen (c));
+}
+
+static edi_segment_value_t *
+edi_segment_find (edi_segment_t *s, int x, int y)
+{
+  int n;
+
+  if(x < 0 || x >= s->de)
+    return NULL;
+
+  for (n = s->element[x].first; n >= 0; n = s->value[n].next)
+    if(s->value[n].component == y)
+      return s->value + n;
+
+  return NULL;
+}
+
+/* copy a value into the arena from its view, less any release
+   indicators */
+static int
+edi_segment_copy_raw (edi_segment_t *s, edi_segment_value_t *v)
+{
+  unsigned long offset = s->arena.size, n, x = 0;
+
+  for (n = 0; v->release && n < v->raw_length; n++)
+    if (v->raw[n] == v->release)
+      {
+	if (!edi_buffer_append (&(s->arena), (char *) v->raw + x, n - x))
+	  goto fail;
+	x = ++n;
+      }
+
+  if (!edi_buffer_append (&(s->arena), (char *) v->raw + x, v->raw_length - x)
+      || !edi_buffer_append (&(s->arena), "", 1))
+    goto fail;
+
+  v->offset = offset;
+  v->length = s->arena.size - offset - 1;
+  s->pending--;
+  s->reserve -= v->raw_length + 1;
+  return 1;
+
+ fail:
+  s->arena.size = offset;
+  return 0;
+}
+
+/**
+   \brief Copies every value which is only a view into the arena.
+   \param s Pointer to the segment.
+
+   This is done for all of the values at once, before any pointer into
+   the arena is handed out, so that growing the arena cannot leave an
+   earlier value dangling.
+*/
+void
+edi_segment_materialise (edi_segment_t *s)
+{
+  int n;
+
+  for (n = 0; s->pending && n < s->values; n++)
+    if (s->value[n].offset < 0 && !edi_segment_copy_raw (s, s->value + n))
+      return;
+}
+
+/**
+   \brief Stops a segment referring to the buffer being parsed.
+   \param s Pointer to the segment.
+
+   Called before the buffer goes away; views handed out afterwards
+   are of the copies in the arena.
+*/
+void
+edi_segment_detach (edi_segment_t *s)
+{
+  int n;
+
+  if (!s)
+    return;
+
+  edi_segment_materialise (s);
+
+  for (n = 0; n < s->values; n++)
+    if (s->value[n].offset >= 0)
+      {
+	s->value[n].raw = NULL;
+	s->value[n].release = 0;
+      }
 }
 
 char *
 edi_segment_get_element (edi_segment_t *s, int x, int y)
 {
-  return s->defined[x][y] ?
-    (char *) edi_buffer_data(&(s->elements[x][y])) : NULL;
+  edi_segment_value_t *v = edi_segment_find (s, x, y);
+
+  /* all or nothing - see edi_segment_materialise() */
+  if (v && s->pending)
+    edi_segment_materialise (s);
+
+  /* an empty value has never had any data to point to */
+  return (v && v->offset >= 0 && v->length) ?
+    (char *) s->arena.data + v->offset : NULL;
+}
+
+/**
+   \brief Returns a view of a value, without copying it.
+   \param s Pointer to the segment.
+   \param v Pointer to one of the segment's values.
+   \param view The view to fill in.
+*/
+void
+edi_segment_value_view (edi_segment_t *s, edi_segment_value_t *v,
+			edi_element_view_t *view)
+{
+  if (v->raw)
+    {
+      view->data = v->raw;
+      view->size = v->raw_length;
+      view->release = v->release;
+    }
+  else
+    {
+      view->data = v->offset < 0 ? "" : (char *) s->arena.data + v->offset;
+      view->size = v->offset < 0 ? 0 : v->length;
+      view->release = 0;
+    }
+}
+
+/**
+   \brief Returns a view of an element, without copying it.
+   \param s Pointer to the segment.
+   \param x The element.
+   \param y The component.
+   \param view The view to fill in.
+   \return Non-zero if the element is defined.
+*/
+int
+edi_segment_get_view (edi_segment_t *s, int x, int y,
+		      edi_element_view_t *view)
+{
+  edi_segment_value_t *v = edi_segment_find (s, x, y);
+
+  if (!v)
+    {
+      view->data = NULL;
+      view->size = 0;
+      view->release = 0;
+      return 0;
+    }
+
+  edi_segment_value_view (s, v, view);
+  return 1;
+}
+
+/**
+   \brief Copies characters, less the release indicators.
+   \param dst Where to put the characters, which must have room for n.
+   \param src The characters.
+   \param n The number of characters.
+   \param release The release indicator, or 0 if there is none.
+   \return The number of characters put in dst.
+*/
+unsigned long
+edi_segment_unescape (char *dst, const char *src, unsigned long n,
+		      char release)
+{
+  unsigned long i, l = 0;
+
+  for (i = 0; i < n; i++)
+    {
+      if (release && src[i] == release && ++i == n)
+	break;
+      dst[l++] = src[i];
+    }
+
+  return l;
 }
 
 void
 edi_segment_set_code (edi_segment_t *s, char *c, int l)
 {
-  int len = (l > EDI_BUFFER) ? EDI_BUFFER : l;
-  strncpy (s->tag, c, len);
-  s->tag[len] = '\0';
+  s->code = edi_segment_store (s, c, (l > EDI_BUFFER) ? EDI_BUFFER : l);
+}
+
+/* find, or add, the value of a component */
+static edi_segment_value_t *
+edi_segment_value (edi_segment_t *s, int x, int y)
+{
+  edi_segment_element_t *e;
+  edi_segment_value_t *v;
+  void *ptr;
+  int n;
+
+  if((v = edi_segment_find (s, x, y)))
+    {
+      /* an old value is left in the arena until the segment is cleared */
+      if (v->offset < 0)
+	{
+	  s->pending--;
+	  s->reserve -= v->raw_length + 1;
+	}
+      return v;
+    }
+  
+  if(s->values == s->value_blck)
+    {
+      n = s->value_blck ? s->value_blck * 2 : 32;
+      if(!(ptr = realloc (s->value, n * sizeof (edi_segment_value_t))))
+	return NULL;
+      s->value = ptr;
+      s->value_blck = n;
+    }
+
+  if(x >= s->element_blck)
+    {
+      n = s->element_blck ? s->element_blck * 2 : 32;
+      while(n <= x)
+	n *= 2;
+      if(!(ptr = realloc (s->element, n * sizeof (edi_segment_element_t))))
+	return NULL;
+      s->element = ptr;
+      s->element_blck = n;
+    }
+
+  /* elements skipped over have no values */
+  for (; s->de <= x; s->de++)
+    {
+      s->element[s->de].first = s->element[s->de].last = -1;
+      s->element[s->de].count = 0;
+    }
+
+  n = s->values++;
+  v = s->value + n;
+  v->element = x;
+  v->component = y;
+  v->next = -1;
+
+  e = s->element + x;
+  if(e->last < 0)
+    e->first = n;
+  else
+    s->value[e->last].next = n;
+  e->last = n;
+
+  if (e->count < (y + 1))
+    e->count = (y + 1);
+
+  return v;
 }
 
 void
 edi_segment_set_element (edi_segment_t *s, int x, int y, char *c, int l)
 {
-  /* FIXME - temporary bounds check */
-  if(x >= EDI_NELEMS || y >= EDI_NELEMS)
+  edi_segment_value_t *v;
+  long offset;
+
+  if(x < 0 || y < 0)
     return;
   
   /**********************************************************************
@@ -124,21 +403,43 @@ edi_segment_set_element (edi_segment_t *s, int x, int y, char *c, int l)
    * be defined and which are not.
   **********************************************************************/
 
-  if(s->defined[x][y])
-    edi_buffer_clear(&(s->elements[x][y]));
-  else
-    edi_buffer_init(&(s->elements[x][y]));
+  if((offset = edi_segment_store (s, c, l)) < 0 ||
+     !(v = edi_segment_value (s, x, y)))
+    return;
 
-  s->defined[x][y] = 1;
-  
-  if(c && l)
-    edi_buffer_append(&(s->elements[x][y]), c, l);
-  
-  if (s->de < (x + 1))
-    s->de = (x + 1);
-  
-  if (s->cde[x] < (y + 1))
-    s->cde[x] = (y + 1);
+  v->offset = offset;
+  v->length = l;
+  v->raw = NULL;
+  v->raw_length = 0;
+  v->release = 0;
+}
+
+/**
+   \brief Sets an element to a view of the buffer being parsed.
+   \param s Pointer to the segment.
+   \param x The element.
+   \param y The component.
+   \param raw The characters, which must remain valid until the
+   segment is cleared or edi_segment_detach() is called.
+   \param l The number of characters.
+   \param release Release indicator used in raw, or 0 if there is none.
+*/
+void
+edi_segment_set_view (edi_segment_t *s, int x, int y, const char *raw,
+		      unsigned long l, char release)
+{
+  edi_segment_value_t *v;
+
+  if(x < 0 || y < 0 || !(v = edi_segment_value (s, x, y)))
+    return;
+
+  v->offset = -1;
+  v->length = 0;
+  v->raw = raw;
+  v->raw_length = l;
+  v->release = release;
+  s->pending++;
+  s->reserve += l + 1;
 }
 
 int
@@ -150,25 +451,31 @@ edi_segment_get_element_count (edi_segment_t *s)
 int
 edi_segment_get_subelement_count (edi_segment_t *s, int n)
 {
-  return s->cde[n];
+  return (n >= 0 && n < s->de) ? s->element[n].count : 0;
 }
 
 void
 edi_segment_copy (edi_segment_t *dst, edi_segment_t *src)
 {
-  int x, y;
+  edi_segment_value_t *v;
+  int n;
 
-  *dst = *src;
+  edi_segment_clear (dst);
+  edi_segment_materialise (src);
 
-  for (x = 0; x < EDI_NELEMS; x++)
-    for (y = 0; y < EDI_NELEMS; y++)
-      if(src->defined[x][y])
-	{
-	  dst->defined[x][y] = 0;
-	  edi_segment_set_element(dst, x, y, (char *)
-				  edi_buffer_data(&(src->elements[x][y])),
-				  edi_buffer_size(&(src->elements[x][y])));
-      }
+  if(src->code >= 0)
+    dst->code = edi_segment_store (dst, (char *) src->arena.data + src->code,
+				   strlen ((char *) src->arena.data +
+					   src->code));
+
+  for (n = 0; n < src->values; n++)
+    {
+      v = src->value + n;
+      edi_segment_set_element (dst, v->element, v->component,
+			       v->offset < 0 ? NULL :
+			       (char *) src->arena.data + v->offset,
+			       v->offset < 0 ? 0 : v->length);
+    }
 }
 
 edi_segment_t *
@@ -27,21 +27,116 @@ extern "C" {
 #endif
 
 #define EDI_BUFFER  1024
-#define EDI_NELEMS  32
 
+/**
+   \brief The location of an element's value in a segment's arena
+*/
+typedef struct
+{
+  /** \brief Element (position in the segment, first is 0) */
+  int element;
+
+  /** \brief Component (position in the composite, first is 0) */
+  int component;
+
+  /** \brief Offset of the (terminated) value in the arena, or -1 if
+      it has not been copied there yet */
+  long offset;
+
+  /** \brief Length of the value, once it is in the arena */
+  unsigned long length;
+
+  /** \brief The value as it appeared in the parsed buffer, or NULL */
+  const char *raw;
+  unsigned long raw_length;
+
+  /** \brief Release indicator used in the raw value, or 0 if none */
+  char release;
+
+  /** \brief Index of the element's next component, or -1 */
+  int next;
+}
+edi_segment_value_t;
+
+/**
+   \brief The components of an element
+*/
+typedef struct
+{
+  /** \brief Index of the first and last values, or -1 */
+  int first, last;
+
+  /** \brief Number of components (highest defined + 1) */
+  int count;
+}
+edi_segment_element_t;
+
+/**
+   \brief A segment
+
+   The code and values are held in a byte arena, located by a flat
+   index of values which is chained for each element.  Clearing a
+   segment just forgets the elements used, keeping the memory for
+   the next segment, so there is no limit on the number of elements
+   or components.
+
+   Values which were contiguous in the buffer being parsed are only
+   recorded as views of it, and are copied into the arena when a
+   terminated string is asked for or the buffer is about to go away.
+*/
 /* FIXME - handle explicit nesting/repetition in EDIFACT */
 typedef struct edi_segment_s
 {
-  char tag[EDI_BUFFER];
-  edi_buffer_t elements[EDI_NELEMS][EDI_NELEMS];
-  int defined[EDI_NELEMS][EDI_NELEMS];
-  int de, cde[EDI_NELEMS];
+  /** \brief The code and values, each terminated */
+  edi_buffer_t arena;
+
+  /** \brief Offset of the code in the arena, or -1 if not set */
+  long code;
+
+  /** \brief The values, in the order they were set */
+  edi_segment_value_t *value;
+  int values, value_blck;
+
+  /** \brief The elements, indexed by position */
+  edi_segment_element_t *element;
+  int element_blck;
+
+  /** \brief Number of elements (highest defined + 1) */
+  int de;
+
+  /** \brief Number of values not yet copied into the arena */
+  int pending;
+
+  /** \brief Room those values will need in the arena */
+  unsigned long reserve;
 }
 edi_segment_t;
 
+/**
+   \brief A view of an element's value
+   
+   Must have the same layout as EDI_ElementView in medici.h.
+*/
+typedef struct
+{
+  /** \brief The characters of the value (not terminated) */
+  const char *data;
+
+  /** \brief The number of characters */
+  unsigned long size;
+
+  /** \brief Release indicator escaping characters in data, or 0 if
+      data is the value itself */
+  char release;
+}
+edi_element_view_t;
+
 
 void edi_segment_init(edi_segment_t *s);
 void edi_segment_clear(edi_segment_t *);
+void edi_segment_shrink(edi_segment_t *, unsigned long);
+int edi_segment_reserve(edi_segment_t *, unsigned long);
+unsigned long edi_segment_peak(edi_segment_t *);
 void edi_segment_free(edi_segment_t *);
 edi_segment_t *edi_segment_create(void);
 char *edi_segment_get_code(edi_segment_t *s);
@@ -49,6 +144,12 @@ int edi_segment_cmp_code(edi_segment_t *s, char *c);
 char *edi_segment_get_element(edi_segment_t *s, int x, int y);
 void edi_segment_set_code(edi_segment_t *s, char *c, int l);
 void edi_segment_set_element(edi_segment_t *s, int x, int y, char *c, int l);
+void edi_segment_set_view(edi_segment_t *, int, int, const char *, unsigned long, char);
+int edi_segment_get_view(edi_segment_t *, int, int, edi_element_view_t *);
+void edi_segment_value_view(edi_segment_t *, edi_segment_value_t *, edi_element_view_t *);
+void edi_segment_materialise(edi_segment_t *);
+void edi_segment_detach(edi_segment_t *);
+unsigned long edi_segment_unescape(char *, const char *, unsigned long, char);
 int edi_segment_get_element_count(edi_segment_t *s);
 int edi_segment_get_subelement_count(edi_segment_t *s, int n);
 void edi_segment_copy(edi_segment_t *dst, edi_segment_t *src);
@@ -25,7 +25,20 @@
 
 #include "internal.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define EDI_HAVE_SSE2
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || \
+    (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#include <immintrin.h>
+#define EDI_HAVE_AVX2
+#endif
+
 void SYNTAX_init (FSAutomaton * fsa);
+int SYNTAX_run (FSAutomaton *, void *, const char *, unsigned int,
+		const unsigned char *, FSASkip, unsigned int *);
 
 
 /*! \file token.c */
@@ -79,6 +92,17 @@ edi_token_init (edi_token_t * self)
    that no memory allocation from the heap is needed at this level of
    the parser.
 
+   If the slices flag is set then characters are not copied into the
+   token at all. Instead the token's slice points at its raw data
+   within the buffer being parsed, so every token is whole and is
+   passed to the token handler in a single call. A token is copied (to
+   the carry buffer) only if it is interrupted by the end of a parsed
+   buffer or by ignored characters. A release indicator bitmap and a
+   cooked copy of the data are only made for tokens which contain
+   release indicators. Slices remain valid until the tokeniser returns
+   from edi_tokeniser_parse(), except for carried slices and the
+   bitmap and cooked data, which are only valid within the handler.
+
    \{ */
 
 /**
@@ -102,10 +126,279 @@ void edi_tokeniser_init (edi_tokeniser_t * self)
   self->release = 1;
   self->user_data = NULL;
   self->byte_count = 0;
+  self->slices = 0;
+  self->carried = 0;
+  edi_buffer_init (&(self->carry));
+  edi_buffer_init (&(self->rimap));
+  edi_buffer_init (&(self->cooked));
+  SYNTAX_init (&(self->fsa));
+  edi_tokeniser_classify (self);
+  edi_tokeniser_set_scan (self, EDI_SCAN_AVX2);
+}
+
+
+/**
+   \brief Prepares an edi_tokeniser_s structure for a new stream.
+   \param self Pointer to the structure to be reset.
+
+   Unlike edi_tokeniser_init(), the handlers and settings are kept, as
+   is the memory held by the buffers (up to EDI_BUFFER_RETAIN bytes
+   each). The classification table is only rebuilt, by
+   edi_tokeniser_parse(), if the previous stream changed the advice.
+*/
+void edi_tokeniser_reset (edi_tokeniser_t * self)
+{
+  if (!self)
+    return;
+  self->offset = 0;
+  memset (self->autotype, 0, sizeof (self->autotype));
+  edi_token_init (&(self->token));
+  edi_advice_init (&(self->advice));
+  self->state = 0;
+  self->error = EDI_ENONE;
+  self->release = 1;
+  self->byte_count = 0;
+  self->start = NULL;
+  self->carried = 0;
+  edi_buffer_reset (&(self->carry));
+  edi_buffer_shrink (&(self->carry), EDI_BUFFER_RETAIN);
+  edi_buffer_reset (&(self->rimap));
+  edi_buffer_shrink (&(self->rimap), EDI_BUFFER_RETAIN);
+  edi_buffer_reset (&(self->cooked));
+  edi_buffer_shrink (&(self->cooked), EDI_BUFFER_RETAIN);
   SYNTAX_init (&(self->fsa));
 }
 
 
+/**
+   \brief Frees any memory used by an edi_tokeniser_s structure.
+   \param self Pointer to the structure to be finalised.
+*/
+void edi_tokeniser_fini (edi_tokeniser_t * self)
+{
+  if (!self)
+    return;
+  edi_buffer_clear (&(self->carry));
+  edi_buffer_clear (&(self->rimap));
+  edi_buffer_clear (&(self->cooked));
+}
+
+
+/**
+   \brief Rebuilds the character classification table.
+   \param self Pointer to the edi_tokeniser_s structure.
+
+   Maps every possible input character to the FSA event which it
+   generates under the current advice. Separators are entered in
+   reverse order of precedence so that, should two of them share a
+   character, the release indicator wins, followed by the
+   sub-element, element and tag separators and finally the segment
+   terminator.
+*/
+void
+edi_tokeniser_classify (edi_tokeniser_t * self)
+{
+  edi_advice_t *advice = &(self->advice);
+  unsigned char *classes = self->classes;
+  unsigned int n;
+
+  memset (classes, SYNTAX_DEFAULT, sizeof (self->classes));
+
+  classes[ASCII_A] = SYNTAX_A;
+  classes[ASCII_B] = SYNTAX_B;
+  classes[ASCII_F] = SYNTAX_F;
+  classes[ASCII_H] = SYNTAX_H;
+  classes[ASCII_I] = SYNTAX_I;
+  classes[ASCII_L] = SYNTAX_L;
+  classes[ASCII_N] = SYNTAX_N;
+  classes[ASCII_S] = SYNTAX_S;
+  classes[ASCII_T] = SYNTAX_T;
+  classes[ASCII_U] = SYNTAX_U;
+  classes[ASCII_X] = SYNTAX_X;
+  classes[ASCII_CR] = SYNTAX_CR;
+  classes[ASCII_LF] = SYNTAX_LF;
+  classes[ASCII_GS] = SYNTAX_IS3;
+
+  if (advice->st[2])
+    classes[(unsigned char) advice->st[0]] = SYNTAX_ST;
+  if (advice->ts[2])
+    classes[(unsigned char) advice->ts[0]] = SYNTAX_TS;
+  if (advice->es[2])
+    classes[(unsigned char) advice->es[0]] = SYNTAX_ES;
+  if (advice->ss[2])
+    classes[(unsigned char) advice->ss[0]] = SYNTAX_SS;
+  if (advice->ri[2])
+    classes[(unsigned char) advice->ri[0]] = SYNTAX_RI;
+
+  /* the characters which may end a run of element data are the
+     active separators and release indicator, plus CR/LF and GS */
+
+  memset (self->stops, 0, sizeof (self->stops));
+  memset (self->stop, ASCII_CR, sizeof (self->stop));
+
+  self->stop[0] = ASCII_CR;
+  self->stop[1] = ASCII_LF;
+  self->stop[2] = ASCII_GS;
+  if (advice->st[2])
+    self->stop[3] = advice->st[0];
+  if (advice->ts[2])
+    self->stop[4] = advice->ts[0];
+  if (advice->es[2])
+    self->stop[5] = advice->es[0];
+  if (advice->ss[2])
+    self->stop[6] = advice->ss[0];
+  if (advice->ri[2])
+    self->stop[7] = advice->ri[0];
+
+  for (n = 0; n < sizeof (self->stop); n++)
+    self->stops[(unsigned char) self->stop[n]] = 1;
+
+  self->classes_serial = advice->serial;
+}
+
+
+/**
+   \brief Selects the method used to skip over runs of element data.
+   \param self Pointer to the edi_tokeniser_s structure.
+   \param scan The preferred method.
+   \return The previously selected method.
+
+   Methods which are not available on this platform (or processor)
+   fall back to the best one that is, so EDI_SCAN_AVX2 may always be
+   requested. EDI_SCAN_NONE passes every character through the FSA,
+   which is useful for comparison as the output is identical.
+*/
+edi_scan_t
+edi_tokeniser_set_scan (edi_tokeniser_t * self, edi_scan_t scan)
+{
+  edi_scan_t old = self->scan;
+
+#ifdef EDI_HAVE_AVX2
+  if (scan == EDI_SCAN_AVX2 && !__builtin_cpu_supports ("avx2"))
+    scan = EDI_SCAN_SSE2;
+#else
+  if (scan == EDI_SCAN_AVX2)
+    scan = EDI_SCAN_SSE2;
+#endif
+
+#ifndef EDI_HAVE_SSE2
+  if (scan == EDI_SCAN_SSE2)
+    scan = EDI_SCAN_SCALAR;
+#endif
+
+  self->scan = scan;
+  return old;
+}
+
+
+/* extends the current slice with n characters at s, moving it to the
+   carry buffer if they do not directly follow it */
+
+static void
+edi_tokeniser_extend (edi_tokeniser_t * self, const char *s, unsigned int n)
+{
+  edi_token_t *t = &(self->token);
+
+  if (!t->rsize && !self->carried)
+    t->slice = s;
+  else if (self->carried || t->slice + t->rsize != s)
+    {
+      if (!self->carried)
+	{
+	  edi_buffer_reset (&(self->carry));
+	  if (!edi_buffer_append (&(self->carry), (char *) t->slice, t->rsize))
+	    edi_tokeniser_handle_error (self, EDI_ENOMEM);
+	  self->carried = 1;
+	}
+      if (!edi_buffer_append (&(self->carry), (char *) s, n))
+	edi_tokeniser_handle_error (self, EDI_ENOMEM);
+      t->slice = edi_buffer_data (&(self->carry));
+    }
+
+  t->rsize += n;
+  t->csize += n;
+}
+
+/* moves the current slice to the carry buffer (at the end of a parse) */
+
+static void
+edi_tokeniser_carry (edi_tokeniser_t * self)
+{
+  edi_token_t *t = &(self->token);
+
+  if (self->slices && t->rsize && !self->carried)
+    {
+      edi_buffer_reset (&(self->carry));
+      if (!edi_buffer_append (&(self->carry), (char *) t->slice, t->rsize))
+	edi_tokeniser_handle_error (self, EDI_ENOMEM);
+      t->slice = edi_buffer_data (&(self->carry));
+      self->carried = 1;
+    }
+}
+
+/* makes sure that the bitmap for the current slice has room for bit n */
+
+static int
+edi_tokeniser_fit_rimap (edi_tokeniser_t * self, unsigned int n)
+{
+  unsigned char zero = 0;
+
+  while (self->rimap.size <= (n >> 3))
+    if (!edi_buffer_append (&(self->rimap), &zero, 1))
+      {
+	edi_tokeniser_handle_error (self, EDI_ENOMEM);
+	return 0;
+      }
+
+  return 1;
+}
+
+/* sets the bit for character n of the current slice in the bitmap */
+
+static void
+edi_tokeniser_mark_ri (edi_tokeniser_t * self, unsigned int n)
+{
+  if (edi_tokeniser_fit_rimap (self, n))
+    ((unsigned char *) self->rimap.data)[n >> 3] |= 1 << (n & 7);
+}
+
+
+/* makes a cooked copy of the current slice, less its release
+   indicators, and points the token at it and at the bitmap. Returns 0
+   (having raised EDI_ENOMEM) if the copy couldn't be made, as the
+   token's csize would then overrun it */
+
+static int
+edi_tokeniser_cook (edi_tokeniser_t * self)
+{
+  edi_token_t *t = &(self->token);
+  const unsigned char *rimap;
+  unsigned int n, x = 0;
+
+  /* the bitmap covers the whole slice */
+  if (!edi_tokeniser_fit_rimap (self, t->rsize))
+    return 0;
+  rimap = edi_buffer_data (&(self->rimap));
+
+  edi_buffer_reset (&(self->cooked));
+
+  for (n = 0; n <= t->rsize; n++)
+    if (n == t->rsize || ((rimap[n >> 3] >> (n & 7)) & 1))
+      {
+	if (!edi_buffer_append (&(self->cooked), (char *) t->slice + x, n - x))
+	  {
+	    edi_tokeniser_handle_error (self, EDI_ENOMEM);
+	    return 0;
+	  }
+	x = n + 1;
+      }
+
+  /* the buffer is only allocated once there is some data in it */
+  t->cooked = self->cooked.size ? (char *) self->cooked.data : "";
+  t->rimap = rimap;
+  return 1;
+}
+
 /**
    \brief Causes the current token to be passed to callback handlers.
    \param self Pointer to the edi_tokeniser_s structure.
@@ -120,7 +413,12 @@ edi_tokeniser_handle_token (edi_tokeniser_t * self, int last)
 
   self->token.last = last;
 
-  if (self->token_handler)
+  /* a slice with release indicators also gets a cooked copy, and is
+     dropped if there wasn't the memory for one */
+  if (self->token.rsize != self->token.csize && self->token.slice &&
+      !edi_tokeniser_cook (self))
+    error = 1;
+  else if (self->token_handler)
     error = self->token_handler (self->user_data, &(self->token));
 
   /* clear data from the token and update the offset to reflect the */
@@ -129,6 +427,16 @@ edi_tokeniser_handle_token (edi_tokeniser_t * self, int last)
   self->token.offset += self->token.rsize;
   self->token.rsize = self->token.csize = 0;
 
+  if (self->token.slice)
+    {
+      self->token.slice = NULL;
+      self->token.rimap = NULL;
+      self->token.cooked = NULL;
+      self->carried = 0;
+      edi_buffer_reset (&(self->carry));
+      edi_buffer_reset (&(self->rimap));
+    }
+
   if (last)
     self->token.type = EDI_TEL;
 
@@ -144,13 +452,177 @@ edi_tokeniser_handle_token (edi_tokeniser_t * self, int last)
 void
 edi_tokeniser_handle_error (edi_tokeniser_t * self, edi_error_t error)
 {
-  self->error = error;
+  edi_tokeniser_set_error (self, error);
   if (self->error_handler)
     self->error_handler (self->user_data, error);
 }
 
 
 
+static unsigned int
+edi_scan_scalar (edi_tokeniser_t * self, const char *s, unsigned int n)
+{
+  const unsigned char *stops = self->stops;
+  unsigned int i = 0;
+
+  while (i < n && !stops[(unsigned char) s[i]])
+    i++;
+
+  return i;
+}
+
+#ifdef EDI_HAVE_SSE2
+static unsigned int
+edi_scan_sse2 (edi_tokeniser_t * self, const char *s, unsigned int n)
+{
+  const char *stop = self->stop;
+  __m128i s0 = _mm_set1_epi8 (stop[0]), s1 = _mm_set1_epi8 (stop[1]);
+  __m128i s2 = _mm_set1_epi8 (stop[2]), s3 = _mm_set1_epi8 (stop[3]);
+  __m128i s4 = _mm_set1_epi8 (stop[4]), s5 = _mm_set1_epi8 (stop[5]);
+  __m128i s6 = _mm_set1_epi8 (stop[6]), s7 = _mm_set1_epi8 (stop[7]);
+  __m128i v, m;
+  unsigned int i, mask;
+
+  for (i = 0; i + 16 <= n; i += 16)
+    {
+      v = _mm_loadu_si128 ((const __m128i *) (s + i));
+      m = _mm_or_si128 (_mm_or_si128 (_mm_cmpeq_epi8 (v, s0),
+				      _mm_cmpeq_epi8 (v, s1)),
+			_mm_or_si128 (_mm_cmpeq_epi8 (v, s2),
+				      _mm_cmpeq_epi8 (v, s3)));
+      m = _mm_or_si128 (m,
+			_mm_or_si128 (_mm_or_si128 (_mm_cmpeq_epi8 (v, s4),
+						    _mm_cmpeq_epi8 (v, s5)),
+				      _mm_or_si128 (_mm_cmpeq_epi8 (v, s6),
+						    _mm_cmpeq_epi8 (v, s7))));
+      if ((mask = _mm_movemask_epi8 (m)))
+	return i + __builtin_ctz (mask);
+    }
+
+  return i + edi_scan_scalar (self, s + i, n - i);
+}
+#endif
+
+#ifdef EDI_HAVE_AVX2
+__attribute__ ((target ("avx2")))
+static unsigned int
+edi_scan_avx2 (edi_tokeniser_t * self, const char *s, unsigned int n)
+{
+  const char *stop = self->stop;
+  __m256i s0 = _mm256_set1_epi8 (stop[0]), s1 = _mm256_set1_epi8 (stop[1]);
+  __m256i s2 = _mm256_set1_epi8 (stop[2]), s3 = _mm256_set1_epi8 (stop[3]);
+  __m256i s4 = _mm256_set1_epi8 (stop[4]), s5 = _mm256_set1_epi8 (stop[5]);
+  __m256i s6 = _mm256_set1_epi8 (stop[6]), s7 = _mm256_set1_epi8 (stop[7]);
+  __m256i v, m;
+  unsigned int i, mask;
+
+  for (i = 0; i + 32 <= n; i += 32)
+    {
+      v = _mm256_loadu_si256 ((const __m256i *) (s + i));
+      m = _mm256_or_si256 (_mm256_or_si256 (_mm256_cmpeq_epi8 (v, s0),
+					    _mm256_cmpeq_epi8 (v, s1)),
+			   _mm256_or_si256 (_mm256_cmpeq_epi8 (v, s2),
+					    _mm256_cmpeq_epi8 (v, s3)));
+      m = _mm256_or_si256 (m,
+			   _mm256_or_si256 (_mm256_or_si256
+					    (_mm256_cmpeq_epi8 (v, s4),
+					     _mm256_cmpeq_epi8 (v, s5)),
+					    _mm256_or_si256
+					    (_mm256_cmpeq_epi8 (v, s6),
+					     _mm256_cmpeq_epi8 (v, s7))));
+      if ((mask = (unsigned int) _mm256_movemask_epi8 (m)))
+	return i + __builtin_ctz (mask);
+    }
+
+  return i + edi_scan_scalar (self, s + i, n - i);
+}
+#endif
+
+/* returns the length of the run of element data at the start of s */
+
+static unsigned int
+edi_tokeniser_scan (edi_tokeniser_t * self, const char *s, unsigned int n)
+{
+  switch (self->scan)
+    {
+#ifdef EDI_HAVE_AVX2
+    case EDI_SCAN_AVX2:
+      return edi_scan_avx2 (self, s, n);
+#endif
+#ifdef EDI_HAVE_SSE2
+    case EDI_SCAN_SSE2:
+      return edi_scan_sse2 (self, s, n);
+#endif
+    case EDI_SCAN_SCALAR:
+      return edi_scan_scalar (self, s, n);
+    default:
+      return 0;
+    }
+}
+
+/* appends a run of element data to the current token, handing off
+   full tokens exactly as repeated DoTA actions would have done */
+
+static unsigned int
+edi_tokeniser_append_run (edi_tokeniser_t * self, const char *s,
+			  unsigned int n)
+{
+  edi_token_t *t = &(self->token);
+  unsigned int done = 0, k;
+
+  if (self->slices)
+    {
+      edi_tokeniser_extend (self, s, n);
+      return n;
+    }
+
+  while (done < n)
+    {
+      k = (EDI_TOKEN_MAX - 1) - t->rsize;
+      if (k > n - done)
+	k = n - done;
+
+      memcpy (t->rdata + t->rsize, s + done, k);
+      memcpy (t->cdata + t->csize, s + done, k);
+      memset (t->ri + t->rsize, 0, k);
+      t->rsize += k;
+      t->csize += k;
+      t->rdata[t->rsize] = '\0';
+      t->cdata[t->csize] = '\0';
+
+      done += k;
+
+      if (t->rsize == (EDI_TOKEN_MAX - 1))
+	{
+	  /* as far as the handlers are concerned this is the character
+	     being processed */
+	  self->fsa.input = s + done - 1;
+	  edi_tokeniser_handle_token (self, 0);
+	  if (edi_tokeniser_error (self))
+	    break;
+	}
+    }
+
+  return done;
+}
+
+/* the FSA's skip function for states which just append element data */
+
+static unsigned int
+edi_tokeniser_skip (void *v, const char *s, unsigned int n)
+{
+  edi_tokeniser_t *self = (edi_tokeniser_t *) v;
+  unsigned int run;
+
+  if (self->stops[(unsigned char) *s]
+      || !(run = edi_tokeniser_scan (self, s, n)))
+    return 0;
+
+  return edi_tokeniser_append_run (self, s, run);
+}
+
+
+
 /**
    \brief Parse a string of characters.
    \param self Pointer to the edi_tokeniser_s structure.
@@ -165,99 +637,41 @@ edi_tokeniser_handle_error (edi_tokeniser_t * self, edi_error_t error)
 unsigned int edi_tokeniser_parse
   (edi_tokeniser_t * self, char *string, unsigned int length, int done)
 {
-  edi_advice_t *advice = &(self->advice);
-  char c;
-  int event, status;
+  int status;
   unsigned int n;
 
-  for (n = 0; n < length && !edi_tokeniser_error (self); n++)
-    {
-      c = string[n];
-      self->byte_count++;
-
-      /* separator/release characters can't be hardcoded as they can
-         be defined at the begining of the document */
-
-      if (edi_advice_is_ri (advice, c))
-	event = SYNTAX_RI;
-      else if (edi_advice_is_ss (advice, c))
-	event = SYNTAX_SS;
-      else if (edi_advice_is_es (advice, c))
-	event = SYNTAX_ES;
-      else if (edi_advice_is_ts (advice, c))
-	event = SYNTAX_TS;
-      else if (edi_advice_is_st (advice, c))
-	event = SYNTAX_ST;
-      else
-	{
-	  switch (c)
-	    {
-	    case ASCII_A:
-	      event = SYNTAX_A;
-	      break;
-	    case ASCII_B:
-	      event = SYNTAX_B;
-	      break;
-	    case ASCII_F:
-	      event = SYNTAX_F;
-	      break;
-	    case ASCII_H:
-	      event = SYNTAX_H;
-	      break;
-	    case ASCII_I:
-	      event = SYNTAX_I;
-	      break;
-	    case ASCII_L:
-	      event = SYNTAX_L;
-	      break;
-	    case ASCII_N:
-	      event = SYNTAX_N;
-	      break;
-	    case ASCII_S:
-	      event = SYNTAX_S;
-	      break;
-	    case ASCII_T:
-	      event = SYNTAX_T;
-	      break;
-	    case ASCII_U:
-	      event = SYNTAX_U;
-	      break;
-	    case ASCII_X:
-	      event = SYNTAX_X;
-	      break;
-	    case ASCII_CR:
-	      event = SYNTAX_CR;
-	      break;
-	    case ASCII_LF:
-	      event = SYNTAX_LF;
-	      break;
-	    case ASCII_GS:
-	      event = SYNTAX_IS3;
-	      break;
-	    default:
-	      event = SYNTAX_DEFAULT;
-	      break;
-	    }
-	}
+  /* separator/release characters can't be hardcoded as they can be
+     defined at the begining of the document, so the table is rebuilt
+     by the FSA whenever it changes the advice (or here, if anything
+     else has) */
 
-      /* non-zero return value means "done". -1 indicates error */
-      if ((status = FSAProcess (&(self->fsa), self, c, event)))
-	{
-	  if(status == -1)
-	    {
-	      edi_tokeniser_handle_error(self, EDI_ESYNTAX);
-	      return 0;
-	    }
-
-	  if (self->cmplt_handler)
-	    self->cmplt_handler (self->user_data);
-	  
-	  /* FIXME - obiwan? */
-	  return n + 1;
-	}
+  if (self->classes_serial != self->advice.serial)
+    edi_tokeniser_classify (self);
+
+  if (edi_tokeniser_error (self))
+    return 0;
 
+  self->fsa.halt = 0;
+  self->start = string;
+
+  /* non-zero return value means "done". -1 indicates error */
+  status = SYNTAX_run (&(self->fsa), self, string, length, self->classes,
+		       self->scan ? edi_tokeniser_skip : NULL, &n);
+
+  self->byte_count += n;
+
+  if (status == -1)
+    {
+      edi_tokeniser_handle_error (self, EDI_ESYNTAX);
+      return 0;
     }
 
+  if (status && self->cmplt_handler)
+    self->cmplt_handler (self->user_data);
+
+  /* a slice must not outlive the buffer */
+  edi_tokeniser_carry (self);
+
   /* FIXME - obiwan? */
   return n;
 }
@@ -267,6 +681,33 @@ edi_error_t edi_tokeniser_error (edi_tokeniser_t * self)
   return self->error;
 }
 
+/** \brief Sets the error status, which stops the parse after the
+    current character */
+void
+edi_tokeniser_set_error (edi_tokeniser_t * self, edi_error_t error)
+{
+  self->error = error;
+  self->fsa.halt = error != EDI_ENONE;
+}
+
+/** \brief Stops the parse after the current character, leaving the
+    rest of the buffer to be passed again */
+void
+edi_tokeniser_pause (edi_tokeniser_t * self)
+{
+  self->fsa.halt = 1;
+}
+
+/** \brief Returns the number of characters processed so far,
+    including the one currently being processed */
+edi_offset_t
+edi_tokeniser_byte_count (edi_tokeniser_t * self)
+{
+  if (self->fsa.input)
+    return self->byte_count + (self->fsa.input - self->start) + 1;
+  return self->byte_count;
+}
+
 
 
 int
@@ -283,5 +724,202 @@ edi_token_append (edi_token_t * t, char c, int d)
   return t->rsize == (EDI_TOKEN_MAX - 1);
 }
 
+/**
+   \brief Appends the current character to the current token.
+   \param self Pointer to the edi_tokeniser_s structure.
+   \param c The character.
+   \param d Zero if the character is a release indicator.
+   \return Non-zero if the token is full and should be handed off.
+
+   Used by the FSA. A sliced token is never full.
+*/
+int
+edi_tokeniser_append (edi_tokeniser_t * self, char c, int d)
+{
+  if (!self->slices)
+    return edi_token_append (&(self->token), c, d);
+
+  if (!d)
+    edi_tokeniser_mark_ri (self, self->token.rsize);
+
+  edi_tokeniser_extend (self, self->fsa.input, 1);
+
+  if (!d)
+    self->token.csize--;
+
+  return 0;
+}
+
+
+
+/**
+   \brief Initialises an empty token ring.
+   \param self Pointer to the edi_token_ring_s structure.
+*/
+void
+edi_token_ring_init (edi_token_ring_t * self)
+{
+  self->slot = NULL;
+  self->size = 0;
+  self->head = 0;
+  self->count = 0;
+  self->allocations = 0;
+}
+
+/**
+   \brief Frees the slots of a token ring.
+   \param self Pointer to the edi_token_ring_s structure.
+*/
+void
+edi_token_ring_fini (edi_token_ring_t * self)
+{
+  unsigned int n;
+
+  for (n = 0; n < self->size; n++)
+    edi_buffer_clear (&(self->slot[n].data));
+
+  free (self->slot);
+  self->slot = NULL;
+  self->size = 0;
+  self->head = 0;
+  self->count = 0;
+}
+
+/**
+   \brief Discards any queued tokens, keeping the slots for reuse.
+   \param self Pointer to the edi_token_ring_s structure.
+*/
+void
+edi_token_ring_clear (edi_token_ring_t * self)
+{
+  self->head = 0;
+  self->count = 0;
+}
+
+/* double the number of slots, unwrapping the queue to the start */
+
+static int
+edi_token_ring_grow (edi_token_ring_t * self)
+{
+  edi_token_slot_t *slot;
+  unsigned int size, n;
+
+  size = self->size ? self->size * 2 : 64;
+
+  if (!(slot = (edi_token_slot_t *) malloc (size * sizeof (edi_token_slot_t))))
+    return 0;
+
+  for (n = 0; n < self->size; n++)
+    slot[n] = self->slot[(self->head + n) % self->size];
+
+  for (; n < size; n++)
+    edi_buffer_init (&(slot[n].data));
+
+  free (self->slot);
+  self->slot = slot;
+  self->size = size;
+  self->head = 0;
+  self->allocations++;
+
+  return 1;
+}
+
+/**
+   \brief Copies a token into a slot.
+   \param slot Pointer to the slot.
+   \param token The token to copy.
+   \return Non-zero on success, zero if memory could not be allocated.
+
+   The data of a sliced token is copied into the slot (terminated), so
+   the copy remains valid after the parsed buffer has gone.
+*/
+int
+edi_token_slot_copy (edi_token_slot_t * slot, edi_token_t * token)
+{
+  unsigned long need;
+  char *data;
+
+  slot->token = *token;
+
+  if (!token->slice)
+    return 1;
+
+  need = token->rsize + 1 + token->csize + 1 + (token->rsize >> 3) + 1;
+
+  if (!edi_buffer_reserve (&(slot->data), need))
+    return 0;
+
+  data = (char *) slot->data.data;
+  memcpy (data, token->slice, token->rsize);
+  data[token->rsize] = '\0';
+  slot->token.slice = data;
+  data += token->rsize + 1;
+
+  memcpy (data, edi_token_cooked (token), token->csize);
+  data[token->csize] = '\0';
+  slot->token.cooked = data;
+  data += token->csize + 1;
+
+  if (token->rimap)
+    {
+      memcpy (data, token->rimap, (token->rsize >> 3) + 1);
+      slot->token.rimap = (unsigned char *) data;
+    }
+
+  return 1;
+}
+
+/**
+   \brief Queues a copy of a token.
+   \param self Pointer to the edi_token_ring_s structure.
+   \param token The token to copy.
+   \return Pointer to the copy, or NULL if memory could not be allocated.
+
+   See edi_token_slot_copy().
+*/
+edi_token_t *
+edi_token_ring_push (edi_token_ring_t * self, edi_token_t * token)
+{
+  edi_token_slot_t *slot;
+  unsigned long blck;
+
+  if (self->count == self->size && !edi_token_ring_grow (self))
+    return NULL;
+
+  slot = self->slot + (self->head + self->count) % self->size;
+
+  blck = slot->data.blck;
+  if (!edi_token_slot_copy (slot, token))
+    return NULL;
+  if (slot->data.blck != blck)
+    self->allocations++;
+
+  self->count++;
+
+  return &(slot->token);
+}
+
+/**
+   \brief Removes the token at the head of the queue.
+   \param self Pointer to the edi_token_ring_s structure.
+   \return Pointer to the token, or NULL if the queue is empty.
+
+   The token remains valid until its slot is reused by a later push.
+*/
+edi_token_t *
+edi_token_ring_shift (edi_token_ring_t * self)
+{
+  edi_token_t *token;
+
+  if (!self->count)
+    return NULL;
+
+  token = &(self->slot[self->head].token);
+  self->head = (self->head + 1) % self->size;
+  self->count--;
+
+  return token;
+}
+
 
 /** \} */
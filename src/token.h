@@ -23,12 +23,12 @@
 #define TOKEN_H
 
 /**********************************************************************
- * EDI_TOKEN_MAX should be big enough to contain all fields which are
- * present in the syntax envelopes (plus any release indicators).  64
- * -> 256 gives ~10% speed penalty. It is not currently the case, but
- * if syntax modules were to use tokens call rather than segments then
- * it would be good to have all fields able to fit into one token,
- * otherwise the logic gets more complex/allocations need to be made.
+ * EDI_TOKEN_MAX is the size of the buffers of a copied token: longer
+ * data is handed on in several tokens of up to EDI_TOKEN_MAX - 1
+ * characters. It only applies when the tokeniser's slices flag is
+ * off, as it is for tokens.c - a slice points into the parsed buffer
+ * (or the carry buffer) and is never split. The parser uses slices,
+ * so an element of any length reaches its handlers in one piece.
  **********************************************************************/
 
 #define EDI_TOKEN_MAX 64
@@ -112,8 +112,70 @@ struct edi_token_s
 
   /** \brief Flags indicating if each character in rdata is RI or not */
   char ri[EDI_TOKEN_MAX];
+
+  /** \brief The raw data, in place, when the tokeniser produces slices
+      (NULL otherwise, or for an empty token) */
+  const char *slice;
+
+  /** \brief Bitmap of the release indicators within the slice (NULL
+      if it contains none) */
+  const unsigned char *rimap;
+
+  /** \brief The cooked data for a slice which contains release
+      indicators (NULL if it contains none) */
+  const char *cooked;
 };
 
+/* accessors which work for both copied and sliced tokens */
+#define edi_token_raw(t) ((t)->slice ? (t)->slice : (t)->rdata)
+#define edi_token_cooked(t) \
+         ((t)->slice ? ((t)->cooked ? (t)->cooked : (t)->slice) : (t)->cdata)
+#define edi_token_is_ri(t,n) \
+         ((t)->slice ? ((t)->rimap && (((t)->rimap[(n)>>3] >> ((n)&7)) & 1)) \
+                     : (t)->ri[n])
+
+/**
+   \brief A slot in a token ring
+
+   Holds a copy of a token along with storage for the data of a sliced
+   token, which is kept between uses of the slot.
+ */
+typedef struct
+{
+  /** \brief The copy of the token */
+  edi_token_t token;
+
+  /** \brief Raw data, cooked data and bitmap of a sliced token */
+  edi_buffer_t data;
+}
+edi_token_slot_t;
+
+/**
+   \brief A queue of tokens held in a growable ring of reusable slots
+
+   Once the ring has grown to accommodate the largest segment (and
+   the slots to accommodate the largest tokens) no further memory is
+   allocated.
+ */
+typedef struct
+{
+  /** \brief The slots */
+  edi_token_slot_t *slot;
+
+  /** \brief Number of slots */
+  unsigned int size;
+
+  /** \brief Index of the slot at the head of the queue */
+  unsigned int head;
+
+  /** \brief Number of queued tokens */
+  unsigned int count;
+
+  /** \brief Number of heap allocations made by the ring */
+  unsigned long allocations;
+}
+edi_token_ring_t;
+
 /**
    \brief Lexical analyser for an EDI stream
 
@@ -168,17 +230,63 @@ struct edi_tokeniser_s
   FSAutomaton fsa;
 
   /** \brief Bytes processed so far */
-  unsigned long byte_count;
+  edi_offset_t byte_count;
+
+  /** \brief FSA event for each possible input character */
+  unsigned char classes[256];
+
+  /** \brief Advice serial number that the classes table was built from */
+  unsigned int classes_serial;
+
+  /** \brief Flags characters which end a run of element data */
+  unsigned char stops[256];
+
+  /** \brief The characters flagged in stops, padded with duplicates */
+  char stop[8];
+
+  /** \brief Method used to find the end of a run of element data */
+  edi_scan_t scan;
+
+  /** \brief Non-zero to pass tokens as slices of the parsed buffer */
+  int slices;
+
+  /** \brief Start of the buffer being parsed */
+  const char *start;
+
+  /** \brief Non-zero if the current slice has been moved to carry */
+  int carried;
+
+  /** \brief Holds a slice which is not contiguous in the parsed buffer */
+  edi_buffer_t carry;
+
+  /** \brief Release indicator bitmap for the current slice */
+  edi_buffer_t rimap;
+
+  /** \brief Cooked data for the current slice */
+  edi_buffer_t cooked;
 };
 
 /* token.c */
 void edi_token_init(edi_token_t *);
 void edi_tokeniser_init(edi_tokeniser_t *);
+void edi_tokeniser_reset(edi_tokeniser_t *);
+void edi_tokeniser_fini(edi_tokeniser_t *);
 int edi_tokeniser_handle_token(edi_tokeniser_t *, int);
-unsigned int edi_tokeniser_parse(edi_tokeniser_t *, char *, unsigned int, int);
 edi_error_t edi_tokeniser_error(edi_tokeniser_t *);
+void edi_tokeniser_set_error(edi_tokeniser_t *, edi_error_t);
+void edi_tokeniser_pause(edi_tokeniser_t *);
+edi_offset_t edi_tokeniser_byte_count(edi_tokeniser_t *);
 void edi_tokeniser_handle_error(edi_tokeniser_t *, edi_error_t);
+void edi_tokeniser_classify(edi_tokeniser_t *);
+edi_scan_t edi_tokeniser_set_scan(edi_tokeniser_t *, edi_scan_t);
 unsigned int edi_tokeniser_parse(edi_tokeniser_t *, char *, unsigned int, int);
 int edi_token_append(edi_token_t *, char, int);
+int edi_tokeniser_append(edi_tokeniser_t *, char, int);
+int edi_token_slot_copy(edi_token_slot_t *, edi_token_t *);
+void edi_token_ring_init(edi_token_ring_t *);
+void edi_token_ring_fini(edi_token_ring_t *);
+void edi_token_ring_clear(edi_token_ring_t *);
+edi_token_t *edi_token_ring_push(edi_token_ring_t *, edi_token_t *);
+edi_token_t *edi_token_ring_shift(edi_token_ring_t *);
 
 #endif /*TOKEN_H*/
@@ -316,15 +316,24 @@ edi_ungtdi_segment (edi_parser_t *SELF)
 }
 
 
+/* ready for the next interchange, keeping the service directory */
 static void
-ungtdi_fini (edi_parser_t *SELF)
+ungtdi_reset (edi_parser_t *SELF)
 {
-  if (MESSAGE)
-    edi_directory_free (MESSAGE);
+  /* the message directory came from the application, which may be
+     sharing it with other parsers, so it is not ours to free */
   MESSAGE = NULL;
 
-  if (SERVICE)
-      edi_directory_free (SERVICE);
+  memset(self, 0, sizeof(edi_ungtdi_t)); /* mitigate bugs */
+}
+
+
+static void
+ungtdi_fini (edi_parser_t *SELF)
+{
+  ungtdi_reset (SELF);
+
+  /* the service directory is shared - see UNGTDI_1_ANA() */
   SERVICE = NULL;
 }
 
@@ -332,13 +341,14 @@ ungtdi_fini (edi_parser_t *SELF)
 edi_error_t
 edi_ungtdi_init (edi_parser_t *SELF)
 {
-  memset(self, 0, sizeof(edi_ungtdi_t)); /* mitigate bugs */
-  
   SERVICE = UNGTDI_1_ANA();
   MESSAGE = NULL;
   
   SELF->syntax_fini = ungtdi_fini;
+  SELF->syntax_reset = ungtdi_reset;
   SELF->sgmnt_handler = edi_ungtdi_segment;
+
+  ungtdi_reset (SELF);
        
   return EDI_ENONE;
 }
@@ -563,7 +573,11 @@ static edi_francesco_codelst_info_t codelistinfo[] = {
 
 static edi_directory_t *UNGTDI_1_ANA(void)
 {
-  return edi_francesco_create(elementinfo,
+  /* created once, and shared by every parser */
+  static edi_directory_t *shared = NULL;
+
+  return edi_francesco_shared(&shared,
+			      elementinfo,
 			      compositeinfo,
 			      segmentinfo,
 			      compositecontents,
@@ -274,16 +274,33 @@ edi_x12_segment (edi_parser_t *SELF)
 }
 
 
+/* ready for the next interchange, keeping the service directory */
 static void
-edi_x12_fini (edi_parser_t *SELF)
+edi_x12_reset (edi_parser_t *SELF)
 {
-  
-  if(MESSAGE)
-    edi_directory_free (MESSAGE);
+  /* the message directory came from the application, which may be
+     sharing it with other parsers, so it is not ours to free */
   MESSAGE = NULL;
+
+  memset(self, 0, sizeof(edi_x12_t)); /* mitigate bugs */
+}
+
+
+/* a transaction set between ST and SE parsed by another parser, which
+   only the group control count need know about */
+static void
+edi_x12_skip (edi_parser_t *SELF)
+{
+  self->transactions++;
+}
+
+
+static void
+edi_x12_fini (edi_parser_t *SELF)
+{
+  edi_x12_reset (SELF);
   
-  if(SERVICE)
-    edi_directory_free (SERVICE);
+  /* the service directory is shared - see X12_V4011_SYSTEM() */
   SERVICE = NULL;
 }
 
@@ -291,14 +308,16 @@ edi_x12_fini (edi_parser_t *SELF)
 edi_error_t
 edi_x12_init (edi_parser_t *SELF)
 {
-  memset(self, 0, sizeof(edi_x12_t)); /* mitigate bugs */
-  
   SERVICE = X12_V4011_SYSTEM ();
   MESSAGE = NULL;
   
   SELF->syntax_fini = edi_x12_fini;
+  SELF->syntax_reset = edi_x12_reset;
+  SELF->syntax_skip = edi_x12_skip;
   SELF->sgmnt_handler = edi_x12_segment;
 
+  edi_x12_reset (SELF);
+
   return EDI_ENONE;
 }
 
@@ -1049,11 +1068,15 @@ static edi_francesco_codelst_info_t codelistinfo[] = {
 
 static edi_directory_t *X12_V4011_SYSTEM(void)
 {
-  return (edi_directory_t *) edi_francesco_create(elementinfo,
-						  compositeinfo,
-						  segmentinfo,
-						  compositecontents,
-						  segmentcontents,
-						  codelistinfo,
-						  transactionsetrule);
+  /* created once, and shared by every parser */
+  static edi_directory_t *shared = NULL;
+
+  return edi_francesco_shared(&shared,
+			      elementinfo,
+			      compositeinfo,
+			      segmentinfo,
+			      compositecontents,
+			      segmentcontents,
+			      codelistinfo,
+			      transactionsetrule);
 }